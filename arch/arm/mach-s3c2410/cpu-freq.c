@@ -0,0 +1,305 @@
+/* linux/arch/arm/mach-s3c2410/cpu-freq.c
+ *
+ * S3C2410 CPU frequency scaling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The core clock is changed by reprogramming the MPLL and the HCLK/PCLK
+ * dividers. The UPLL is never touched, so the USB clocks keep running
+ * across a change, and PCLK is kept where the bootloader set it, so
+ * the UARTs and the system timer never see a change. Drivers that
+ * depend on HCLK (NAND) are told through the cpufreq transition
+ * notifiers, which are called with the clock rates already updated to
+ * the new values; the SDRAM refresh counter is updated here.
+ *
+ * The bank timings set up by the bootloader for the boot (highest)
+ * frequency are left alone, they only become more relaxed as HCLK drops.
+*/
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/sysdev.h>
+#include <linux/cpufreq.h>
+#include <linux/clk.h>
+#include <linux/err.h>
+#include <linux/io.h>
+
+#include <mach/hardware.h>
+#include <mach/regs-clock.h>
+#include <mach/regs-mem.h>
+
+#include <asm/plat-s3c24xx/cpu.h>
+#include <asm/plat-s3c24xx/clock.h>
+
+/* the MPLL takes LOCKTIME to settle, during which FCLK is stopped. The
+ * reset value is much longer than the 150us the PLL actually needs. */
+#define S3C2410_MPLL_LOCK_US		200
+#define S3C2410_LOCKTIME_MPLL_MASK	(0xfff)
+
+/* SDRAM rows must be refreshed at least this often */
+#define S3C2410_REFRESH_PERIOD_NS	7800
+
+struct s3c2410_cpufreq_cfg {
+	unsigned long	mpllcon;
+	unsigned long	clkdivn;
+};
+
+/* Settings for a 12MHz crystal. All of them keep PCLK at 50.7MHz so the
+ * PWM system timer and the UART baud rates are left undisturbed. */
+
+static struct s3c2410_cpufreq_cfg s3c2410_cpufreq_cfgs[] = {
+	{	/* 202.8 / 101.4 / 50.7 */
+		.mpllcon	= S3C2410_PLLVAL(0xa1, 3, 1),
+		.clkdivn	= S3C2410_CLKDIVN_HDIVN | S3C2410_CLKDIVN_PDIVN,
+	}, {	/* 101.4 / 101.4 / 50.7 */
+		.mpllcon	= S3C2410_PLLVAL(0xa1, 3, 2),
+		.clkdivn	= S3C2410_CLKDIVN_PDIVN,
+	}, {	/*  50.7 /  50.7 / 50.7 */
+		.mpllcon	= S3C2410_PLLVAL(0xa1, 3, 3),
+		.clkdivn	= 0,
+	},
+};
+
+static struct cpufreq_frequency_table
+	s3c2410_cpufreq_table[ARRAY_SIZE(s3c2410_cpufreq_cfgs) + 1];
+
+static struct clk *xtal;
+static unsigned int s3c2410_refresh_ns = S3C2410_REFRESH_PERIOD_NS;
+
+static unsigned long s3c2410_cpufreq_fclk(unsigned long mpllcon)
+{
+	return s3c2410_get_pll(mpllcon, clk_get_rate(xtal));
+}
+
+static unsigned long s3c2410_cpufreq_hclk(unsigned long fclk,
+					  unsigned long clkdivn)
+{
+	return fclk / ((clkdivn & S3C2410_CLKDIVN_HDIVN) ? 2 : 1);
+}
+
+static unsigned long s3c2410_cpufreq_pclk(unsigned long hclk,
+					  unsigned long clkdivn)
+{
+	return hclk / ((clkdivn & S3C2410_CLKDIVN_PDIVN) ? 2 : 1);
+}
+
+static void s3c2410_cpufreq_setrefresh(unsigned long hclk)
+{
+	unsigned long refresh;
+	unsigned long count;
+
+	/* period = (2^11 + 1 - count) / HCLK */
+
+	count = (hclk / 1000) * s3c2410_refresh_ns / 1000000;
+	count = 2049 - count;
+
+	refresh = __raw_readl(S3C2410_REFRESH);
+	refresh &= ~S3C2410_REFRESH_REFCOUNTER;
+	refresh |= count & S3C2410_REFRESH_REFCOUNTER;
+	__raw_writel(refresh, S3C2410_REFRESH);
+}
+
+/* s3c2410_cpufreq_set
+ *
+ * Change the hardware over. The MPLL is changed while both the old and
+ * the new divisors are applied, so neither HCLK nor PCLK ever goes over
+ * the lower of the old and new rates in between, and the SDRAM refresh
+ * is never slower than HCLK requires.
+*/
+
+static void s3c2410_cpufreq_set(struct s3c2410_cpufreq_cfg *cfg,
+				unsigned long old_hclk, unsigned long new_hclk)
+{
+	unsigned long clkdivn;
+	unsigned long flags;
+
+	local_irq_save(flags);
+
+	if (new_hclk < old_hclk)
+		s3c2410_cpufreq_setrefresh(new_hclk);
+
+	clkdivn = __raw_readl(S3C2410_CLKDIVN);
+	__raw_writel(clkdivn | cfg->clkdivn, S3C2410_CLKDIVN);
+	__raw_writel(cfg->mpllcon, S3C2410_MPLLCON);
+	__raw_writel(cfg->clkdivn, S3C2410_CLKDIVN);
+
+	if (new_hclk > old_hclk)
+		s3c2410_cpufreq_setrefresh(new_hclk);
+
+	local_irq_restore(flags);
+}
+
+static void s3c2410_cpufreq_updateclk(unsigned long fclk,
+				      unsigned long hclk,
+				      unsigned long pclk)
+{
+	mutex_lock(&clocks_mutex);
+	clk_mpll.rate = fclk;
+	clk_f.rate = fclk;
+	clk_h.rate = hclk;
+	clk_p.rate = pclk;
+	mutex_unlock(&clocks_mutex);
+}
+
+static int s3c2410_cpufreq_verify(struct cpufreq_policy *policy)
+{
+	if (policy->cpu != 0)
+		return -EINVAL;
+
+	return cpufreq_frequency_table_verify(policy, s3c2410_cpufreq_table);
+}
+
+static unsigned int s3c2410_cpufreq_get(unsigned int cpu)
+{
+	if (cpu != 0)
+		return 0;
+
+	return clk_get_rate(&clk_f) / 1000;
+}
+
+static int s3c2410_cpufreq_target(struct cpufreq_policy *policy,
+				  unsigned int target_freq,
+				  unsigned int relation)
+{
+	struct s3c2410_cpufreq_cfg *cfg;
+	struct cpufreq_freqs freqs;
+	unsigned long fclk, hclk, pclk;
+	unsigned long old_hclk;
+	unsigned int index;
+	int ret;
+
+	ret = cpufreq_frequency_table_target(policy, s3c2410_cpufreq_table,
+					     target_freq, relation, &index);
+	if (ret)
+		return ret;
+
+	freqs.cpu = 0;
+	freqs.old = s3c2410_cpufreq_get(0);
+	freqs.new = s3c2410_cpufreq_table[index].frequency;
+
+	if (freqs.old == freqs.new)
+		return 0;
+
+	cfg = &s3c2410_cpufreq_cfgs[s3c2410_cpufreq_table[index].index];
+
+	fclk = s3c2410_cpufreq_fclk(cfg->mpllcon);
+	hclk = s3c2410_cpufreq_hclk(fclk, cfg->clkdivn);
+	pclk = s3c2410_cpufreq_pclk(hclk, cfg->clkdivn);
+
+	old_hclk = clk_get_rate(&clk_h);
+
+	/* the notifiers see the new rates in both PRE and POSTCHANGE, and
+	 * pick the transition in which the change is safe to make. */
+
+	s3c2410_cpufreq_updateclk(fclk, hclk, pclk);
+
+	cpufreq_notify_transition(&freqs, CPUFREQ_PRECHANGE);
+	s3c2410_cpufreq_set(cfg, old_hclk, hclk);
+	cpufreq_notify_transition(&freqs, CPUFREQ_POSTCHANGE);
+
+	return 0;
+}
+
+static int s3c2410_cpufreq_driver_init(struct cpufreq_policy *policy)
+{
+	unsigned long boot_fclk, boot_pclk;
+	unsigned long fclk, hclk, pclk;
+	unsigned long locktime, ltime;
+	unsigned long refresh;
+	int i;
+
+	if (policy->cpu != 0)
+		return -EINVAL;
+
+	locktime = __raw_readl(S3C2410_LOCKTIME);
+	ltime = (clk_get_rate(xtal) / 1000000) * S3C2410_MPLL_LOCK_US;
+
+	if ((locktime & S3C2410_LOCKTIME_MPLL_MASK) > ltime) {
+		locktime &= ~S3C2410_LOCKTIME_MPLL_MASK;
+		locktime |= ltime;
+		__raw_writel(locktime, S3C2410_LOCKTIME);
+	}
+
+	boot_fclk = clk_get_rate(&clk_f);
+	boot_pclk = clk_get_rate(&clk_p);
+
+	/* only offer settings which do not overclock the part beyond what
+	 * the bootloader chose and which keep PCLK where it is */
+
+	for (i = 0; i < ARRAY_SIZE(s3c2410_cpufreq_cfgs); i++) {
+		struct s3c2410_cpufreq_cfg *cfg = &s3c2410_cpufreq_cfgs[i];
+
+		fclk = s3c2410_cpufreq_fclk(cfg->mpllcon);
+		hclk = s3c2410_cpufreq_hclk(fclk, cfg->clkdivn);
+		pclk = s3c2410_cpufreq_pclk(hclk, cfg->clkdivn);
+
+		s3c2410_cpufreq_table[i].index = i;
+
+		if (fclk > boot_fclk || pclk != boot_pclk)
+			s3c2410_cpufreq_table[i].frequency =
+				CPUFREQ_ENTRY_INVALID;
+		else
+			s3c2410_cpufreq_table[i].frequency = fclk / 1000;
+	}
+
+	s3c2410_cpufreq_table[i].index = 0;
+	s3c2410_cpufreq_table[i].frequency = CPUFREQ_TABLE_END;
+
+	/* keep the refresh period the bootloader programmed, if sane */
+
+	refresh = __raw_readl(S3C2410_REFRESH) & S3C2410_REFRESH_REFCOUNTER;
+	refresh = (2049 - refresh) * 1000000 / (clk_get_rate(&clk_h) / 1000);
+	if (refresh && refresh < S3C2410_REFRESH_PERIOD_NS)
+		s3c2410_refresh_ns = refresh;
+
+	policy->cur = s3c2410_cpufreq_get(0);
+	policy->cpuinfo.transition_latency = (S3C2410_MPLL_LOCK_US + 50) * 1000;
+
+	cpufreq_frequency_table_get_attr(s3c2410_cpufreq_table, policy->cpu);
+
+	return cpufreq_frequency_table_cpuinfo(policy, s3c2410_cpufreq_table);
+}
+
+static struct freq_attr *s3c2410_cpufreq_attr[] = {
+	&cpufreq_freq_attr_scaling_available_freqs,
+	NULL,
+};
+
+static struct cpufreq_driver s3c2410_cpufreq_driver = {
+	.flags		= CPUFREQ_STICKY,
+	.verify		= s3c2410_cpufreq_verify,
+	.target		= s3c2410_cpufreq_target,
+	.get		= s3c2410_cpufreq_get,
+	.init		= s3c2410_cpufreq_driver_init,
+	.name		= "s3c2410",
+	.attr		= s3c2410_cpufreq_attr,
+};
+
+static int s3c2410_cpufreq_add(struct sys_device *sysdev)
+{
+	xtal = clk_get(NULL, "xtal");
+	if (IS_ERR(xtal)) {
+		printk(KERN_ERR "%s: cannot get xtal clock\n", __func__);
+		return PTR_ERR(xtal);
+	}
+
+	return cpufreq_register_driver(&s3c2410_cpufreq_driver);
+}
+
+static struct sysdev_driver s3c2410_cpufreq_sysdrv = {
+	.add		= s3c2410_cpufreq_add,
+};
+
+/* registered late, so the drivers which follow HCLK have added their
+ * transition notifiers before the governor first changes it */
+
+static int __init s3c2410_cpufreq_init(void)
+{
+	return sysdev_driver_register(&s3c2410_sysclass,
+				      &s3c2410_cpufreq_sysdrv);
+}
+
+late_initcall(s3c2410_cpufreq_init);
@@ -112,6 +112,13 @@ static struct s3c24xx_dma_map __initdata s3c2410_dma_mappings[] = {
 		.name		= "usb-ep4",
 		.channels[3]	=S3C2410_DCON_CH3_USBEP4 | DMA_CH_VALID,
 	},
+	[DMACH_MEM] = {
+		.name		= "memory",
+		.channels[0]	= DMA_CH_VALID,
+		.channels[1]	= DMA_CH_VALID,
+		.channels[2]	= DMA_CH_VALID,
+		.channels[3]	= DMA_CH_VALID,
+	},
 };
 
 static void s3c2410_dma_select(struct s3c2410_dma_chan *chan,
@@ -142,6 +149,14 @@ static struct s3c24xx_dma_order __initdata s3c2410_dma_order = {
 				[1]	= 2 | DMA_CH_VALID,
 			},
 		},
+		[DMACH_MEM]	= {
+			.list	= {
+				[0]	= 1 | DMA_CH_VALID,
+				[1]	= 0 | DMA_CH_VALID,
+				[2]	= 2 | DMA_CH_VALID,
+				[3]	= 3 | DMA_CH_VALID,
+			},
+		},
 	},
 };
 
@@ -53,6 +53,7 @@ enum dma_ch {
 	DMACH_UART2_SRC2,
 	DMACH_UART3,		/* s3c2443 has extra uart */
 	DMACH_UART3_SRC2,
+	DMACH_MEM,		/* memory to memory, software triggered */
 	DMACH_MAX,		/* the end entry */
 };
 
@@ -141,6 +142,8 @@ enum s3c2410_chan_op {
 #define S3C2410_DMAF_SLOW         (1<<0)   /* slow, so don't worry about
 					    * waiting for reloads */
 #define S3C2410_DMAF_AUTOSTART    (1<<1)   /* auto-start if buffer queued */
+#define S3C2410_DMAF_SWTRIG       (1<<2)   /* software triggered, set before
+					    * calling s3c2410_dma_config() */
 
 /* dma buffer */
 
@@ -180,12 +183,29 @@ typedef void (*s3c2410_dma_cbfn_t)(struct s3c2410_dma_chan *,
 typedef int  (*s3c2410_dma_opfn_t)(struct s3c2410_dma_chan *,
 				   enum s3c2410_chan_op );
 
+/* s3c2410_dma_batchfn_t
+ *
+ * batched callback routine type, called with the id of the last buffer
+ * and the number and total size of the buffers finished since the last
+ * call
+*/
+
+typedef void (*s3c2410_dma_batchfn_t)(struct s3c2410_dma_chan *,
+				      void *buf, int nr, int size,
+				      enum s3c2410_dma_buffresult result);
+
 struct s3c2410_dma_stats {
 	unsigned long		loads;
 	unsigned long		timeout_longest;
 	unsigned long		timeout_shortest;
 	unsigned long		timeout_avg;
 	unsigned long		timeout_failed;
+
+	unsigned long		irqs;
+	unsigned long		buffers;
+	unsigned long long	bytes;
+	unsigned long		underruns;	/* ran dry with buffers queued */
+	unsigned long		batches;
 };
 
 struct s3c2410_dma_map;
@@ -227,6 +247,13 @@ struct s3c2410_dma_chan {
 	/* driver handles */
 	s3c2410_dma_cbfn_t	 callback_fn;	/* buffer done callback */
 	s3c2410_dma_opfn_t	 op_fn;		/* channel op callback */
+	s3c2410_dma_batchfn_t	 batch_fn;	/* batched buffer done */
+
+	/* buffers finished but not yet passed to batch_fn */
+	unsigned int		 batch_max;
+	unsigned int		 batch_nr;
+	unsigned int		 batch_size;
+	void			*batch_id;
 
 	/* stats gathering */
 	struct s3c2410_dma_stats *stats;
@@ -316,6 +343,16 @@ extern int s3c2410_dma_getposition(dmach_t channel,
 extern int s3c2410_dma_set_opfn(dmach_t, s3c2410_dma_opfn_t rtn);
 extern int s3c2410_dma_set_buffdone_fn(dmach_t, s3c2410_dma_cbfn_t rtn);
 
+/* s3c2410_dma_set_batchdone_fn
+ *
+ * report finished buffers in batches instead of one by one, once max
+ * of them have finished or the queue has run empty. This replaces the
+ * buffdone callback for the channel.
+*/
+
+extern int s3c2410_dma_set_batchdone_fn(dmach_t, s3c2410_dma_batchfn_t rtn,
+					unsigned int max);
+
 /* DMA Register definitions */
 
 #define S3C2410_DMA_DISRC       (0x00)
@@ -368,6 +405,8 @@ extern int s3c2410_dma_set_buffdone_fn(dmach_t, s3c2410_dma_cbfn_t rtn);
 #define S3C2410_DCON_CH3_TIMER	(3<<24)
 #define S3C2410_DCON_CH3_USBEP4	(4<<24)
 
+#define S3C2410_DCON_SERVMODE   (1<<27)	/* whole service */
+
 #define S3C2410_DCON_SRCSHIFT   (24)
 #define S3C2410_DCON_SRCMASK	(7<<24)
 
@@ -46,6 +46,11 @@
 #include <linux/mmc/host.h>
 #include <linux/eink_apollofb.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/mach/arch.h>
 #include <asm/mach/map.h>
@@ -121,8 +126,23 @@ static struct platform_device lbookv3_led_green = {
 	},
 };
 
+/* with CONFIG_MTD_NAND_DUMB_BADBLOCK_UBI, bad blocks in STORAGE are
+ * left to UBI on it rather than remapped into SPARE, see translate_limit
+ * below. Data written through a remap there is lost, so STORAGE has to
+ * be reformatted with ubiformat when moving over. */
+
+/* the bootloader remaps bad blocks into the 64 blocks at the start of
+ * the chip, SPARE, in block order. The last 8 of them are left to the
+ * kernel log (CONFIG_MTD_LOG), which is far more than the remaps ever
+ * reach; with more than 56 bad blocks the kernel reports the rest as
+ * bad rather than follow the bootloader into the log. */
+
+#define LBOOKV3_NAND_SPARE_BLOCKS	56
+
 #ifdef CONFIG_ARCH_LBOOK_V3_EXT
 
+#define LBOOKV3_STORAGE_OFFSET	(SZ_1M * 0x3E)
+
 static struct mtd_partition lbookv3_nand_part[] = {
 	[0] = {
 		.name	= "KERNEL",
@@ -146,18 +166,25 @@ static struct mtd_partition lbookv3_nand_part[] = {
 	},
 	[4] = {
 		.name	= "STORAGE",
-		.offset	= SZ_1M * 0x3E,
+		.offset	= LBOOKV3_STORAGE_OFFSET,
 		.size	= SZ_1M * 450,
 	},
 	[5] = {
 		.name	= "SPARE",
-		.size	= SZ_1M * 8,
+		.size	= SZ_1M * 7,
 		.offset	= 0,
 	},
+	[6] = {
+		.name	= "KLOG",
+		.size	= SZ_1M,
+		.offset	= SZ_1M * 7,
+	},
 };
 
 #else
 
+#define LBOOKV3_STORAGE_OFFSET	(SZ_1M * 0x37)
+
 static struct mtd_partition lbookv3_nand_part[] = {
 	[0] = {
 		.name	= "KERNEL",
@@ -181,14 +208,19 @@ static struct mtd_partition lbookv3_nand_part[] = {
 	},
 	[4] = {
 		.name	= "STORAGE",
-		.offset	= SZ_1M * 0x37,
+		.offset	= LBOOKV3_STORAGE_OFFSET,
 		.size	= SZ_1M * 9,
 	},
 	[5] = {
 		.name	= "SPARE",
-		.size	= SZ_1M,
+		.size	= SZ_1M - SZ_128K,
 		.offset	= 0,
 	},
+	[6] = {
+		.name	= "KLOG",
+		.size	= SZ_128K,
+		.offset	= SZ_1M - SZ_128K,
+	},
 };
 #endif
 
@@ -198,26 +230,50 @@ static struct s3c2410_nand_set lbookv3_nand_sets[] = {
 		.name		= "NAND",
 		.nr_chips	= 1,
 		.nr_partitions	= ARRAY_SIZE(lbookv3_nand_part),
-		.partitions	= lbookv3_nand_part
+		.partitions	= lbookv3_nand_part,
+		.translate_limit = LBOOKV3_STORAGE_OFFSET,
+		.nr_spare_blocks = LBOOKV3_NAND_SPARE_BLOCKS,
 	},
 };
 
 /* choose a set of timings which should suit most 512Mbit
- * chips and beyond.
+ * chips and beyond. The large page Samsung and Hynix parts fitted
+ * to these boards have tCLS = tWP = tRP = 12ns, tWH = 10ns and
+ * tREA = 20ns, which the driver checks against the chip before
+ * switching over.
+ *
+ * TWRPH0 is the nWE/nRE low time, and for reads the data has to be
+ * valid before nRE rises, so it is the longer of tWP/tRP and tREA
+ * plus the setup the controller needs to latch the bus. That gives
+ * 3 HCLKs, about 30ns, at 101.4MHz; plain tWP would only be 2, and
+ * 19.7ns is short of tREA.
 */
 
+#define LBOOKV3_NAND_TREA	20
+#define LBOOKV3_NAND_TSETUP	5
+#define LBOOKV3_NAND_TWRPH0	(LBOOKV3_NAND_TREA + LBOOKV3_NAND_TSETUP)
+
+static struct s3c2410_nand_timing lbookv3_nand_timings[] = {
+	{ .maf_id = NAND_MFR_SAMSUNG, .dev_id = 0xf1,	/* K9F1G08U0 */
+	  .tacls = 12, .twrph0 = LBOOKV3_NAND_TWRPH0, .twrph1 = 10 },
+	{ .maf_id = NAND_MFR_SAMSUNG, .dev_id = 0xda,	/* K9F2G08U0 */
+	  .tacls = 12, .twrph0 = LBOOKV3_NAND_TWRPH0, .twrph1 = 10 },
+	{ .maf_id = NAND_MFR_SAMSUNG, .dev_id = 0xdc,	/* K9F4G08U0 */
+	  .tacls = 12, .twrph0 = LBOOKV3_NAND_TWRPH0, .twrph1 = 10 },
+	{ .maf_id = NAND_MFR_HYNIX, .dev_id = 0xf1,	/* HY27UF081G2A */
+	  .tacls = 12, .twrph0 = LBOOKV3_NAND_TWRPH0, .twrph1 = 10 },
+	{ .maf_id = NAND_MFR_HYNIX, .dev_id = 0xda,	/* HY27UF082G2A */
+	  .tacls = 12, .twrph0 = LBOOKV3_NAND_TWRPH0, .twrph1 = 10 },
+	{ .maf_id = NAND_MFR_HYNIX, .dev_id = 0xdc,	/* HY27UF084G2M */
+	  .tacls = 12, .twrph0 = LBOOKV3_NAND_TWRPH0, .twrph1 = 10 },
+};
 
 static struct s3c2410_platform_nand lbookv3_nand_info = {
-//#ifdef CONFIG_ARCH_LBOOK_V3_EXT
-#if 0
-	.tacls		= 12,
-	.twrph0		= 12,
-	.twrph1		= 10,
-#else
 	.tacls		= 30,
 	.twrph0		= 60,
 	.twrph1		= 30,
-#endif
+	.nr_timings	= ARRAY_SIZE(lbookv3_nand_timings),
+	.timings	= lbookv3_nand_timings,
 	.nr_sets	= ARRAY_SIZE(lbookv3_nand_sets),
 	.sets		= lbookv3_nand_sets,
 };
@@ -429,27 +485,125 @@ static struct platform_device lbookv3_speaker = {
 	.id		= -1,
 };
 
+/* Devices needed to show the first page: registered from lbookv3_init() */
 static struct platform_device *lbookv3_devices[] __initdata = {
+	&s3c_device_nand,
+	&s3c_device_rtc,
+	&lbookv3_apollo,
+	&lbookv3_keys,
+};
+
+/* Everything else: registered from a low-priority work item later */
+static struct platform_device *lbookv3_deferred_devices[] = {
 	&s3c_device_wdt,
 	&s3c_device_i2c,
 	&s3c_device_iis,
 	&s3c_device_usbgadget,
 	&s3c_device_usb,
-	&s3c_device_nand,
-	&s3c_device_rtc,
 	&s3c_device_adc,
 	&s3c_device_spi0,
 	&s3c_device_sdi,
 	&s3c_device_timer[0],
+	&s3c_device_timer[1],
 	&lbookv3_led_red,
 	&lbookv3_led_green,
 	&lbookv3_device_nor,
-	&lbookv3_apollo,
-	&lbookv3_keys,
 	&lbookv3_battery,
 	&lbookv3_speaker,
 };
 
+/* time taken by each deferred registration (including the probe), in us */
+static s64 lbookv3_deferred_time[ARRAY_SIZE(lbookv3_deferred_devices)];
+
+static unsigned int lbookv3_defer_ms = 500;
+
+static int __init lbookv3_defer_setup(char *str)
+{
+	lbookv3_defer_ms = simple_strtoul(str, NULL, 0);
+	return 1;
+}
+
+__setup("lbookv3_defer=", lbookv3_defer_setup);
+
+static struct workqueue_struct *lbookv3_defer_wq;
+
+static void lbookv3_deferred_register(struct work_struct *work)
+{
+	ktime_t start;
+	int i, ret;
+
+	/* stay out of the way of init and the first page render */
+	set_user_nice(current, 19);
+
+	for (i = 0; i < ARRAY_SIZE(lbookv3_deferred_devices); i++) {
+		struct platform_device *pdev = lbookv3_deferred_devices[i];
+
+		start = ktime_get();
+		ret = platform_device_register(pdev);
+		lbookv3_deferred_time[i] = ktime_us_delta(ktime_get(), start);
+
+		if (ret)
+			printk(KERN_ERR "lbookv3: failed to register %s: %d\n",
+			       dev_name(&pdev->dev), ret);
+	}
+
+	set_user_nice(current, 0);
+}
+
+static DECLARE_DELAYED_WORK(lbookv3_defer_work, lbookv3_deferred_register);
+
+#ifdef CONFIG_DEBUG_FS
+static int lbookv3_defer_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(lbookv3_deferred_devices); i++)
+		seq_printf(s, "%-24s %lld us\n",
+			   dev_name(&lbookv3_deferred_devices[i]->dev),
+			   lbookv3_deferred_time[i]);
+
+	return 0;
+}
+
+static int lbookv3_defer_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lbookv3_defer_show, NULL);
+}
+
+static const struct file_operations lbookv3_defer_fops = {
+	.open		= lbookv3_defer_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+/* Queued once all the drivers have registered, before init is started. */
+static int __init lbookv3_defer_init(void)
+{
+	if (!machine_is_lbook_v3())
+		return 0;
+
+	lbookv3_defer_wq = create_singlethread_workqueue("lbookv3_defer");
+	if (!lbookv3_defer_wq) {
+		/* fall back to registering everything now */
+		lbookv3_deferred_register(NULL);
+		return 0;
+	}
+
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("lbookv3_probe_times", S_IRUGO, NULL, NULL,
+			    &lbookv3_defer_fops);
+#endif
+
+	queue_delayed_work(lbookv3_defer_wq, &lbookv3_defer_work,
+			   msecs_to_jiffies(lbookv3_defer_ms));
+
+	return 0;
+}
+
+late_initcall(lbookv3_defer_init);
+
 static void lbookv3_power_off(void)
 {
 	/* Voodoo from original kernel */
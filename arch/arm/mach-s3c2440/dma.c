@@ -132,6 +132,13 @@ static struct s3c24xx_dma_map __initdata s3c2440_dma_mappings[] = {
 		.name		= "usb-ep4",
 		.channels[3]	= S3C2410_DCON_CH3_USBEP4 | DMA_CH_VALID,
 	},
+	[DMACH_MEM] = {
+		.name		= "memory",
+		.channels[0]	= DMA_CH_VALID,
+		.channels[1]	= DMA_CH_VALID,
+		.channels[2]	= DMA_CH_VALID,
+		.channels[3]	= DMA_CH_VALID,
+	},
 };
 
 static void s3c2440_dma_select(struct s3c2410_dma_chan *chan,
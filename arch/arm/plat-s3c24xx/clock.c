@@ -39,6 +39,10 @@
 #include <linux/clk.h>
 #include <linux/mutex.h>
 #include <linux/delay.h>
+#include <linux/spinlock.h>
+#include <linux/jiffies.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <mach/hardware.h>
 #include <asm/irq.h>
@@ -48,6 +52,7 @@
 #include <mach/regs-gpio.h>
 
 #include <asm/plat-s3c24xx/clock.h>
+#include <asm/plat-s3c24xx/clock-idle.h>
 #include <asm/plat-s3c24xx/cpu.h>
 
 /* clock information */
@@ -56,6 +61,13 @@ static LIST_HEAD(clocks);
 
 DEFINE_MUTEX(clocks_mutex);
 
+/* clocks_lock serialises the hardware enable calls, which may now also
+ * be made from the idle timers, and protects the usage count and the
+ * idle state. clocks_mutex is still held around the usage changes, to
+ * keep them in order with the idle timer being stopped. */
+
+static DEFINE_SPINLOCK(clocks_lock);
+
 /* enable and disable calls for use with the clk struct */
 
 static int clk_null_enable(struct clk *clk, int enable)
@@ -63,6 +75,20 @@ static int clk_null_enable(struct clk *clk, int enable)
 	return 0;
 }
 
+/* call with clocks_lock held */
+
+static void clk_hw_enable(struct clk *clk, int enable)
+{
+	(clk->enable)(clk, enable);
+
+	if (enable && !clk->hw_on)
+		clk->on_since = jiffies;
+	else if (!enable && clk->hw_on)
+		clk->on_time += jiffies - clk->on_since;
+
+	clk->hw_on = enable;
+}
+
 /* Clock API calls */
 
 struct clk *clk_get(struct device *dev, const char *id)
@@ -111,29 +137,51 @@ void clk_put(struct clk *clk)
 
 int clk_enable(struct clk *clk)
 {
+	unsigned long flags;
+
 	if (IS_ERR(clk) || clk == NULL)
 		return -EINVAL;
 
 	clk_enable(clk->parent);
 
 	mutex_lock(&clocks_mutex);
+	spin_lock_irqsave(&clocks_lock, flags);
 
-	if ((clk->usage++) == 0)
-		(clk->enable)(clk, 1);
+	if ((clk->usage++) == 0) {
+		clk->gated = 0;
+		clk_hw_enable(clk, 1);
+	}
 
+	spin_unlock_irqrestore(&clocks_lock, flags);
 	mutex_unlock(&clocks_mutex);
 	return 0;
 }
 
 void clk_disable(struct clk *clk)
 {
+	unsigned long flags;
+	int off = 0;
+
 	if (IS_ERR(clk) || clk == NULL)
 		return;
 
 	mutex_lock(&clocks_mutex);
+	spin_lock_irqsave(&clocks_lock, flags);
 
-	if ((--clk->usage) == 0)
-		(clk->enable)(clk, 0);
+	if ((--clk->usage) == 0) {
+		if (!clk->gated)
+			clk_hw_enable(clk, 0);
+		clk->gated = 0;
+		off = 1;
+	}
+
+	spin_unlock_irqrestore(&clocks_lock, flags);
+
+	/* the timer does nothing once usage is 0, but must not be left
+	 * to run after the caller has gone */
+
+	if (off && clk->idle_timeout)
+		del_timer_sync(&clk->idle_timer);
 
 	mutex_unlock(&clocks_mutex);
 	clk_disable(clk->parent);
@@ -220,6 +268,140 @@ EXPORT_SYMBOL(clk_set_rate);
 EXPORT_SYMBOL(clk_get_parent);
 EXPORT_SYMBOL(clk_set_parent);
 
+/* runtime idle gating
+ *
+ * A driver which keeps its clock enabled for the lifetime of the device
+ * can let the clock be gated while the block is idle. Only the clock's
+ * own enable bit is touched, the parents are left running.
+*/
+
+static void clk_idle_timeout(unsigned long data)
+{
+	struct clk *clk = (struct clk *)data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&clocks_lock, flags);
+
+	if (clk->usage && !clk->active && !clk->gated) {
+		clk_hw_enable(clk, 0);
+		clk->gated = 1;
+		clk->gate_count++;
+	}
+
+	spin_unlock_irqrestore(&clocks_lock, flags);
+}
+
+int s3c24xx_clk_idle_init(struct clk *clk, unsigned int timeout_ms)
+{
+	if (IS_ERR(clk) || clk == NULL)
+		return -EINVAL;
+
+	mutex_lock(&clocks_mutex);
+
+	if (clk->idle_timeout)
+		del_timer_sync(&clk->idle_timer);
+
+	spin_lock_irq(&clocks_lock);
+
+	if (clk->gated) {
+		clk_hw_enable(clk, 1);
+		clk->gated = 0;
+	}
+
+	clk->idle_timeout = msecs_to_jiffies(timeout_ms);
+	setup_timer(&clk->idle_timer, clk_idle_timeout, (unsigned long)clk);
+
+	if (clk->idle_timeout && !clk->active)
+		mod_timer(&clk->idle_timer, jiffies + clk->idle_timeout);
+
+	spin_unlock_irq(&clocks_lock);
+	mutex_unlock(&clocks_mutex);
+
+	return 0;
+}
+
+void s3c24xx_clk_active_get(struct clk *clk)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&clocks_lock, flags);
+
+	if (clk->active++ == 0 && clk->gated) {
+		clk_hw_enable(clk, 1);
+		clk->gated = 0;
+	}
+
+	spin_unlock_irqrestore(&clocks_lock, flags);
+}
+
+void s3c24xx_clk_active_put(struct clk *clk)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&clocks_lock, flags);
+
+	if (--clk->active == 0 && clk->idle_timeout && clk->usage)
+		mod_timer(&clk->idle_timer, jiffies + clk->idle_timeout);
+
+	spin_unlock_irqrestore(&clocks_lock, flags);
+}
+
+EXPORT_SYMBOL(s3c24xx_clk_idle_init);
+EXPORT_SYMBOL(s3c24xx_clk_active_get);
+EXPORT_SYMBOL(s3c24xx_clk_active_put);
+
+#ifdef CONFIG_DEBUG_FS
+
+static int clk_debugfs_show(struct seq_file *s, void *unused)
+{
+	unsigned long on_time;
+	struct clk *clk;
+
+	seq_printf(s, "%-12s %3s %5s %6s %5s %10s %8s\n", "clock", "id",
+		   "usage", "active", "state", "on (ms)", "gated");
+
+	mutex_lock(&clocks_mutex);
+	spin_lock_irq(&clocks_lock);
+
+	list_for_each_entry(clk, &clocks, list) {
+		on_time = clk->on_time;
+		if (clk->hw_on)
+			on_time += jiffies - clk->on_since;
+
+		seq_printf(s, "%-12s %3d %5d %6d %5s %10u %8lu\n",
+			   clk->name, clk->id, clk->usage, clk->active,
+			   clk->gated ? "gated" : (clk->hw_on ? "on" : "off"),
+			   jiffies_to_msecs(on_time), clk->gate_count);
+	}
+
+	spin_unlock_irq(&clocks_lock);
+	mutex_unlock(&clocks_mutex);
+
+	return 0;
+}
+
+static int clk_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, clk_debugfs_show, NULL);
+}
+
+static const struct file_operations clk_debugfs_fops = {
+	.open		= clk_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init clk_debugfs_init(void)
+{
+	debugfs_create_file("clocks", S_IRUGO, NULL, NULL, &clk_debugfs_fops);
+	return 0;
+}
+
+late_initcall(clk_debugfs_init);
+
+#endif /* CONFIG_DEBUG_FS */
+
 /* base clocks */
 
 static int clk_default_setrate(struct clk *clk, unsigned long rate)
@@ -26,6 +26,8 @@
 #include <linux/slab.h>
 #include <linux/errno.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/system.h>
 #include <asm/irq.h>
@@ -305,6 +307,30 @@ s3c2410_dma_call_op(struct s3c2410_dma_chan *chan, enum s3c2410_chan_op op)
 	}
 }
 
+/* s3c2410_dma_batchdone
+ *
+ * pass the buffers collected so far to the batched callback
+*/
+
+static void
+s3c2410_dma_batchdone(struct s3c2410_dma_chan *chan,
+		      enum s3c2410_dma_buffresult result)
+{
+	unsigned int nr = chan->batch_nr;
+	unsigned int size = chan->batch_size;
+
+	if (nr == 0)
+		return;
+
+	chan->batch_nr = 0;
+	chan->batch_size = 0;
+
+	if (chan->stats != NULL)
+		chan->stats->batches++;
+
+	(chan->batch_fn)(chan, chan->batch_id, nr, size, result);
+}
+
 /* s3c2410_dma_buffdone
  *
  * small wrapper to check if callback routine needs to be called, and
@@ -320,11 +346,48 @@ s3c2410_dma_buffdone(struct s3c2410_dma_chan *chan, struct s3c2410_dma_buf *buf,
 		 chan->callback_fn, buf, buf->id, buf->size, result);
 #endif
 
+	if (chan->batch_fn != NULL) {
+		chan->batch_id = buf->id;
+		chan->batch_nr++;
+		chan->batch_size += buf->size;
+
+		/* hold on to it while more are queued behind it */
+		if (result == S3C2410_RES_OK && chan->curr != NULL &&
+		    chan->batch_nr < chan->batch_max)
+			return;
+
+		s3c2410_dma_batchdone(chan, result);
+		return;
+	}
+
 	if (chan->callback_fn != NULL) {
 		(chan->callback_fn)(chan, buf->id, buf->size, result);
 	}
 }
 
+/* s3c2410_dma_restart
+ *
+ * turn the channel back on for a buffer that was loaded after the
+ * engine had already stopped
+*/
+
+static void s3c2410_dma_restart(struct s3c2410_dma_chan *chan)
+{
+	unsigned long tmp;
+
+	if (chan->stats != NULL)
+		chan->stats->underruns++;
+
+	tmp = dma_rdreg(chan, S3C2410_DMA_DMASKTRIG);
+	tmp &= ~S3C2410_DMASKTRIG_STOP;
+	tmp |= S3C2410_DMASKTRIG_ON;
+
+	if (chan->flags & S3C2410_DMAF_SWTRIG)
+		tmp |= S3C2410_DMASKTRIG_SWTRIG;
+
+	dma_wrreg(chan, S3C2410_DMA_DMASKTRIG, tmp);
+}
+
 /* s3c2410_dma_start
  *
  * start a dma channel going
@@ -377,6 +440,12 @@ static int s3c2410_dma_start(struct s3c2410_dma_chan *chan)
 	tmp = dma_rdreg(chan, S3C2410_DMA_DMASKTRIG);
 	tmp &= ~S3C2410_DMASKTRIG_STOP;
 	tmp |= S3C2410_DMASKTRIG_ON;
+
+	/* a software triggered channel has no request line to wait for */
+
+	if (chan->flags & S3C2410_DMAF_SWTRIG)
+		tmp |= S3C2410_DMASKTRIG_SWTRIG;
+
 	dma_wrreg(chan, S3C2410_DMA_DMASKTRIG, tmp);
 
 	pr_debug("dma%d: %08lx to DMASKTRIG\n", chan->number, tmp);
@@ -602,11 +671,15 @@ s3c2410_dma_irq(int irq, void *devpw)
 {
 	struct s3c2410_dma_chan *chan = (struct s3c2410_dma_chan *)devpw;
 	struct s3c2410_dma_buf  *buf;
+	int was_empty;
 
 	buf = chan->curr;
 
 	dbg_showchan(chan);
 
+	if (chan->stats != NULL)
+		chan->stats->irqs++;
+
 	/* modify the channel state */
 
 	switch (chan->load_state) {
@@ -628,13 +701,17 @@ s3c2410_dma_irq(int irq, void *devpw)
 		break;
 
 	case S3C2410_DMALOAD_1LOADED_1RUNNING:
-		/* we'll worry about checking to see if another buffer is
-		 * ready after we've called back the owner. This should
-		 * ensure we do not wait around too long for the DMA
-		 * engine to start the next transfer
+		/* the engine should have reloaded the buffer behind the
+		 * one which finished. If the reload had already been
+		 * turned off by s3c2410_dma_lastxfer() when that buffer
+		 * was queued, it has stopped instead, so start it again.
 		 */
 
 		chan->load_state = S3C2410_DMALOAD_1LOADED;
+
+		if (!(dma_rdreg(chan, S3C2410_DMA_DMASKTRIG) &
+		      S3C2410_DMASKTRIG_ON))
+			s3c2410_dma_restart(chan);
 		break;
 
 	case S3C2410_DMALOAD_NONE:
@@ -661,68 +738,87 @@ s3c2410_dma_irq(int irq, void *devpw)
 			       chan->number, __func__, buf);
 			return IRQ_HANDLED;
 		}
-
-		s3c2410_dma_buffdone(chan, buf, S3C2410_RES_OK);
-
-		/* free resouces */
-		s3c2410_dma_freebuf(buf);
-	} else {
 	}
 
-	/* only reload if the channel is still running... our buffer done
-	 * routine may have altered the state by requesting the dma channel
-	 * to stop or shutdown... */
+	/* get the next buffer into the reload registers before calling
+	 * back the owner, so the engine is not left waiting on it. With
+	 * nothing left to load, turn off the reload of the buffer which
+	 * is now running as soon as possible. */
 
-	/* todo: check that when the channel is shut-down from inside this
-	 * function, we cope with unsetting reload, etc */
-
-	if (chan->next != NULL && chan->state != S3C2410_DMA_IDLE) {
-		unsigned long flags;
+	was_empty = (chan->load_state == S3C2410_DMALOAD_NONE);
 
+	if (chan->state != S3C2410_DMA_IDLE) {
 		switch (chan->load_state) {
-		case S3C2410_DMALOAD_1RUNNING:
-			/* don't need to do anything for this state */
-			break;
-
 		case S3C2410_DMALOAD_NONE:
-			/* can load buffer immediately */
-			break;
+			/* the engine has stopped, the load picks the reload
+			 * mode and it is started again below */
+			if (chan->next != NULL)
+				s3c2410_dma_loadbuffer(chan, chan->next);
+			goto done;
 
 		case S3C2410_DMALOAD_1LOADED:
+			if (chan->next == NULL)
+				break;
+
 			if (s3c2410_dma_waitforload(chan, __LINE__) == 0) {
 				/* flag error? */
 				printk(KERN_ERR "dma%d: timeout waiting for load (%s)\n",
 				       chan->number, __func__);
-				return IRQ_HANDLED;
+				goto done;
 			}
 
+			s3c2410_dma_loadbuffer(chan, chan->next);
+			break;
+
+		case S3C2410_DMALOAD_1RUNNING:
+			if (chan->next != NULL)
+				s3c2410_dma_loadbuffer(chan, chan->next);
 			break;
 
 		case S3C2410_DMALOAD_1LOADED_1RUNNING:
-			goto no_load;
+			break;
 
 		default:
 			printk(KERN_ERR "dma%d: unknown load_state in irq, %d\n",
 			       chan->number, chan->load_state);
-			return IRQ_HANDLED;
+			goto done;
 		}
 
-		local_irq_save(flags);
-		s3c2410_dma_loadbuffer(chan, chan->next);
-		local_irq_restore(flags);
-	} else {
-		s3c2410_dma_lastxfer(chan);
+		if (chan->next == NULL)
+			s3c2410_dma_lastxfer(chan);
+	}
 
-		/* see if we can stop this channel.. */
-		if (chan->load_state == S3C2410_DMALOAD_NONE) {
-			pr_debug("dma%d: end of transfer, stopping channel (%ld)\n",
-				 chan->number, jiffies);
-			s3c2410_dma_ctrl(chan->number | DMACH_LOW_LEVEL,
-					 S3C2410_DMAOP_STOP);
+ done:
+	if (buf != NULL) {
+		if (chan->stats != NULL) {
+			chan->stats->buffers++;
+			chan->stats->bytes += buf->size;
 		}
+
+		s3c2410_dma_buffdone(chan, buf, S3C2410_RES_OK);
+
+		/* free resouces */
+		s3c2410_dma_freebuf(buf);
+	}
+
+	/* only reload if the channel is still running... our buffer done
+	 * routine may have altered the state by requesting the dma channel
+	 * to stop or shutdown... */
+
+	if (chan->state == S3C2410_DMA_IDLE)
+		return IRQ_HANDLED;
+
+	if (chan->load_state == S3C2410_DMALOAD_NONE) {
+		pr_debug("dma%d: end of transfer, stopping channel (%ld)\n",
+			 chan->number, jiffies);
+		s3c2410_dma_ctrl(chan->number | DMACH_LOW_LEVEL,
+				 S3C2410_DMAOP_STOP);
+	} else if (was_empty) {
+		/* a buffer was queued after the engine had run dry, and
+		 * has only been loaded */
+		s3c2410_dma_restart(chan);
 	}
 
- no_load:
 	return IRQ_HANDLED;
 }
 
@@ -831,6 +927,9 @@ int s3c2410_dma_free(dmach_t channel, struct s3c2410_dma_client *client)
 
 	chan->client = NULL;
 	chan->in_use = 0;
+	chan->batch_fn = NULL;
+	chan->batch_nr = 0;
+	chan->batch_size = 0;
 
 	if (chan->irq_claimed)
 		free_irq(chan->irq, (void *)chan);
@@ -924,6 +1023,10 @@ static int s3c2410_dma_flush(struct s3c2410_dma_chan *chan)
 
 	chan->curr = chan->next = chan->end = NULL;
 
+	/* anything finished but not yet reported goes first */
+	if (chan->batch_fn != NULL)
+		s3c2410_dma_batchdone(chan, S3C2410_RES_OK);
+
 	if (buf != NULL) {
 		for ( ; buf != NULL; buf = next) {
 			next = buf->next;
@@ -931,11 +1034,21 @@ static int s3c2410_dma_flush(struct s3c2410_dma_chan *chan)
 			pr_debug("%s: free buffer %p, next %p\n",
 			       __func__, buf, buf->next);
 
-			s3c2410_dma_buffdone(chan, buf, S3C2410_RES_ABORT);
+			if (chan->batch_fn != NULL) {
+				chan->batch_id = buf->id;
+				chan->batch_nr++;
+				chan->batch_size += buf->size;
+			} else
+				s3c2410_dma_buffdone(chan, buf,
+						     S3C2410_RES_ABORT);
+
 			s3c2410_dma_freebuf(buf);
 		}
 	}
 
+	if (chan->batch_fn != NULL)
+		s3c2410_dma_batchdone(chan, S3C2410_RES_ABORT);
+
 	dbg_showregs(chan);
 
 	s3c2410_dma_waitforstop(chan);
@@ -1079,7 +1192,9 @@ int s3c2410_dma_config(dmach_t channel,
 		return -EINVAL;
 	}
 
-	dcon |= S3C2410_DCON_HWTRIG;
+	if (!(chan->flags & S3C2410_DMAF_SWTRIG))
+		dcon |= S3C2410_DCON_HWTRIG;
+
 	dcon |= S3C2410_DCON_INTREQ;
 
 	pr_debug("%s: dcon now %08x\n", __func__, dcon);
@@ -1145,6 +1260,32 @@ int s3c2410_dma_set_buffdone_fn(dmach_t channel, s3c2410_dma_cbfn_t rtn)
 
 EXPORT_SYMBOL(s3c2410_dma_set_buffdone_fn);
 
+int s3c2410_dma_set_batchdone_fn(dmach_t channel, s3c2410_dma_batchfn_t rtn,
+				 unsigned int max)
+{
+	struct s3c2410_dma_chan *chan = lookup_dma_channel(channel);
+	unsigned long flags;
+
+	if (chan == NULL)
+		return -EINVAL;
+
+	pr_debug("%s: chan=%p, batch rtn=%p, max %u\n",
+		 __func__, chan, rtn, max);
+
+	local_irq_save(flags);
+
+	chan->batch_fn = rtn;
+	chan->batch_max = max ? max : 1;
+	chan->batch_nr = 0;
+	chan->batch_size = 0;
+
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+EXPORT_SYMBOL(s3c2410_dma_set_batchdone_fn);
+
 /* s3c2410_dma_devconfig
  *
  * configure the dma source/destination hardware type and address
@@ -1302,6 +1443,74 @@ struct sysdev_class dma_sysclass = {
 	.resume		= s3c2410_dma_resume,
 };
 
+/* debugfs statistics */
+
+#ifdef CONFIG_DEBUG_FS
+
+static const char *s3c2410_dma_state_names[] = {
+	[S3C2410_DMA_IDLE]	= "idle",
+	[S3C2410_DMA_RUNNING]	= "running",
+	[S3C2410_DMA_PAUSED]	= "paused",
+};
+
+static int s3c2410_dma_stats_show(struct seq_file *m, void *v)
+{
+	struct s3c2410_dma_chan *cp;
+	struct s3c2410_dma_stats st;
+	unsigned long flags;
+	const char *client;
+	int state;
+	int channel;
+
+	seq_printf(m, "ch client       state   irqs       buffers    bytes"
+		   "        underruns batches   loads      load timeouts\n");
+
+	for (channel = 0; channel < dma_channels; channel++) {
+		cp = &s3c2410_chans[channel];
+
+		local_irq_save(flags);
+		st = *cp->stats;
+		state = cp->state;
+		client = (cp->in_use && cp->client) ? cp->client->name : "-";
+		local_irq_restore(flags);
+
+		seq_printf(m, "%2d %-12s %-7s %-10lu %-10lu %-12llu %-9lu "
+			   "%-9lu %-10lu %lu\n", cp->number, client,
+			   s3c2410_dma_state_names[state], st.irqs,
+			   st.buffers, st.bytes, st.underruns, st.batches,
+			   st.loads, st.timeout_failed);
+	}
+
+	return 0;
+}
+
+static int s3c2410_dma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, s3c2410_dma_stats_show, NULL);
+}
+
+static const struct file_operations s3c2410_dma_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= s3c2410_dma_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init s3c24xx_dma_debugfs_init(void)
+{
+	if (dma_base == NULL)
+		return 0;
+
+	debugfs_create_file("s3c24xx-dma", S_IRUGO, NULL, NULL,
+			    &s3c2410_dma_stats_fops);
+	return 0;
+}
+
+late_initcall(s3c24xx_dma_debugfs_init);
+
+#endif /* CONFIG_DEBUG_FS */
+
 /* kmem cache implementation */
 
 static void s3c2410_dma_cache_ctor(void *p)
@@ -1445,11 +1654,15 @@ static struct s3c2410_dma_chan *s3c2410_dma_map_channel(int channel)
 		ord = &dma_order->channels[channel];
 
 		for (ch = 0; ch < dma_channels; ch++) {
+			int tmp;
+
 			if (!is_channel_valid(ord->list[ch]))
 				continue;
 
-			if (s3c2410_chans[ord->list[ch]].in_use == 0) {
-				ch = ord->list[ch] & ~DMA_CH_VALID;
+			tmp = ord->list[ch] & ~DMA_CH_VALID;
+
+			if (s3c2410_chans[tmp].in_use == 0) {
+				ch = tmp;
 				goto found;
 			}
 		}
@@ -25,6 +25,8 @@
 #include <linux/irq.h>
 #include <linux/err.h>
 #include <linux/clk.h>
+#include <linux/clocksource.h>
+#include <linux/clockchips.h>
 
 #include <asm/system.h>
 #include <asm/leds.h>
@@ -40,89 +42,102 @@
 #include <asm/plat-s3c24xx/clock.h>
 #include <asm/plat-s3c24xx/cpu.h>
 
-static unsigned long timer_startval;
-static unsigned long timer_usec_ticks;
-
-#define TIMER_USEC_SHIFT 16
-
-/* we use the shifted arithmetic to work out the ratio of timer ticks
- * to usecs, as often the peripheral clock is not a nice even multiple
- * of 1MHz.
+/* Timer 4 (which has no output pin) is the clock event device, and
+ * timer 3 runs free as the clocksource. Both are fed from prescaler 1,
+ * which timer 2 also shares.
  *
- * shift of 14 and 15 are too low for the 12MHz, 16 seems to be ok
- * for the current HZ value of 200 without producing overflows.
+ * The timers are only 16 bits wide, so the rates are a trade between
+ * resolution and how long the system can sleep. The clocksource must
+ * not wrap between two timekeeping updates, so the event timer runs at
+ * twice its rate: the longest event we can program is then half the
+ * clocksource period.
  *
- * Original patch by Dimitry Andric, updated by Ben Dooks
+ * With a 50.7MHz PCLK this gives 15.8us events up to 1.03s apart, and
+ * a 31.6us clocksource which wraps every 2.07s.
 */
 
+#define TIMER_PRESCALER		(100)
 
-/* timer_mask_usec_ticks
- *
- * given a clock and divisor, make the value to pass into timer_ticks_to_usec
- * to scale the ticks into usecs
-*/
+#define TIMER_EVT_DIV		(8)
+#define TIMER_EVT_MUX		S3C2410_TCFG1_MUX4_DIV8
 
-static inline unsigned long
-timer_mask_usec_ticks(unsigned long scaler, unsigned long pclk)
-{
-	unsigned long den = pclk / 1000;
+#define TIMER_SRC_DIV		(16)
+#define TIMER_SRC_MUX		S3C2410_TCFG1_MUX3_DIV16
 
-	return ((1000 << TIMER_USEC_SHIFT) * scaler + (den >> 1)) / den;
-}
+#define TIMER_SRC_SHIFT		(12)
 
-/* timer_ticks_to_usec
+static unsigned long timer_evt_rate;
+static unsigned long timer_src_rate;
+
+/* timer_evt_start
  *
- * convert timer ticks to usec.
+ * load timer 4 with the given count and start it, auto-reloading if
+ * periodic. Called with interrupts disabled.
 */
 
-static inline unsigned long timer_ticks_to_usec(unsigned long ticks)
+static void timer_evt_start(unsigned long tcnt, int periodic)
 {
-	unsigned long res;
-
-	res = ticks * timer_usec_ticks;
-	res += 1 << (TIMER_USEC_SHIFT - 4);	/* round up slightly */
-
-	return res >> TIMER_USEC_SHIFT;
-}
+	unsigned long tcon;
 
-/***
- * Returns microsecond  since last clock interrupt.  Note that interrupts
- * will have been disabled by do_gettimeoffset()
- * IRQs are disabled before entering here from do_gettimeofday()
- */
+	tcon = __raw_readl(S3C2410_TCON);
+	tcon &= ~(S3C2410_TCON_T4START | S3C2410_TCON_T4RELOAD);
+	__raw_writel(tcon, S3C2410_TCON);
 
-#define SRCPND_TIMER4 (1<<(IRQ_TIMER4 - IRQ_EINT0))
+	__raw_writel(tcnt - 1, S3C2410_TCNTB(4));
 
-static unsigned long s3c2410_gettimeoffset (void)
-{
-	unsigned long tdone;
-	unsigned long irqpend;
-	unsigned long tval;
+	__raw_writel(tcon | S3C2410_TCON_T4MANUALUPD, S3C2410_TCON);
 
-	/* work out how many ticks have gone since last timer interrupt */
+	tcon |= S3C2410_TCON_T4START;
+	if (periodic)
+		tcon |= S3C2410_TCON_T4RELOAD;
 
-        tval =  __raw_readl(S3C2410_TCNTO(4));
-	tdone = timer_startval - tval;
+	__raw_writel(tcon, S3C2410_TCON);
+}
 
-	/* check to see if there is an interrupt pending */
+static void timer_evt_stop(void)
+{
+	unsigned long tcon;
 
-	irqpend = __raw_readl(S3C2410_SRCPND);
-	if (irqpend & SRCPND_TIMER4) {
-		/* re-read the timer, and try and fix up for the missed
-		 * interrupt. Note, the interrupt may go off before the
-		 * timer has re-loaded from wrapping.
-		 */
+	tcon = __raw_readl(S3C2410_TCON);
+	tcon &= ~(S3C2410_TCON_T4START | S3C2410_TCON_T4RELOAD);
+	__raw_writel(tcon, S3C2410_TCON);
+}
 
-		tval =  __raw_readl(S3C2410_TCNTO(4));
-		tdone = timer_startval - tval;
+static int s3c2410_timer_set_next_event(unsigned long cycles,
+					struct clock_event_device *evt)
+{
+	timer_evt_start(cycles, 0);
+	return 0;
+}
 
-		if (tval != 0)
-			tdone += timer_startval;
+static void s3c2410_timer_set_mode(enum clock_event_mode mode,
+				   struct clock_event_device *evt)
+{
+	switch (mode) {
+	case CLOCK_EVT_MODE_PERIODIC:
+		timer_evt_start(timer_evt_rate / HZ, 1);
+		break;
+
+	case CLOCK_EVT_MODE_ONESHOT:
+	case CLOCK_EVT_MODE_UNUSED:
+	case CLOCK_EVT_MODE_SHUTDOWN:
+		timer_evt_stop();
+		break;
+
+	case CLOCK_EVT_MODE_RESUME:
+		break;
 	}
-
-	return timer_ticks_to_usec(tdone);
 }
 
+static struct clock_event_device s3c2410_clockevent = {
+	.name		= "s3c2410-timer4",
+	.features	= CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT,
+	.shift		= 32,
+	.rating		= 200,
+	.irq		= IRQ_TIMER4,
+	.set_next_event	= s3c2410_timer_set_next_event,
+	.set_mode	= s3c2410_timer_set_mode,
+};
 
 /*
  * IRQ handler for the timer
@@ -130,7 +145,9 @@ static unsigned long s3c2410_gettimeoffset (void)
 static irqreturn_t
 s3c2410_timer_interrupt(int irq, void *dev_id)
 {
-	timer_tick();
+	struct clock_event_device *evt = &s3c2410_clockevent;
+
+	evt->event_handler(evt);
 	return IRQ_HANDLED;
 }
 
@@ -140,121 +157,103 @@ static struct irqaction s3c2410_timer_irq = {
 	.handler	= s3c2410_timer_interrupt,
 };
 
-#define use_tclk1_12() ( \
-	machine_is_bast()	|| \
-	machine_is_vr1000()	|| \
-	machine_is_anubis()	|| \
-	machine_is_osiris() )
+/* timer 3 counts down from 0xffff, so invert it to get a rising count */
+
+static cycle_t s3c2410_timer_read(void)
+{
+	return (cycle_t)(0xffff - __raw_readl(S3C2410_TCNTO(3)));
+}
+
+static struct clocksource s3c2410_clocksource = {
+	.name		= "s3c2410-timer3",
+	.rating		= 200,
+	.read		= s3c2410_timer_read,
+	.mask		= CLOCKSOURCE_MASK(16),
+	.shift		= TIMER_SRC_SHIFT,
+	.flags		= CLOCK_SOURCE_IS_CONTINUOUS,
+};
 
 /*
- * Set up timer interrupt, and return the current time in seconds.
- *
- * Currently we only use timer4, as it is the only timer which has no
- * other function that can be exploited externally
+ * Set up the prescaler and dividers for timers 3 and 4, and start the
+ * clocksource running. The event timer is left stopped until the
+ * clockevents code selects a mode for it.
  */
 static void s3c2410_timer_setup (void)
 {
 	unsigned long tcon;
-	unsigned long tcnt;
 	unsigned long tcfg1;
 	unsigned long tcfg0;
 
-	tcnt = 0xffff;  /* default value for tcnt */
-
-	/* read the current timer configuration bits */
-
 	tcon = __raw_readl(S3C2410_TCON);
 	tcfg1 = __raw_readl(S3C2410_TCFG1);
 	tcfg0 = __raw_readl(S3C2410_TCFG0);
 
-	/* configure the system for whichever machine is in use */
-
-	if (use_tclk1_12()) {
-		/* timer is at 12MHz, scaler is 1 */
-		timer_usec_ticks = timer_mask_usec_ticks(1, 12000000);
-		tcnt = 12000000 / HZ;
-
-		tcfg1 &= ~S3C2410_TCFG1_MUX4_MASK;
-		tcfg1 |= S3C2410_TCFG1_MUX4_TCLK1;
-	} else {
-		unsigned long pclk;
-		struct clk *clk;
+	tcfg0 &= ~S3C2410_TCFG_PRESCALER1_MASK;
+	tcfg0 |= (TIMER_PRESCALER - 1) << S3C2410_TCFG_PRESCALER1_SHIFT;
 
-		/* for the h1940 (and others), we use the pclk from the core
-		 * to generate the timer values. since values around 50 to
-		 * 70MHz are not values we can directly generate the timer
-		 * value from, we need to pre-scale and divide before using it.
-		 *
-		 * for instance, using 50.7MHz and dividing by 6 gives 8.45MHz
-		 * (8.45 ticks per usec)
-		 */
+	tcfg1 &= ~(S3C2410_TCFG1_MUX4_MASK | S3C2410_TCFG1_MUX3_MASK);
+	tcfg1 |= TIMER_EVT_MUX | TIMER_SRC_MUX;
 
-		/* this is used as default if no other timer can be found */
+	printk(KERN_DEBUG "timer tcon=%08lx, tcfg %08lx,%08lx\n",
+	       tcon, tcfg0, tcfg1);
 
-		clk = clk_get(NULL, "timers");
-		if (IS_ERR(clk))
-			panic("failed to get clock for system timer");
+	__raw_writel(tcfg1, S3C2410_TCFG1);
+	__raw_writel(tcfg0, S3C2410_TCFG0);
 
-		clk_enable(clk);
+	/* ensure both timers are stopped... */
 
-		pclk = clk_get_rate(clk);
+	tcon &= ~(S3C2410_TCON_T4START | S3C2410_TCON_T4RELOAD);
+	tcon &= ~(S3C2410_TCON_T3START | S3C2410_TCON_T3RELOAD |
+		  S3C2410_TCON_T3INVERT);
+	__raw_writel(tcon, S3C2410_TCON);
 
-		/* configure clock tick */
+	/* ...and start timer 3 free-running over the full 16 bits */
 
-		timer_usec_ticks = timer_mask_usec_ticks(6, pclk);
+	__raw_writel(0xffff, S3C2410_TCNTB(3));
+	__raw_writel(0, S3C2410_TCMPB(3));
+	__raw_writel(tcon | S3C2410_TCON_T3MANUALUPD, S3C2410_TCON);
 
-		tcfg1 &= ~S3C2410_TCFG1_MUX4_MASK;
-		tcfg1 |= S3C2410_TCFG1_MUX4_DIV2;
+	tcon |= S3C2410_TCON_T3START | S3C2410_TCON_T3RELOAD;
+	__raw_writel(tcon, S3C2410_TCON);
+}
 
-		tcfg0 &= ~S3C2410_TCFG_PRESCALER1_MASK;
-		tcfg0 |= ((6 - 1) / 2) << S3C2410_TCFG_PRESCALER1_SHIFT;
+static void __init s3c2410_timer_init (void)
+{
+	struct clock_event_device *evt = &s3c2410_clockevent;
+	unsigned long pclk;
+	struct clk *clk;
 
-		tcnt = (pclk / 6) / HZ;
-	}
+	clk = clk_get(NULL, "timers");
+	if (IS_ERR(clk))
+		panic("failed to get clock for system timer");
 
-	/* timers reload after counting zero, so reduce the count by 1 */
+	clk_enable(clk);
 
-	tcnt--;
+	pclk = clk_get_rate(clk);
 
-	printk("timer tcon=%08lx, tcnt %04lx, tcfg %08lx,%08lx, usec %08lx\n",
-	       tcon, tcnt, tcfg0, tcfg1, timer_usec_ticks);
+	timer_evt_rate = pclk / (TIMER_PRESCALER * TIMER_EVT_DIV);
+	timer_src_rate = pclk / (TIMER_PRESCALER * TIMER_SRC_DIV);
 
-	/* check to see if timer is within 16bit range... */
-	if (tcnt > 0xffff) {
+	if (timer_evt_rate / HZ > 0x10000)
 		panic("setup_timer: HZ is too small, cannot configure timer!");
-		return;
-	}
-
-	__raw_writel(tcfg1, S3C2410_TCFG1);
-	__raw_writel(tcfg0, S3C2410_TCFG0);
 
-	timer_startval = tcnt;
-	__raw_writel(tcnt, S3C2410_TCNTB(4));
+	s3c2410_timer_setup();
 
-	/* ensure timer is stopped... */
+	s3c2410_clocksource.mult =
+		clocksource_hz2mult(timer_src_rate, s3c2410_clocksource.shift);
+	clocksource_register(&s3c2410_clocksource);
 
-	tcon &= ~(7<<20);
-	tcon |= S3C2410_TCON_T4RELOAD;
-	tcon |= S3C2410_TCON_T4MANUALUPD;
+	setup_irq(IRQ_TIMER4, &s3c2410_timer_irq);
 
-	__raw_writel(tcon, S3C2410_TCON);
-	__raw_writel(tcnt, S3C2410_TCNTB(4));
-	__raw_writel(tcnt, S3C2410_TCMPB(4));
+	evt->mult = div_sc(timer_evt_rate, NSEC_PER_SEC, evt->shift);
+	evt->max_delta_ns = clockevent_delta2ns(0xffff, evt);
+	evt->min_delta_ns = clockevent_delta2ns(2, evt);
+	evt->cpumask = cpumask_of_cpu(0);
 
-	/* start the timer running */
-	tcon |= S3C2410_TCON_T4START;
-	tcon &= ~S3C2410_TCON_T4MANUALUPD;
-	__raw_writel(tcon, S3C2410_TCON);
-}
-
-static void __init s3c2410_timer_init (void)
-{
-	s3c2410_timer_setup();
-	setup_irq(IRQ_TIMER4, &s3c2410_timer_irq);
+	clockevents_register_device(evt);
 }
 
 struct sys_timer s3c24xx_timer = {
 	.init		= s3c2410_timer_init,
-	.offset		= s3c2410_gettimeoffset,
 	.resume		= s3c2410_timer_setup
 };
@@ -1093,6 +1093,7 @@ void init_request_from_bio(struct request *req, struct bio *bio)
 	req->hard_sector = req->sector = bio->bi_sector;
 	req->ioprio = bio_prio(bio);
 	req->start_time = jiffies;
+	blk_latency_queued(req->q, req);
 	blk_rq_bio_prep(req->q, req, bio);
 }
 
@@ -1744,6 +1745,7 @@ static void end_that_request_last(struct request *req, int error)
 
 		__all_stat_inc(disk, part, ios[rw], req->sector);
 		__all_stat_add(disk, part, ticks[rw], duration, req->sector);
+		blk_latency_done(req->q, req);
 		disk_round_stats(disk);
 		disk->in_flight--;
 		if (part) {
@@ -0,0 +1,250 @@
+/*
+ * Request latency histograms
+ *
+ * For each queue with the histograms switched on, every fs request is
+ * accounted when it completes: the time it waited in the queue before
+ * the driver first saw it, and the time the driver took from then on.
+ * Both are kept per direction and by request size, in buckets of
+ * doubling width.
+ *
+ * The histograms are in debugfs as blk_latency/<disk>. Writing 1 to
+ * the file switches them on and clears them, writing 0 switches them
+ * off again. Switched off, a queue only has its latency pointer tested
+ * once per request.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/genhd.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/err.h>
+#include <asm/uaccess.h>
+
+#include "blk.h"
+
+/* bucket 0 is below 64us, the last one is from about a second on */
+#define BLK_LAT_BUCKETS		16
+#define BLK_LAT_SHIFT		6
+
+/* up to 4K, 16K, 64K and larger */
+#define BLK_LAT_SIZES		4
+
+struct blk_latency {
+	unsigned int		wait[2][BLK_LAT_SIZES][BLK_LAT_BUCKETS];
+	unsigned int		service[2][BLK_LAT_SIZES][BLK_LAT_BUCKETS];
+	unsigned int		count[2];
+	unsigned long long	wait_us[2];
+	unsigned long long	service_us[2];
+	unsigned long		since;
+};
+
+static const char *blk_latency_sizes[BLK_LAT_SIZES] = {
+	"<=4K", "<=16K", "<=64K", ">64K",
+};
+
+static struct dentry *blk_latency_root;
+static int blk_latency_users;
+
+static inline int blk_latency_bucket(s64 us)
+{
+	if (us < (1 << BLK_LAT_SHIFT))
+		return 0;
+
+	return min_t(int, fls((u32)min_t(s64, us, INT_MAX) >> BLK_LAT_SHIFT),
+		     BLK_LAT_BUCKETS - 1);
+}
+
+static inline int blk_latency_size(unsigned int sectors)
+{
+	if (sectors <= 8)
+		return 0;
+	if (sectors <= 32)
+		return 1;
+	if (sectors <= 128)
+		return 2;
+	return 3;
+}
+
+/*
+ * Called with the queue lock held, once the request is complete
+ */
+void __blk_latency_done(struct request_queue *q, struct request *rq)
+{
+	struct blk_latency *lat = q->latency;
+	const int rw = rq_data_dir(rq);
+	int size = blk_latency_size(rq->lat_sectors);
+	s64 wait, service;
+
+	wait = ktime_us_delta(rq->lat_started, rq->lat_queued);
+	service = ktime_us_delta(ktime_get(), rq->lat_started);
+
+	lat->wait[rw][size][blk_latency_bucket(wait)]++;
+	lat->service[rw][size][blk_latency_bucket(service)]++;
+	lat->count[rw]++;
+	lat->wait_us[rw] += wait;
+	lat->service_us[rw] += service;
+}
+
+static void blk_latency_show_hist(struct seq_file *m, const char *name,
+				  unsigned int hist[][BLK_LAT_BUCKETS])
+{
+	int size, b, last = 0;
+
+	for (size = 0; size < BLK_LAT_SIZES; size++)
+		for (b = 0; b < BLK_LAT_BUCKETS; b++)
+			if (hist[size][b] && b > last)
+				last = b;
+
+	seq_printf(m, "\n%-12s", name);
+	for (size = 0; size < BLK_LAT_SIZES; size++)
+		seq_printf(m, " %9s", blk_latency_sizes[size]);
+	seq_putc(m, '\n');
+
+	for (b = 0; b <= last; b++) {
+		seq_printf(m, "%10uus", b ? 1 << (b + BLK_LAT_SHIFT - 1) : 0);
+		for (size = 0; size < BLK_LAT_SIZES; size++)
+			seq_printf(m, " %9u", hist[size][b]);
+		seq_putc(m, '\n');
+	}
+}
+
+static int blk_latency_show(struct seq_file *m, void *v)
+{
+	struct request_queue *q = m->private;
+	struct blk_latency *lat;
+	static const char *dir[2] = { "read", "write" };
+	char name[16];
+	int rw;
+
+	lat = kmalloc(sizeof(*lat), GFP_KERNEL);
+	if (!lat)
+		return -ENOMEM;
+
+	spin_lock_irq(q->queue_lock);
+	if (q->latency)
+		memcpy(lat, q->latency, sizeof(*lat));
+	spin_unlock_irq(q->queue_lock);
+
+	if (!q->latency) {
+		seq_printf(m, "off\n");
+		goto out;
+	}
+
+	seq_printf(m, "since: %u ms ago\n",
+		   jiffies_to_msecs(jiffies - lat->since));
+
+	for (rw = 0; rw < 2; rw++) {
+		seq_printf(m, "%s: %u requests", dir[rw], lat->count[rw]);
+		if (lat->count[rw])
+			seq_printf(m, ", wait avg %llu us, service avg %llu us",
+				   div_u64(lat->wait_us[rw], lat->count[rw]),
+				   div_u64(lat->service_us[rw],
+					   lat->count[rw]));
+		seq_putc(m, '\n');
+	}
+
+	for (rw = 0; rw < 2; rw++) {
+		if (!lat->count[rw])
+			continue;
+
+		snprintf(name, sizeof(name), "%s wait", dir[rw]);
+		blk_latency_show_hist(m, name, lat->wait[rw]);
+		snprintf(name, sizeof(name), "%s service", dir[rw]);
+		blk_latency_show_hist(m, name, lat->service[rw]);
+	}
+
+ out:
+	kfree(lat);
+	return 0;
+}
+
+static int blk_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, blk_latency_show, inode->i_private);
+}
+
+static ssize_t blk_latency_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct request_queue *q =
+		((struct seq_file *)file->private_data)->private;
+	struct blk_latency *lat = NULL, *old;
+	char c;
+
+	if (!count)
+		return 0;
+	if (get_user(c, buf))
+		return -EFAULT;
+
+	if (c == '1') {
+		lat = kzalloc(sizeof(*lat), GFP_KERNEL);
+		if (!lat)
+			return -ENOMEM;
+		lat->since = jiffies;
+	} else if (c != '0')
+		return -EINVAL;
+
+	/* requests already queued carry no timestamps and are skipped */
+	spin_lock_irq(q->queue_lock);
+	old = q->latency;
+	q->latency = lat;
+	spin_unlock_irq(q->queue_lock);
+
+	kfree(old);
+	return count;
+}
+
+static const struct file_operations blk_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= blk_latency_open,
+	.read		= seq_read,
+	.write		= blk_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void blk_latency_register(struct gendisk *disk)
+{
+	struct request_queue *q = disk->queue;
+
+	if (!blk_latency_root) {
+		blk_latency_root = debugfs_create_dir("blk_latency", NULL);
+		if (IS_ERR(blk_latency_root))
+			blk_latency_root = NULL;
+		if (!blk_latency_root)
+			return;
+	}
+
+	q->latency_dentry = debugfs_create_file(disk->disk_name,
+						S_IRUGO | S_IWUSR,
+						blk_latency_root, q,
+						&blk_latency_fops);
+	if (IS_ERR(q->latency_dentry))
+		q->latency_dentry = NULL;
+	if (q->latency_dentry)
+		blk_latency_users++;
+}
+
+void blk_latency_unregister(struct gendisk *disk)
+{
+	struct request_queue *q = disk->queue;
+
+	if (!q->latency_dentry)
+		return;
+
+	debugfs_remove(q->latency_dentry);
+	q->latency_dentry = NULL;
+
+	if (--blk_latency_users == 0) {
+		debugfs_remove(blk_latency_root);
+		blk_latency_root = NULL;
+	}
+}
+
+void blk_latency_release(struct request_queue *q)
+{
+	kfree(q->latency);
+	q->latency = NULL;
+}
@@ -461,6 +461,12 @@ static int attempt_merge(struct request_queue *q, struct request *req,
 	 */
 	if (time_after(req->start_time, next->start_time))
 		req->start_time = next->start_time;
+#ifdef CONFIG_BLK_DEV_IO_LATENCY
+	if (next->lat_queued.tv64 &&
+	    (!req->lat_queued.tv64 ||
+	     req->lat_queued.tv64 > next->lat_queued.tv64))
+		req->lat_queued = next->lat_queued;
+#endif
 
 	req->biotail->bi_next = next->bio;
 	req->biotail = next->biotail;
@@ -266,6 +266,24 @@ void blk_queue_hardsect_size(struct request_queue *q, unsigned short size)
 }
 EXPORT_SYMBOL(blk_queue_hardsect_size);
 
+/**
+ * blk_queue_alloc_unit - set the unit the device manages its media in
+ * @q:  the request queue for the device
+ * @sectors:  the size of the unit, in 512 byte sectors
+ *
+ * Description:
+ *   Flash cards erase and remap their media in units much larger than a
+ *   sector, the allocation unit of SD cards. Writes confined to one unit
+ *   at a time are much cheaper for them than writes spread over several,
+ *   and the I/O scheduler can take this into account. Zero, the default,
+ *   means the size is not known.
+ **/
+void blk_queue_alloc_unit(struct request_queue *q, unsigned int sectors)
+{
+	q->alloc_unit = sectors;
+}
+EXPORT_SYMBOL(blk_queue_alloc_unit);
+
 /*
  * Returns the minimum that is _not_ zero, unless both are zero.
  */
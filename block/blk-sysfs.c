@@ -282,6 +282,7 @@ static void blk_release_queue(struct kobject *kobj)
 		__blk_queue_free_tags(q);
 
 	blk_trace_shutdown(q);
+	blk_latency_release(q);
 
 	bdi_destroy(&q->backing_dev_info);
 	kmem_cache_free(blk_requestq_cachep, q);
@@ -324,6 +325,7 @@ int blk_register_queue(struct gendisk *disk)
 		return ret;
 	}
 
+	blk_latency_register(disk);
 	return 0;
 }
 
@@ -335,6 +337,7 @@ void blk_unregister_queue(struct gendisk *disk)
 		return;
 
 	if (q->request_fn) {
+		blk_latency_unregister(disk);
 		elv_unregister_queue(q);
 
 		kobject_uevent(&q->kobj, KOBJ_REMOVE);
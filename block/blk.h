@@ -31,6 +31,46 @@ void blk_recalc_rq_sectors(struct request *rq, int nsect);
 
 void blk_queue_congestion_threshold(struct request_queue *q);
 
+#ifdef CONFIG_BLK_DEV_IO_LATENCY
+void blk_latency_register(struct gendisk *disk);
+void blk_latency_unregister(struct gendisk *disk);
+void blk_latency_release(struct request_queue *q);
+void __blk_latency_done(struct request_queue *q, struct request *rq);
+
+static inline void blk_latency_queued(struct request_queue *q,
+				      struct request *rq)
+{
+	if (unlikely(q->latency))
+		rq->lat_queued = ktime_get();
+}
+
+static inline void blk_latency_start(struct request_queue *q,
+				     struct request *rq)
+{
+	if (unlikely(q->latency) && rq->lat_queued.tv64) {
+		rq->lat_started = ktime_get();
+		rq->lat_sectors = rq->nr_sectors;
+	}
+}
+
+static inline void blk_latency_done(struct request_queue *q,
+				    struct request *rq)
+{
+	if (unlikely(q->latency) && rq->lat_started.tv64)
+		__blk_latency_done(q, rq);
+}
+#else
+static inline void blk_latency_register(struct gendisk *disk) { }
+static inline void blk_latency_unregister(struct gendisk *disk) { }
+static inline void blk_latency_release(struct request_queue *q) { }
+static inline void blk_latency_queued(struct request_queue *q,
+				      struct request *rq) { }
+static inline void blk_latency_start(struct request_queue *q,
+				     struct request *rq) { }
+static inline void blk_latency_done(struct request_queue *q,
+				    struct request *rq) { }
+#endif
+
 int blk_dev_init(void);
 
 /*
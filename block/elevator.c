@@ -37,6 +37,8 @@
 
 #include <asm/uaccess.h>
 
+#include "blk.h"
+
 static DEFINE_SPINLOCK(elv_list_lock);
 static LIST_HEAD(elv_list);
 
@@ -764,6 +766,8 @@ struct request *elv_next_request(struct request_queue *q)
 			 */
 			rq->cmd_flags |= REQ_STARTED;
 			blk_add_trace_rq(q, rq, BLK_TA_ISSUE);
+			if (blk_fs_request(rq))
+				blk_latency_start(q, rq);
 		}
 
 		if (!q->boundary_rq || q->boundary_rq == rq) {
@@ -823,6 +827,30 @@ struct request *elv_next_request(struct request_queue *q)
 }
 EXPORT_SYMBOL(elv_next_request);
 
+/*
+ * Return the request elv_next_request() would, without starting it, so
+ * that it is left as it was if the driver does not take it. Requests
+ * of a barrier sequence are never returned.
+ */
+struct request *elv_peek_request(struct request_queue *q)
+{
+	struct request *rq;
+
+	if (blk_queue_flushing(q))
+		return NULL;
+
+	if (list_empty(&q->queue_head) &&
+	    !q->elevator->ops->elevator_dispatch_fn(q, 0))
+		return NULL;
+
+	rq = list_entry_rq(q->queue_head.next);
+	if (blk_barrier_rq(rq))
+		return NULL;
+
+	return rq;
+}
+EXPORT_SYMBOL(elv_peek_request);
+
 void elv_dequeue_request(struct request_queue *q, struct request *rq)
 {
 	BUG_ON(list_empty(&rq->queuelist));
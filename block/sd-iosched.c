@@ -0,0 +1,520 @@
+/*
+ *  SD card i/o scheduler, based on the deadline i/o scheduler.
+ *
+ *  There is no seek time on a card to be saved by sorting, but small
+ *  reads behind a long stream of writes wait for all of them, and writes
+ *  spread over many allocation units make the card copy and erase far
+ *  more than it has to. So:
+ *
+ *  - reads always go first, oldest first, as long as no write has been
+ *    waiting for longer than write_expire;
+ *  - a write that has waited that long gets a batch of up to write_batch
+ *    requests which reads do not interrupt, but only once reads had
+ *    writes_starved batches of their own;
+ *  - writes go out one allocation unit at a time, in sector order within
+ *    it, starting with the unit of the oldest write.
+ *
+ *  The allocation unit is the one the driver set for the queue, or
+ *  au_kb when that is set, or 4MiB if neither knows better.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+
+static const int read_expire = HZ / 8;	/* max time before a read is submitted */
+static const int write_expire = 5 * HZ;	/* ditto for writes, this one is SOFT */
+static const int writes_starved = 2;	/* read batches a late write waits for */
+static const int fifo_batch = 8;	/* sequential reads treated as one */
+static const int write_batch = 16;	/* writes a late write gets in a row */
+
+#define SD_DEFAULT_AU		8192	/* sectors */
+
+struct sd_data {
+	/*
+	 * requests are present on both sort_list and fifo_list
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2];
+
+	/*
+	 * next in sort order, for each direction
+	 */
+	struct request *next_rq[2];
+	int batch_dir;			/* direction of the current batch */
+	int batch_forced;		/* the write batch is not interrupted */
+	unsigned int batching;		/* number of requests in the batch */
+	sector_t last_sector;		/* end of the last request */
+	sector_t au_start;		/* allocation unit writes are going to */
+	sector_t au_end;
+	unsigned int starved;		/* read batches a late write waited */
+	struct request_queue *queue;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2];
+	int fifo_batch;
+	int write_batch;
+	int writes_starved;
+	int front_merges;
+	int au_kb;
+};
+
+static void sd_move_request(struct sd_data *, struct request *);
+
+#define RQ_RB_ROOT(sd, rq)	(&(sd)->sort_list[rq_data_dir((rq))])
+
+/*
+ * get the request after `rq' in sector-sorted order
+ */
+static inline struct request *
+sd_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+/*
+ * get the first request starting at or after `sector'
+ */
+static struct request *
+sd_first_request_from(struct rb_root *root, sector_t sector)
+{
+	struct rb_node *n = root->rb_node;
+	struct request *rq, *first = NULL;
+
+	while (n) {
+		rq = rb_entry_rq(n);
+
+		if (rq->sector < sector)
+			n = n->rb_right;
+		else {
+			first = rq;
+			n = n->rb_left;
+		}
+	}
+
+	return first;
+}
+
+static unsigned int sd_au_sectors(struct sd_data *sd)
+{
+	if (sd->au_kb)
+		return sd->au_kb * 2;
+	if (sd->queue->alloc_unit)
+		return sd->queue->alloc_unit;
+	return SD_DEFAULT_AU;
+}
+
+static void
+sd_add_rq_rb(struct sd_data *sd, struct request *rq)
+{
+	struct rb_root *root = RQ_RB_ROOT(sd, rq);
+	struct request *__alias;
+
+retry:
+	__alias = elv_rb_add(root, rq);
+	if (unlikely(__alias)) {
+		sd_move_request(sd, __alias);
+		goto retry;
+	}
+}
+
+static inline void
+sd_del_rq_rb(struct sd_data *sd, struct request *rq)
+{
+	const int data_dir = rq_data_dir(rq);
+
+	if (sd->next_rq[data_dir] == rq)
+		sd->next_rq[data_dir] = sd_latter_request(rq);
+
+	elv_rb_del(RQ_RB_ROOT(sd, rq), rq);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+sd_add_request(struct request_queue *q, struct request *rq)
+{
+	struct sd_data *sd = q->elevator->elevator_data;
+	const int data_dir = rq_data_dir(rq);
+
+	sd_add_rq_rb(sd, rq);
+
+	rq_set_fifo_time(rq, jiffies + sd->fifo_expire[data_dir]);
+	list_add_tail(&rq->queuelist, &sd->fifo_list[data_dir]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void sd_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct sd_data *sd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	sd_del_rq_rb(sd, rq);
+}
+
+static int
+sd_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct sd_data *sd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (sd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&sd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != __rq->sector);
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void sd_merged_request(struct request_queue *q,
+			      struct request *req, int type)
+{
+	struct sd_data *sd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(RQ_RB_ROOT(sd, req), req);
+		sd_add_rq_rb(sd, req);
+	}
+}
+
+static void
+sd_merged_requests(struct request_queue *q, struct request *req,
+		   struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	sd_remove_request(q, next);
+}
+
+/*
+ * move an entry to dispatch queue
+ */
+static void
+sd_move_request(struct sd_data *sd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	const int data_dir = rq_data_dir(rq);
+
+	/* the other direction keeps its place, to go on from there later */
+	sd->next_rq[data_dir] = sd_latter_request(rq);
+	sd->last_sector = rq->sector + rq->nr_sectors;
+
+	sd_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * sd_check_fifo returns 1 if the oldest request in data_dir has expired.
+ * Requires !list_empty(&sd->fifo_list[data_dir])
+ */
+static inline int sd_check_fifo(struct sd_data *sd, int ddir)
+{
+	struct request *rq = rq_entry_fifo(sd->fifo_list[ddir].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * the next write within the allocation unit writes are going to
+ */
+static inline struct request *sd_next_write(struct sd_data *sd)
+{
+	struct request *rq = sd->next_rq[WRITE];
+
+	if (rq && rq->sector >= sd->au_start && rq->sector < sd->au_end)
+		return rq;
+
+	return NULL;
+}
+
+/*
+ * start writing to the allocation unit of the oldest write, from the
+ * lowest sector queued for it
+ */
+static struct request *sd_start_au(struct sd_data *sd)
+{
+	struct request *rq = rq_entry_fifo(sd->fifo_list[WRITE].next);
+	unsigned int au = sd_au_sectors(sd);
+	sector_t unit = rq->sector;
+
+	sector_div(unit, au);
+	sd->au_start = unit * au;
+	sd->au_end = sd->au_start + au;
+
+	return sd_first_request_from(&sd->sort_list[WRITE], sd->au_start);
+}
+
+/*
+ * sd_dispatch_requests selects the next request, reads first
+ */
+static int sd_dispatch_requests(struct request_queue *q, int force)
+{
+	struct sd_data *sd = q->elevator->elevator_data;
+	const int reads = !list_empty(&sd->fifo_list[READ]);
+	const int writes = !list_empty(&sd->fifo_list[WRITE]);
+	struct request *rq;
+
+	/*
+	 * a write batch reads have had to wait for runs to its end
+	 */
+	if (sd->batch_dir == WRITE && sd->batch_forced &&
+	    sd->batching < sd->write_batch) {
+		rq = sd_next_write(sd);
+		if (rq)
+			goto dispatch_request;
+	}
+
+	if (reads) {
+		if (writes && sd->starved >= sd->writes_starved &&
+		    sd_check_fifo(sd, WRITE)) {
+			sd->batch_forced = 1;
+			goto dispatch_writes;
+		}
+
+		/* go on with a sequential read, unless another is late */
+		rq = sd->next_rq[READ];
+		if (sd->batch_dir == READ && sd->batching < sd->fifo_batch &&
+		    rq && rq->sector == sd->last_sector &&
+		    !sd_check_fifo(sd, READ))
+			goto dispatch_request;
+
+		if (writes)
+			sd->starved++;
+
+		sd->batch_dir = READ;
+		sd->batching = 0;
+		rq = rq_entry_fifo(sd->fifo_list[READ].next);
+		goto dispatch_request;
+	}
+
+	if (!writes)
+		return 0;
+
+	sd->batch_forced = 0;
+
+dispatch_writes:
+	sd->starved = 0;
+
+	/*
+	 * stay within the allocation unit until it has no more writes
+	 * queued, or the oldest write is late
+	 */
+	rq = NULL;
+	if (sd->batch_dir == WRITE && !sd_check_fifo(sd, WRITE))
+		rq = sd_next_write(sd);
+
+	if (!rq) {
+		rq = sd_start_au(sd);
+		sd->batching = 0;
+	}
+
+	sd->batch_dir = WRITE;
+
+dispatch_request:
+	sd->batching++;
+	sd_move_request(sd, rq);
+
+	return 1;
+}
+
+static int sd_queue_empty(struct request_queue *q)
+{
+	struct sd_data *sd = q->elevator->elevator_data;
+
+	return list_empty(&sd->fifo_list[WRITE])
+		&& list_empty(&sd->fifo_list[READ]);
+}
+
+static void sd_exit_queue(elevator_t *e)
+{
+	struct sd_data *sd = e->elevator_data;
+
+	BUG_ON(!list_empty(&sd->fifo_list[READ]));
+	BUG_ON(!list_empty(&sd->fifo_list[WRITE]));
+
+	kfree(sd);
+}
+
+/*
+ * initialize elevator private data (sd_data).
+ */
+static void *sd_init_queue(struct request_queue *q)
+{
+	struct sd_data *sd;
+
+	sd = kmalloc_node(sizeof(*sd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!sd)
+		return NULL;
+
+	INIT_LIST_HEAD(&sd->fifo_list[READ]);
+	INIT_LIST_HEAD(&sd->fifo_list[WRITE]);
+	sd->sort_list[READ] = RB_ROOT;
+	sd->sort_list[WRITE] = RB_ROOT;
+	sd->batch_dir = READ;
+	sd->queue = q;
+	sd->fifo_expire[READ] = read_expire;
+	sd->fifo_expire[WRITE] = write_expire;
+	sd->writes_starved = writes_starved;
+	sd->front_merges = 1;
+	sd->fifo_batch = fifo_batch;
+	sd->write_batch = write_batch;
+	return sd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+sd_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+sd_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(elevator_t *e, char *page)			\
+{									\
+	struct sd_data *sd = e->elevator_data;				\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return sd_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(sd_read_expire_show, sd->fifo_expire[READ], 1);
+SHOW_FUNCTION(sd_write_expire_show, sd->fifo_expire[WRITE], 1);
+SHOW_FUNCTION(sd_writes_starved_show, sd->writes_starved, 0);
+SHOW_FUNCTION(sd_front_merges_show, sd->front_merges, 0);
+SHOW_FUNCTION(sd_fifo_batch_show, sd->fifo_batch, 0);
+SHOW_FUNCTION(sd_write_batch_show, sd->write_batch, 0);
+SHOW_FUNCTION(sd_au_kb_show, sd_au_sectors(sd) / 2, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(elevator_t *e, const char *page, size_t count)	\
+{									\
+	struct sd_data *sd = e->elevator_data;				\
+	int __data;							\
+	int ret = sd_var_store(&__data, (page), count);			\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(sd_read_expire_store, &sd->fifo_expire[READ], 0, INT_MAX, 1);
+STORE_FUNCTION(sd_write_expire_store, &sd->fifo_expire[WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(sd_writes_starved_store, &sd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(sd_front_merges_store, &sd->front_merges, 0, 1, 0);
+STORE_FUNCTION(sd_fifo_batch_store, &sd->fifo_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(sd_write_batch_store, &sd->write_batch, 1, INT_MAX, 0);
+/* 0 goes back to the size the driver set */
+STORE_FUNCTION(sd_au_kb_store, &sd->au_kb, 0, 1024 * 1024, 0);
+#undef STORE_FUNCTION
+
+#define SD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, sd_##name##_show, \
+				      sd_##name##_store)
+
+static struct elv_fs_entry sd_attrs[] = {
+	SD_ATTR(read_expire),
+	SD_ATTR(write_expire),
+	SD_ATTR(writes_starved),
+	SD_ATTR(front_merges),
+	SD_ATTR(fifo_batch),
+	SD_ATTR(write_batch),
+	SD_ATTR(au_kb),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_sd = {
+	.ops = {
+		.elevator_merge_fn = 		sd_merge,
+		.elevator_merged_fn =		sd_merged_request,
+		.elevator_merge_req_fn =	sd_merged_requests,
+		.elevator_dispatch_fn =		sd_dispatch_requests,
+		.elevator_add_req_fn =		sd_add_request,
+		.elevator_queue_empty_fn =	sd_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		sd_init_queue,
+		.elevator_exit_fn =		sd_exit_queue,
+	},
+
+	.elevator_attrs = sd_attrs,
+	.elevator_name = "sd",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init sd_iosched_init(void)
+{
+	elv_register(&iosched_sd);
+
+	return 0;
+}
+
+static void __exit sd_iosched_exit(void)
+{
+	elv_unregister(&iosched_sd);
+}
+
+module_init(sd_iosched_init);
+module_exit(sd_iosched_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("SD card IO scheduler");
@@ -48,6 +48,15 @@
 
 static DECLARE_BITMAP(dev_use, MMC_NUM_MINORS);
 
+/*
+ * Tell SD cards how many blocks a multiple block write is going to
+ * cover, so they can erase them ahead of time.
+ */
+static int pre_erase = 1;
+module_param(pre_erase, bool, 0644);
+MODULE_PARM_DESC(pre_erase, "Send SET_WR_BLK_ERASE_COUNT before multiple "
+		 "block writes to SD cards");
+
 /*
  * There is one mmc_blk_data per slot.
  */
@@ -210,6 +219,20 @@ static u32 mmc_sd_num_wr_blocks(struct mmc_card *card)
 	return blocks;
 }
 
+static void mmc_blk_pre_erase(struct mmc_card *card, unsigned int blocks)
+{
+	struct mmc_command cmd;
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+
+	cmd.opcode = SD_APP_SET_WR_BLK_ERASE_COUNT;
+	cmd.arg = blocks & 0x7fffff;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	/* only a hint, the write goes ahead if the card does not take it */
+	mmc_wait_for_app_cmd(card->host, card, &cmd, 0);
+}
+
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -236,7 +259,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		brq.stop.opcode = MMC_STOP_TRANSMISSION;
 		brq.stop.arg = 0;
 		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = req->nr_sectors >> (md->block_bits - 9);
+		brq.data.blocks = mmc_queue_sectors(mq) >> (md->block_bits - 9);
 		if (brq.data.blocks > card->host->max_blk_count)
 			brq.data.blocks = card->host->max_blk_count;
 
@@ -275,7 +298,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		 * request.
 		 */
 		if (brq.data.blocks !=
-		    (req->nr_sectors >> (md->block_bits - 9))) {
+		    (mmc_queue_sectors(mq) >> (md->block_bits - 9))) {
 			data_size = brq.data.blocks * brq.data.blksz;
 			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
 				data_size -= sg->length;
@@ -288,6 +311,11 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			brq.data.sg_len = i;
 		}
 
+		if (pre_erase && mmc_card_sd(card) &&
+		    !mmc_host_is_spi(card->host) &&
+		    rq_data_dir(req) == WRITE && brq.data.blocks > 1)
+			mmc_blk_pre_erase(card, brq.data.blocks);
+
 		mmc_wait_for_req(card->host, &brq.mrq);
 
 		mmc_queue_bounce_post(mq);
@@ -349,12 +377,18 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		 * A block was successfully transferred.
 		 */
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		ret = mmc_queue_end_request(mq, brq.data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
 	} while (ret);
 
 	mmc_release_host(card->host);
 
+	if (!list_empty(&mq->gather)) {
+		spin_lock_irq(&md->lock);
+		mmc_queue_requeue(mq);
+		spin_unlock_irq(&md->lock);
+	}
+
 	return 1;
 
  cmd_err:
@@ -381,21 +415,26 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 				else
 					bytes = blocks << 9;
 				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, 0, bytes);
+				ret = mmc_queue_end_request(mq, bytes);
 				spin_unlock_irq(&md->lock);
 			}
 		} else {
 			spin_lock_irq(&md->lock);
-			ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+			ret = mmc_queue_end_request(mq, brq.data.bytes_xfered);
 			spin_unlock_irq(&md->lock);
 		}
 	}
 
 	mmc_release_host(card->host);
 
+	/*
+	 * Only the request the write started with is failed, any gathered
+	 * behind it are retried on their own.
+	 */
 	spin_lock_irq(&md->lock);
 	while (ret)
 		ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
+	mmc_queue_requeue(mq);
 	spin_unlock_irq(&md->lock);
 
 	return 0;
@@ -41,6 +41,60 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	return BLKPREP_OK;
 }
 
+/*
+ * Writes copied over USB mass storage come in as lots of small requests
+ * for consecutive sectors, which the elevator could not merge as they
+ * were queued after the one before was already being written. Take the
+ * ones queued right behind a write which continue where it ends, so
+ * they go to the card as a single multiple block write. Requests are
+ * only looked at with elv_peek_request(), so one which is left stays
+ * unstarted; it is taken off the queue once it is part of the gather.
+ * Called with the queue lock held.
+ */
+static void mmc_queue_gather(struct mmc_queue *mq, struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_host *host = mq->card->host;
+	struct request *next;
+	unsigned int max_sectors, sectors, segs;
+	sector_t end;
+
+	if (!blk_fs_request(req) || rq_data_dir(req) != WRITE ||
+	    blk_barrier_rq(req))
+		return;
+
+	max_sectors = min(q->max_sectors, host->max_blk_count);
+
+	sectors = req->nr_sectors;
+	segs = req->nr_phys_segments;
+	end = req->sector + req->nr_sectors;
+
+	/* get it out of the way to see what comes next */
+	blkdev_dequeue_request(req);
+
+	while ((next = elv_peek_request(q)) != NULL) {
+		if (!blk_fs_request(next) || rq_data_dir(next) != WRITE ||
+		    blk_barrier_rq(next) || next->sector != end)
+			break;
+
+		if (sectors + next->nr_sectors > max_sectors ||
+		    segs + next->nr_phys_segments > q->max_phys_segments)
+			break;
+
+		/* start it as the driver normally would */
+		if (elv_next_request(q) != next)
+			break;
+
+		blkdev_dequeue_request(next);
+		list_add_tail(&next->queuelist, &mq->gather);
+
+		sectors += next->nr_sectors;
+		segs += next->nr_phys_segments;
+		end += next->nr_sectors;
+		mq->gather_sectors += next->nr_sectors;
+	}
+}
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
@@ -57,6 +111,8 @@ static int mmc_queue_thread(void *d)
 		if (!blk_queue_plugged(q))
 			req = elv_next_request(q);
 		mq->req = req;
+		if (req)
+			mmc_queue_gather(mq, req);
 		spin_unlock_irq(q->queue_lock);
 
 		if (!req) {
@@ -129,9 +185,14 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 
 	mq->queue->queuedata = mq;
 	mq->req = NULL;
+	INIT_LIST_HEAD(&mq->gather);
+	mq->gather_sectors = 0;
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 
+	if (mmc_card_sd(card) && card->ssr.au)
+		blk_queue_alloc_unit(mq->queue, card->ssr.au);
+
 #ifdef CONFIG_MMC_BLOCK_BOUNCE
 	if (host->max_hw_segs == 1) {
 		unsigned int bouncesz;
@@ -290,6 +351,26 @@ void mmc_queue_resume(struct mmc_queue *mq)
 	}
 }
 
+/*
+ * Map the request and the ones gathered behind it into one sg list
+ */
+static unsigned int mmc_queue_map_gathered(struct mmc_queue *mq,
+					   struct scatterlist *sg)
+{
+	struct request *rq;
+	unsigned int sg_len;
+
+	sg_len = blk_rq_map_sg(mq->queue, mq->req, sg);
+
+	list_for_each_entry(rq, &mq->gather, queuelist) {
+		/* the list goes on after this one */
+		sg_unmark_end(&sg[sg_len - 1]);
+		sg_len += blk_rq_map_sg(mq->queue, rq, sg + sg_len);
+	}
+
+	return sg_len;
+}
+
 /*
  * Prepare the sg list(s) to be handed of to the host driver
  */
@@ -301,11 +382,11 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq)
 	int i;
 
 	if (!mq->bounce_buf)
-		return blk_rq_map_sg(mq->queue, mq->req, mq->sg);
+		return mmc_queue_map_gathered(mq, mq->sg);
 
 	BUG_ON(!mq->bounce_sg);
 
-	sg_len = blk_rq_map_sg(mq->queue, mq->req, mq->bounce_sg);
+	sg_len = mmc_queue_map_gathered(mq, mq->bounce_sg);
 
 	mq->bounce_sg_len = sg_len;
 
@@ -358,3 +439,61 @@ void mmc_queue_bounce_post(struct mmc_queue *mq)
 	local_irq_restore(flags);
 }
 
+
+/**
+ * mmc_queue_end_request - complete transferred data
+ * @mq: MMC queue
+ * @bytes: bytes transferred
+ *
+ * Complete @bytes of the current request and then of the requests
+ * gathered behind it, those only once they are done in full. Returns
+ * nonzero while the current request has data left. Called with the
+ * queue lock held.
+ */
+int mmc_queue_end_request(struct mmc_queue *mq, unsigned int bytes)
+{
+	struct request *rq, *tmp;
+	unsigned int len;
+	int ret;
+
+	len = min_t(unsigned int, bytes, mq->req->nr_sectors << 9);
+	ret = __blk_end_request(mq->req, 0, len);
+	if (ret)
+		return ret;
+
+	bytes -= len;
+
+	list_for_each_entry_safe(rq, tmp, &mq->gather, queuelist) {
+		len = rq->nr_sectors << 9;
+		if (bytes < len)
+			break;
+
+		list_del_init(&rq->queuelist);
+		mq->gather_sectors -= rq->nr_sectors;
+		bytes -= len;
+
+		__blk_end_request(rq, 0, len);
+	}
+
+	return 0;
+}
+
+/**
+ * mmc_queue_requeue - give back the gathered requests not completed
+ * @mq: MMC queue
+ *
+ * After an error, the writes gathered behind the failed request go
+ * back to the head of the queue, in order, to be retried. Called with
+ * the queue lock held.
+ */
+void mmc_queue_requeue(struct mmc_queue *mq)
+{
+	struct request *rq, *tmp;
+
+	list_for_each_entry_safe_reverse(rq, tmp, &mq->gather, queuelist) {
+		list_del_init(&rq->queuelist);
+		blk_requeue_request(mq->queue, rq);
+	}
+
+	mq->gather_sectors = 0;
+}
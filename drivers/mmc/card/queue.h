@@ -17,8 +17,16 @@ struct mmc_queue {
 	char			*bounce_buf;
 	struct scatterlist	*bounce_sg;
 	unsigned int		bounce_sg_len;
+	struct list_head	gather;		/* writes following req */
+	unsigned int		gather_sectors;
 };
 
+/* sectors left to transfer, in the request and those gathered behind it */
+static inline unsigned int mmc_queue_sectors(struct mmc_queue *mq)
+{
+	return mq->req->nr_sectors + mq->gather_sectors;
+}
+
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *);
 extern void mmc_cleanup_queue(struct mmc_queue *);
 extern void mmc_queue_suspend(struct mmc_queue *);
@@ -28,4 +36,7 @@ extern unsigned int mmc_queue_map_sg(struct mmc_queue *);
 extern void mmc_queue_bounce_pre(struct mmc_queue *);
 extern void mmc_queue_bounce_post(struct mmc_queue *);
 
+extern int mmc_queue_end_request(struct mmc_queue *, unsigned int);
+extern void mmc_queue_requeue(struct mmc_queue *);
+
 #endif
@@ -234,6 +234,30 @@ out:
 	return err;
 }
 
+/*
+ * Fetches the SD status and decodes the allocation unit size
+ */
+static void mmc_read_ssr(struct mmc_card *card)
+{
+	unsigned int au;
+
+	/* the allocation unit size is only defined from 2.00 on */
+	if (card->scr.sda_vsn < SCR_SPEC_VER_2)
+		return;
+
+	if (mmc_app_sd_status(card, card->raw_ssr)) {
+		printk(KERN_WARNING "%s: problem reading SD status, "
+			"allocation unit size unknown.\n",
+			mmc_hostname(card->host));
+		return;
+	}
+
+	/* AU_SIZE, bits 431:428, 16KiB to 4MiB up to 2.00 */
+	au = (card->raw_ssr[2] >> 12) & 0xf;
+	if (au >= 1 && au <= 9)
+		card->ssr.au = 1 << (au + 4);
+}
+
 /*
  * Test if the card supports high-speed mode and, if so, switch to it.
  */
@@ -455,6 +479,8 @@ static int mmc_sd_init_card(struct mmc_host *host, u32 ocr,
 		err = mmc_read_switch(card);
 		if (err)
 			goto free_card;
+
+		mmc_read_ssr(card);
 	}
 
 	/*
@@ -15,6 +15,10 @@
 #include <linux/platform_device.h>
 #include <linux/irq.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/cpufreq.h>
 
 #include <asm/dma.h>
 
@@ -22,6 +26,7 @@
 #include <mach/regs-gpio.h>
 
 #include <asm/plat-s3c24xx/mci.h>
+#include <asm/plat-s3c24xx/clock-idle.h>
 
 #include "s3cmci.h"
 
@@ -55,11 +60,24 @@ static const int dbgmap_debug = dbg_debug | dbg_conf;
 
 #define RESSIZE(ressource) (((ressource)->end - (ressource)->start)+1)
 
+/* on the 2410, a DMA read receives this much at the slowed down clock */
+#define S3CMCI_SLOW_BYTES 32
+
+/* scatterlist entries finished before the DMA callback is made */
+#define S3CMCI_DMA_BATCH 16
+
+static int dma = 1;
+module_param(dma, int, 0444);
+MODULE_PARM_DESC(dma, "Use DMA for data transfers, see also the dma "
+		 "attribute of the device");
+
 static struct s3c2410_dma_client s3cmci_dma_client = {
 	.name		= "s3c-mci",
 };
 
 static void finalize_request(struct s3cmci_host *host);
+static void s3cmci_request_done(struct s3cmci_host *host,
+				struct mmc_request *mrq);
 static void s3cmci_send_request(struct mmc_host *mmc);
 static void s3cmci_reset(struct s3cmci_host *host);
 
@@ -188,6 +206,39 @@ static inline void clear_imask(struct s3cmci_host *host)
 	writel(0, host->base + host->sdiimsk);
 }
 
+/* The SDI interrupt is only enabled while a command is in flight, and
+ * both the tasklet and the request path switch it. Keep track of it
+ * here, as disable_irq() nests and a request waiting for the DMA would
+ * otherwise leave it disabled once too often. */
+
+static void s3cmci_enable_irq(struct s3cmci_host *host, int enable)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+
+	if (host->irq_enabled != enable) {
+		host->irq_enabled = enable;
+
+		if (enable)
+			enable_irq(host->irq);
+		else
+			disable_irq_nosync(host->irq);
+	}
+
+	local_irq_restore(flags);
+}
+
+/* undo the slow clock s3cmci_setup_data() uses for reads on the 2410 */
+
+static inline void s3cmci_restore_clock(struct s3cmci_host *host)
+{
+	if (host->slow_read) {
+		writel(host->prescaler, host->base + S3C2410_SDIPRE);
+		host->slow_read = 0;
+	}
+}
+
 static inline int get_data_buffer(struct s3cmci_host *host,
 				  u32 *words, u32 **pointer)
 {
@@ -239,8 +290,8 @@ static void do_pio_read(struct s3cmci_host *host)
 	u32 fifo;
 	void __iomem *from_ptr;
 
-	/* write real prescaler to host, it might be set slow to fix */
-	writel(host->prescaler, host->base + S3C2410_SDIPRE);
+	/* the first data is in, so the slow clock can go */
+	s3cmci_restore_clock(host);
 
 	from_ptr = host->base + host->sdidata;
 
@@ -336,8 +387,7 @@ static void pio_tasklet(unsigned long data)
 {
 	struct s3cmci_host *host = (struct s3cmci_host *) data;
 
-
-	disable_irq(host->irq);
+	s3cmci_enable_irq(host, 0);
 
 	if (host->pio_active == XFER_WRITE)
 		do_pio_write(host);
@@ -359,7 +409,7 @@ static void pio_tasklet(unsigned long data)
 
 		finalize_request(host);
 	} else
-		enable_irq(host->irq);
+		s3cmci_enable_irq(host, 1);
 }
 
 /*
@@ -451,6 +501,7 @@ static irqreturn_t s3cmci_irq(int irq, void *dev_id)
 
 	if (mci_csta & S3C2410_SDICMDSTAT_CMDTIMEOUT) {
 		dbg(host, dbg_err, "CMDSTAT: error CMDTIMEOUT\n");
+		host->errors.cmd_timeout++;
 		cmd->error = -ETIMEDOUT;
 		host->status = "error: command timeout";
 		goto fail_transfer;
@@ -507,6 +558,7 @@ static irqreturn_t s3cmci_irq(int irq, void *dev_id)
 	if (host->is2440) {
 		if (mci_fsta & S3C2440_SDIFSTA_FIFOFAIL) {
 			dbg(host, dbg_err, "FIFO failure\n");
+			host->errors.fifo++;
 			host->mrq->data->error = -EILSEQ;
 			host->status = "error: 2440 fifo failure";
 			goto fail_transfer;
@@ -514,6 +566,7 @@ static irqreturn_t s3cmci_irq(int irq, void *dev_id)
 	} else {
 		if (mci_dsta & S3C2410_SDIDSTA_FIFOFAIL) {
 			dbg(host, dbg_err, "FIFO failure\n");
+			host->errors.fifo++;
 			cmd->data->error = -EILSEQ;
 			host->status = "error:  fifo failure";
 			goto fail_transfer;
@@ -522,6 +575,7 @@ static irqreturn_t s3cmci_irq(int irq, void *dev_id)
 
 	if (mci_dsta & S3C2410_SDIDSTA_RXCRCFAIL) {
 		dbg(host, dbg_err, "bad data crc (outgoing)\n");
+		host->errors.data_crc++;
 		cmd->data->error = -EILSEQ;
 		host->status = "error: bad data crc (outgoing)";
 		goto fail_transfer;
@@ -529,6 +583,7 @@ static irqreturn_t s3cmci_irq(int irq, void *dev_id)
 
 	if (mci_dsta & S3C2410_SDIDSTA_CRCFAIL) {
 		dbg(host, dbg_err, "bad data crc (incoming)\n");
+		host->errors.data_crc++;
 		cmd->data->error = -EILSEQ;
 		host->status = "error: bad data crc (incoming)";
 		goto fail_transfer;
@@ -536,6 +591,7 @@ static irqreturn_t s3cmci_irq(int irq, void *dev_id)
 
 	if (mci_dsta & S3C2410_SDIDSTA_DATATIMEOUT) {
 		dbg(host, dbg_err, "data timeout\n");
+		host->errors.data_timeout++;
 		cmd->data->error = -ETIMEDOUT;
 		host->status = "error: data timeout";
 		goto fail_transfer;
@@ -596,7 +652,25 @@ static irqreturn_t s3cmci_irq_cd(int irq, void *dev_id)
 }
 
 static void s3cmci_dma_done_callback(struct s3c2410_dma_chan *dma_ch,
-				     void *buf_id, int size,
+				     void *buf_id, int nr, int size,
+				     enum s3c2410_dma_buffresult result);
+
+/* the DMA core reports the scatterlist entries in batches, so a
+ * request with many entries only takes one or two callbacks. While
+ * the 2410 reads at the slow clock the first words are reported on
+ * their own, as they restore the clock. */
+
+static void s3cmci_dma_batch(struct s3cmci_host *host, unsigned int nr)
+{
+	if (host->dma_batch == nr)
+		return;
+
+	s3c2410_dma_set_batchdone_fn(host->dma, s3cmci_dma_done_callback, nr);
+	host->dma_batch = nr;
+}
+
+static void s3cmci_dma_done_callback(struct s3c2410_dma_chan *dma_ch,
+				     void *buf_id, int nr, int size,
 				     enum s3c2410_dma_buffresult result)
 {
 	struct s3cmci_host *host = buf_id;
@@ -608,12 +682,16 @@ static void s3cmci_dma_done_callback(struct s3c2410_dma_chan *dma_ch,
 	mci_fsta = readl(host->base + S3C2410_SDIFSTA);
 	mci_dcnt = readl(host->base + S3C2410_SDIDCNT);
 
-	BUG_ON(!host->mrq);
-	BUG_ON(!host->mrq->data);
-	BUG_ON(!host->dmatogo);
-
 	spin_lock_irqsave(&host->complete_lock, iflags);
 
+	/* flushing the channel from finalize_request() calls us for the
+	 * buffers still queued, after the request has been given up */
+
+	if (!host->mrq || !host->mrq->data || !host->dmatogo) {
+		spin_unlock_irqrestore(&host->complete_lock, iflags);
+		return;
+	}
+
 	if (result != S3C2410_RES_OK) {
 		dbg(host, dbg_fail, "DMA FAILED: csta=0x%08x dsta=0x%08x "
 			"fsta=0x%08x dcnt:0x%08x result:0x%08x toGo:%u\n",
@@ -623,11 +701,15 @@ static void s3cmci_dma_done_callback(struct s3c2410_dma_chan *dma_ch,
 		goto fail_request;
 	}
 
-	host->dmatogo--;
+	/* data is arriving, so the card is past its access time */
+	s3cmci_restore_clock(host);
+	s3cmci_dma_batch(host, S3CMCI_DMA_BATCH);
+
+	host->dmatogo -= min_t(int, nr, host->dmatogo);
 	if (host->dmatogo) {
-		dbg(host, dbg_dma, "DMA DONE  Size:%i DSTA:[%08x] "
+		dbg(host, dbg_dma, "DMA DONE  Nr:%i Size:%i DSTA:[%08x] "
 			"DCNT:[%08x] toGo:%u\n",
-			size, mci_dsta, mci_dcnt, host->dmatogo);
+			nr, size, mci_dsta, mci_dcnt, host->dmatogo);
 
 		goto out;
 	}
@@ -635,21 +717,47 @@ static void s3cmci_dma_done_callback(struct s3c2410_dma_chan *dma_ch,
 	dbg(host, dbg_dma, "DMA FINISHED Size:%i DSTA:%08x DCNT:%08x\n",
 		size, mci_dsta, mci_dcnt);
 
-	host->complete_what = COMPLETION_FINALIZE;
+	host->dma_complete = 1;
+
+	/* the SDI may not be done with the last words yet, in which case
+	 * its XFERFINISH interrupt finalizes the request */
+
+	if (host->complete_what == COMPLETION_FINALIZE)
+		tasklet_schedule(&host->pio_tasklet);
 
 out:
-	tasklet_schedule(&host->pio_tasklet);
 	spin_unlock_irqrestore(&host->complete_lock, iflags);
 	return;
 
 fail_request:
-	host->mrq->data->error = -EINVAL;
+	host->errors.dma++;
+	if (!host->mrq->data->error)
+		host->mrq->data->error = -EINVAL;
+	host->dmatogo = 0;
+	host->dma_complete = 1;
 	host->complete_what = COMPLETION_FINALIZE;
 	writel(0, host->base + host->sdiimsk);
+	tasklet_schedule(&host->pio_tasklet);
 	goto out;
 
 }
 
+static void s3cmci_account_xfer(struct s3cmci_host *host,
+				struct mmc_data *data)
+{
+	struct s3cmci_xfer_stat *st;
+	s64 usecs;
+
+	st = &host->xfer_stat[host->dodma ? 1 : 0]
+			     [(data->flags & MMC_DATA_WRITE) ? 1 : 0];
+
+	usecs = ktime_to_us(ktime_sub(ktime_get(), host->xfer_start));
+
+	st->requests++;
+	st->bytes += data->blocks * data->blksz;
+	st->usecs += usecs > 0 ? usecs : 0;
+}
+
 static void finalize_request(struct s3cmci_host *host)
 {
 	struct mmc_request *mrq = host->mrq;
@@ -677,6 +785,7 @@ static void finalize_request(struct s3cmci_host *host)
 	cmd->resp[3] = readl(host->base + S3C2410_SDIRSP3);
 
 	writel(host->prescaler, host->base + S3C2410_SDIPRE);
+	host->slow_read = 0;
 
 	if (cmd->error)
 		debug_as_failure = 1;
@@ -709,6 +818,7 @@ static void finalize_request(struct s3cmci_host *host)
 	if (mrq->data->error == 0) {
 		mrq->data->bytes_xfered =
 			(mrq->data->blocks * mrq->data->blksz);
+		s3cmci_account_xfer(host, mrq->data);
 	} else {
 		mrq->data->bytes_xfered = 0;
 	}
@@ -716,8 +826,10 @@ static void finalize_request(struct s3cmci_host *host)
 	/* If we had an error while transfering data we flush the
 	 * DMA channel and the fifo to clear out any garbage. */
 	if (mrq->data->error != 0) {
-		if (host->dodma)
+		if (host->dodma) {
+			host->dmatogo = 0;
 			s3c2410_dma_ctrl(host->dma, S3C2410_DMAOP_FLUSH);
+		}
 
 		if (host->is2440) {
 			/* Clear failure register and reset fifo. */
@@ -735,33 +847,47 @@ static void finalize_request(struct s3cmci_host *host)
 		}
 	}
 
+	if (host->dodma)
+		dma_unmap_sg(mmc_dev(host->mmc), mrq->data->sg,
+			     mrq->data->sg_len,
+			     (mrq->data->flags & MMC_DATA_WRITE) ?
+			     DMA_TO_DEVICE : DMA_FROM_DEVICE);
+
 request_done:
 	host->complete_what = COMPLETION_NONE;
 	host->mrq = NULL;
+	s3cmci_request_done(host, mrq);
+}
+
+/* the SDI clock may be gated between requests, see s3cmci_request() */
+
+static void s3cmci_request_done(struct s3cmci_host *host,
+				struct mmc_request *mrq)
+{
+	s3c24xx_clk_active_put(host->clk);
 	mmc_request_done(host->mmc, mrq);
 }
 
 static void s3cmci_dma_setup(struct s3cmci_host *host,
 			     enum s3c2410_dmasrc source)
 {
-	static enum s3c2410_dmasrc last_source = -1;
-	static int setup_ok;
-
-	if (last_source == source)
+	if (host->dma_setup && host->dma_source == source)
 		return;
 
-	last_source = source;
+	host->dma_source = source;
 
-	s3c2410_dma_devconfig(host->dma, source, 3,
+	/* the SDI data register is on the APB and does not move */
+	s3c2410_dma_devconfig(host->dma, source,
+			      S3C2410_DISRCC_INC | S3C2410_DISRCC_APB,
 			      host->mem->start + host->sdidata);
 
-	if (!setup_ok) {
+	if (!host->dma_setup) {
+		/* the request source comes from the channel map */
 		s3c2410_dma_config(host->dma, 4,
-			(S3C2410_DCON_HWTRIG | S3C2410_DCON_CH0_SDI));
-		s3c2410_dma_set_buffdone_fn(host->dma,
-					    s3cmci_dma_done_callback);
+			(S3C2410_DCON_HANDSHAKE | S3C2410_DCON_SYNC_PCLK));
+		s3cmci_dma_batch(host, S3CMCI_DMA_BATCH);
 		s3c2410_dma_setflags(host->dma, S3C2410_DMAF_AUTOSTART);
-		setup_ok = 1;
+		host->dma_setup = 1;
 	}
 }
 
@@ -803,6 +929,8 @@ static int s3cmci_setup_data(struct s3cmci_host *host, struct mmc_data *data)
 
 	/* write DCON register */
 
+	host->slow_read = 0;
+
 	if (!data) {
 		writel(0, host->base + S3C2410_SDIDCON);
 		return 0;
@@ -880,8 +1008,10 @@ static int s3cmci_setup_data(struct s3cmci_host *host, struct mmc_data *data)
 		writel(0x0000FFFF, host->base + S3C2410_SDITIMER);
 
 		/* FIX: set slow clock to prevent timeouts on read */
-		if (data->flags & MMC_DATA_READ)
+		if (data->flags & MMC_DATA_READ) {
 			writel(0xFF, host->base + S3C2410_SDIPRE);
+			host->slow_read = 1;
+		}
 	}
 
 	return 0;
@@ -911,10 +1041,30 @@ static int s3cmci_prepare_pio(struct s3cmci_host *host, struct mmc_data *data)
 	return 0;
 }
 
+/* the DMA moves whole words, anything else has to go through the FIFO
+ * by hand */
+
+static int s3cmci_can_dma(struct s3cmci_host *host, struct mmc_data *data)
+{
+	int i;
+
+	if (host->use_dma <= 0)
+		return 0;
+
+	for (i = 0; i < data->sg_len; i++) {
+		if ((data->sg[i].offset | data->sg[i].length) & 3)
+			return 0;
+	}
+
+	return 1;
+}
+
 static int s3cmci_prepare_dma(struct s3cmci_host *host, struct mmc_data *data)
 {
 	int dma_len, i;
 	int rw = (data->flags & MMC_DATA_WRITE) ? 1 : 0;
+	dma_addr_t addr;
+	unsigned int len;
 
 	BUG_ON((data->flags & BOTH_DIR) == BOTH_DIR);
 
@@ -928,28 +1078,51 @@ static int s3cmci_prepare_dma(struct s3cmci_host *host, struct mmc_data *data)
 		return -ENOMEM;
 
 	host->dma_complete = 0;
-	host->dmatogo = dma_len;
+	host->dmatogo = 0;
+
+	s3cmci_dma_batch(host, host->slow_read ? 1 : S3CMCI_DMA_BATCH);
 
 	for (i = 0; i < dma_len; i++) {
 		int res;
 
-		dbg(host, dbg_dma, "enqueue %i:%u@%u\n", i,
-			sg_dma_address(&data->sg[i]),
-			sg_dma_len(&data->sg[i]));
+		addr = sg_dma_address(&data->sg[i]);
+		len = sg_dma_len(&data->sg[i]);
 
-		res = s3c2410_dma_enqueue(host->dma, (void *) host,
-					  sg_dma_address(&data->sg[i]),
-					  sg_dma_len(&data->sg[i]));
+		/* While the 2410 reads at the slow clock, the FIFO never
+		 * fills up enough to tell us the data has started. Queue
+		 * the first few words on their own instead, completing
+		 * them restores the clock. */
 
-		if (res) {
-			s3c2410_dma_ctrl(host->dma, S3C2410_DMAOP_FLUSH);
-			return -EBUSY;
+		if (i == 0 && host->slow_read && len > S3CMCI_SLOW_BYTES) {
+			res = s3c2410_dma_enqueue(host->dma, (void *) host,
+						  addr, S3CMCI_SLOW_BYTES);
+			if (res)
+				goto err_flush;
+
+			host->dmatogo++;
+			addr += S3CMCI_SLOW_BYTES;
+			len -= S3CMCI_SLOW_BYTES;
 		}
+
+		dbg(host, dbg_dma, "enqueue %i:%u@%u\n", i, addr, len);
+
+		res = s3c2410_dma_enqueue(host->dma, (void *) host, addr, len);
+		if (res)
+			goto err_flush;
+
+		host->dmatogo++;
 	}
 
 	s3c2410_dma_ctrl(host->dma, S3C2410_DMAOP_START);
 
 	return 0;
+
+ err_flush:
+	host->dmatogo = 0;
+	s3c2410_dma_ctrl(host->dma, S3C2410_DMAOP_FLUSH);
+	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+		     rw ? DMA_TO_DEVICE : DMA_FROM_DEVICE);
+	return -EBUSY;
 }
 
 static void s3cmci_send_request(struct mmc_host *mmc)
@@ -978,10 +1151,12 @@ static void s3cmci_send_request(struct mmc_host *mmc)
 			cmd->error = res;
 			cmd->data->error = res;
 
-			mmc_request_done(mmc, mrq);
+			s3cmci_request_done(host, mrq);
 			return;
 		}
 
+		host->xfer_start = ktime_get();
+
 		if (host->dodma)
 			res = s3cmci_prepare_dma(host, cmd->data);
 		else
@@ -992,7 +1167,7 @@ static void s3cmci_send_request(struct mmc_host *mmc)
 			cmd->error = res;
 			cmd->data->error = res;
 
-			mmc_request_done(mmc, mrq);
+			s3cmci_request_done(host, mrq);
 			return;
 		}
 	}
@@ -1001,7 +1176,7 @@ static void s3cmci_send_request(struct mmc_host *mmc)
 	s3cmci_send_command(host, cmd);
 
 	/* Enable Interrupt */
-	enable_irq(host->irq);
+	s3cmci_enable_irq(host, 1);
 }
 
 static int s3cmci_card_present(struct mmc_host *mmc)
@@ -1025,18 +1200,62 @@ static void s3cmci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	host->cmd_is_stop = 0;
 	host->mrq = mrq;
 
+	/* stays the same for the stop command that may follow */
+	host->dodma = mrq->data && s3cmci_can_dma(host, mrq->data);
+
+	s3c24xx_clk_active_get(host->clk);
+
 	if (s3cmci_card_present(mmc) == 0) {
 		dbg(host, dbg_err, "%s: no medium present\n", __func__);
 		host->mrq->cmd->error = -ENOMEDIUM;
-		mmc_request_done(mmc, mrq);
+		s3cmci_request_done(host, mrq);
 	} else
 		s3cmci_send_request(mmc);
 }
 
+/* s3cmci_set_clock
+ *
+ * Pick the fastest bus clock at or below the one the card can take, at
+ * the current PCLK. Unless a 2410 read is waiting for its first data at
+ * the slow clock, the prescaler is written straight away.
+*/
+
+static void s3cmci_set_clock(struct s3cmci_host *host)
+{
+	unsigned long rate = host->clk_rate / host->clk_div;
+	unsigned long flags;
+	u32 mci_psc;
+
+	if (host->ios_clock)
+		mci_psc = DIV_ROUND_UP(rate, host->ios_clock) - 1;
+	else
+		mci_psc = 255;
+
+	if (mci_psc > 255)
+		mci_psc = 255;
+
+	spin_lock_irqsave(&host->complete_lock, flags);
+
+	host->prescaler = mci_psc;
+
+	/* If requested clock is 0, real_rate will be 0, too */
+	if (host->ios_clock)
+		host->real_rate = rate / (mci_psc + 1);
+	else
+		host->real_rate = 0;
+
+	if (!host->slow_read)
+		writel(host->prescaler, host->base + S3C2410_SDIPRE);
+
+	spin_unlock_irqrestore(&host->complete_lock, flags);
+}
+
 static void s3cmci_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 {
 	struct s3cmci_host *host = mmc_priv(mmc);
-	u32 mci_psc, mci_con;
+	u32 mci_con;
+
+	s3c24xx_clk_active_get(host->clk);
 
 	/* Set the power state */
 
@@ -1075,22 +1294,8 @@ static void s3cmci_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 	}
 
 	/* Set clock */
-	for (mci_psc = 0; mci_psc < 255; mci_psc++) {
-		host->real_rate = host->clk_rate / (host->clk_div*(mci_psc+1));
-
-		if (host->real_rate <= ios->clock)
-			break;
-	}
-
-	if (mci_psc > 255)
-		mci_psc = 255;
-
-	host->prescaler = mci_psc;
-	writel(host->prescaler, host->base + S3C2410_SDIPRE);
-
-	/* If requested clock is 0, real_rate will be 0, too */
-	if (ios->clock == 0)
-		host->real_rate = 0;
+	host->ios_clock = ios->clock;
+	s3cmci_set_clock(host);
 
 	/* Set CLOCK_ENABLE */
 	if (ios->clock)
@@ -1109,6 +1314,8 @@ static void s3cmci_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 	}
 
 	host->bus_width = ios->bus_width;
+
+	s3c24xx_clk_active_put(host->clk);
 }
 
 static void s3cmci_reset(struct s3cmci_host *host)
@@ -1136,6 +1343,63 @@ static int s3cmci_get_ro(struct mmc_host *mmc)
 	return ret;
 }
 
+/* cpufreq driver support */
+
+#ifdef CONFIG_CPU_FREQ
+
+static int s3cmci_cpufreq_transition(struct notifier_block *nb,
+				     unsigned long val, void *data)
+{
+	struct s3cmci_host *host;
+	unsigned long newclk;
+
+	host = container_of(nb, struct s3cmci_host, freq_transition);
+	newclk = clk_get_rate(host->clk);
+
+	/* never run the card faster than it was told, so slow down
+	 * before PCLK goes up and speed up after it went down */
+
+	if ((val == CPUFREQ_POSTCHANGE && newclk < host->clk_rate) ||
+	    (val == CPUFREQ_PRECHANGE && newclk > host->clk_rate)) {
+		s3c24xx_clk_active_get(host->clk);
+
+		host->clk_rate = newclk;
+		s3cmci_set_clock(host);
+
+		s3c24xx_clk_active_put(host->clk);
+
+		dbg(host, dbg_conf, "PCLK now %lukHz, running at %lukHz.\n",
+		    newclk / 1000, host->real_rate / 1000);
+	}
+
+	return 0;
+}
+
+static inline int s3cmci_cpufreq_register(struct s3cmci_host *host)
+{
+	host->freq_transition.notifier_call = s3cmci_cpufreq_transition;
+
+	return cpufreq_register_notifier(&host->freq_transition,
+					 CPUFREQ_TRANSITION_NOTIFIER);
+}
+
+static inline void s3cmci_cpufreq_deregister(struct s3cmci_host *host)
+{
+	cpufreq_unregister_notifier(&host->freq_transition,
+				    CPUFREQ_TRANSITION_NOTIFIER);
+}
+
+#else
+static inline int s3cmci_cpufreq_register(struct s3cmci_host *host)
+{
+	return 0;
+}
+
+static inline void s3cmci_cpufreq_deregister(struct s3cmci_host *host)
+{
+}
+#endif
+
 static struct mmc_host_ops s3cmci_ops = {
 	.request	= s3cmci_request,
 	.set_ios	= s3cmci_set_ios,
@@ -1143,6 +1407,130 @@ static struct mmc_host_ops s3cmci_ops = {
 	.get_cd		= s3cmci_card_present,
 };
 
+static ssize_t s3cmci_show_dma(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct mmc_host *mmc = dev_get_drvdata(dev);
+	struct s3cmci_host *host = mmc_priv(mmc);
+
+	return sprintf(buf, "%d\n", host->use_dma > 0);
+}
+
+static ssize_t s3cmci_store_dma(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct mmc_host *mmc = dev_get_drvdata(dev);
+	struct s3cmci_host *host = mmc_priv(mmc);
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+
+	if (host->use_dma < 0)
+		return val ? -ENODEV : count;
+
+	/* picked up by the next request */
+	host->use_dma = val ? 1 : 0;
+	return count;
+}
+
+static DEVICE_ATTR(dma, S_IRUGO | S_IWUSR, s3cmci_show_dma, s3cmci_store_dma);
+
+#ifdef CONFIG_DEBUG_FS
+
+static int s3cmci_stats_show(struct seq_file *m, void *v)
+{
+	struct s3cmci_host *host = m->private;
+	struct s3cmci_xfer_stat *st;
+	u64 kib, usecs, rate;
+	int mode, write;
+
+	seq_printf(m, "pclk: %lu\nclock: %lu (asked for %u, prescaler %u)\n",
+		   host->clk_rate, host->real_rate, host->ios_clock,
+		   host->prescaler);
+	seq_printf(m, "timing: %s\n",
+		   host->mmc->ios.timing == MMC_TIMING_LEGACY ? "legacy" :
+		   "high speed");
+	seq_printf(m, "dma: %s\n\n", host->use_dma < 0 ? "unavailable" :
+		   (host->use_dma ? "on" : "off"));
+
+	seq_printf(m, "command timeouts: %lu\n", host->errors.cmd_timeout);
+	seq_printf(m, "data crc errors: %lu\n", host->errors.data_crc);
+	seq_printf(m, "data timeouts: %lu\n", host->errors.data_timeout);
+	seq_printf(m, "fifo failures: %lu\n", host->errors.fifo);
+	seq_printf(m, "dma failures: %lu\n\n", host->errors.dma);
+
+	seq_printf(m, "mode dir     requests      KiB     msecs  KiB/s\n");
+
+	for (mode = 0; mode < 2; mode++) {
+		for (write = 0; write < 2; write++) {
+			st = &host->xfer_stat[mode][write];
+
+			kib = st->bytes >> 10;
+			usecs = st->usecs;
+
+			/* div_u64() only takes a 32 bit divisor */
+			while (usecs > 0xffffffffULL) {
+				usecs >>= 1;
+				kib >>= 1;
+			}
+
+			rate = usecs ? div_u64(kib * USEC_PER_SEC, usecs) : 0;
+
+			seq_printf(m, "%-4s %-5s %10lu %8llu %9llu %6llu\n",
+				   mode ? "dma" : "pio",
+				   write ? "write" : "read", st->requests,
+				   (unsigned long long)(st->bytes >> 10),
+				   (unsigned long long)div_u64(st->usecs, 1000),
+				   (unsigned long long)rate);
+		}
+	}
+
+	return 0;
+}
+
+static int s3cmci_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, s3cmci_stats_show, inode->i_private);
+}
+
+static const struct file_operations s3cmci_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= s3cmci_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void s3cmci_debugfs_attach(struct s3cmci_host *host)
+{
+	struct device *dev = &host->pdev->dev;
+
+	host->debug_root = debugfs_create_dir(dev_name(dev), NULL);
+	if (IS_ERR(host->debug_root))
+		host->debug_root = NULL;
+	if (!host->debug_root)
+		return;
+
+	host->debug_stats = debugfs_create_file("stats", S_IRUGO,
+						host->debug_root, host,
+						&s3cmci_stats_fops);
+	if (IS_ERR(host->debug_stats))
+		host->debug_stats = NULL;
+}
+
+static void s3cmci_debugfs_remove(struct s3cmci_host *host)
+{
+	debugfs_remove(host->debug_stats);
+	debugfs_remove(host->debug_root);
+}
+
+#else
+#define s3cmci_debugfs_attach(host) do { } while (0)
+#define s3cmci_debugfs_remove(host) do { } while (0)
+#endif /* CONFIG_DEBUG_FS */
+
 static struct s3c24xx_mci_pdata s3cmci_def_pdata = {
 	/* This is currently here to avoid a number of if (host->pdata)
 	 * checks. Any zero fields to ensure reaonable defaults are picked. */
@@ -1233,6 +1621,7 @@ static int __devinit s3cmci_probe(struct platform_device *pdev, int is2440)
 	 * ensure we don't lock the system with un-serviceable requests. */
 
 	disable_irq(host->irq);
+	host->irq_enabled = 0;
 
 	host->irq_cd = s3c2410_gpio_getirq(host->pdata->gpio_detect);
 
@@ -1256,18 +1645,20 @@ static int __devinit s3cmci_probe(struct platform_device *pdev, int is2440)
 		s3c2410_gpio_cfgpin(host->pdata->gpio_wprotect,
 				    S3C2410_GPIO_INPUT);
 
-	if (s3c2410_dma_request(S3CMCI_DMA, &s3cmci_dma_client, NULL) < 0) {
-		dev_err(&pdev->dev, "unable to get DMA channel.\n");
-		ret = -EBUSY;
-		goto probe_free_irq_cd;
-	}
+	/* without a channel we can still do everything by hand */
+	if (s3c2410_dma_request(host->dma, &s3cmci_dma_client, NULL) < 0) {
+		dev_warn(&pdev->dev, "unable to get DMA channel, "
+			 "using PIO only.\n");
+		host->use_dma = -1;
+	} else
+		host->use_dma = dma ? 1 : 0;
 
 	host->clk = clk_get(&pdev->dev, "sdi");
 	if (IS_ERR(host->clk)) {
 		dev_err(&pdev->dev, "failed to find clock source.\n");
 		ret = PTR_ERR(host->clk);
 		host->clk = NULL;
-		goto probe_free_host;
+		goto probe_free_dma;
 	}
 
 	ret = clk_enable(host->clk);
@@ -1280,7 +1671,8 @@ static int __devinit s3cmci_probe(struct platform_device *pdev, int is2440)
 
 	mmc->ops 	= &s3cmci_ops;
 	mmc->ocr_avail	= MMC_VDD_32_33 | MMC_VDD_33_34;
-	mmc->caps	= MMC_CAP_4_BIT_DATA;
+	mmc->caps	= MMC_CAP_4_BIT_DATA | MMC_CAP_SD_HIGHSPEED |
+			  MMC_CAP_MMC_HIGHSPEED;
 	mmc->f_min 	= host->clk_rate / (host->clk_div * 256);
 	mmc->f_max 	= host->clk_rate / host->clk_div;
 
@@ -1300,24 +1692,45 @@ static int __devinit s3cmci_probe(struct platform_device *pdev, int is2440)
 	    (host->is2440?"2440":""),
 	    host->base, host->irq, host->irq_cd, host->dma);
 
+	s3c24xx_clk_idle_init(host->clk, S3CMCI_IDLE_TIMEOUT_MS);
+
+	ret = s3cmci_cpufreq_register(host);
+	if (ret) {
+		dev_err(&pdev->dev, "failed to init cpufreq support\n");
+		goto free_dmabuf;
+	}
+
 	ret = mmc_add_host(mmc);
 	if (ret) {
 		dev_err(&pdev->dev, "failed to add mmc host.\n");
-		goto free_dmabuf;
+		goto free_cpufreq;
 	}
 
 	platform_set_drvdata(pdev, mmc);
-	dev_info(&pdev->dev, "initialisation done.\n");
+
+	if (device_create_file(&pdev->dev, &dev_attr_dma))
+		dev_warn(&pdev->dev, "failed to add dma attribute.\n");
+
+	s3cmci_debugfs_attach(host);
+
+	dev_info(&pdev->dev, "initialisation done, using %s.\n",
+		 host->use_dma > 0 ? "DMA" : "PIO");
 
 	return 0;
 
+ free_cpufreq:
+	s3cmci_cpufreq_deregister(host);
+
  free_dmabuf:
 	clk_disable(host->clk);
 
  clk_free:
 	clk_put(host->clk);
 
- probe_free_irq_cd:
+ probe_free_dma:
+	if (host->use_dma >= 0)
+		s3c2410_dma_free(host->dma, &s3cmci_dma_client);
+
 	disable_irq_wake(host->irq_cd);
 	if (host->irq_cd >= 0)
 		free_irq(host->irq_cd, host);
@@ -1354,12 +1767,17 @@ static int __devexit s3cmci_remove(struct platform_device *pdev)
 	struct mmc_host		*mmc  = platform_get_drvdata(pdev);
 	struct s3cmci_host	*host = mmc_priv(mmc);
 
+	s3cmci_debugfs_remove(host);
+	device_remove_file(&pdev->dev, &dev_attr_dma);
+
 	s3cmci_shutdown(pdev);
+	s3cmci_cpufreq_deregister(host);
 
 	clk_put(host->clk);
 
 	tasklet_disable(&host->pio_tasklet);
-	s3c2410_dma_free(S3CMCI_DMA, &s3cmci_dma_client);
+	if (host->use_dma >= 0)
+		s3c2410_dma_free(host->dma, &s3cmci_dma_client);
 	disable_irq_wake(host->irq_cd);
 	free_irq(host->irq, host);
 	iounmap(host->base);
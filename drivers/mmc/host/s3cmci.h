@@ -8,8 +8,12 @@
  * published by the Free Software Foundation.
  */
 
-/* FIXME: DMA Resource management ?! */
-#define S3CMCI_DMA 0
+/* the virtual channel, the DMA core picks one of the channels that
+ * can be triggered by the SDI */
+#define S3CMCI_DMA DMACH_SDI
+
+/* gate the SDI clock after this long without a request */
+#define S3CMCI_IDLE_TIMEOUT_MS 50
 
 enum s3cmci_waitfor {
 	COMPLETION_NONE,
@@ -20,6 +24,22 @@ enum s3cmci_waitfor {
 	COMPLETION_XFERFINISH_RSPFIN,
 };
 
+/* errors seen by the interrupt handler and the DMA callback */
+struct s3cmci_errors {
+	unsigned long		cmd_timeout;
+	unsigned long		data_crc;
+	unsigned long		data_timeout;
+	unsigned long		fifo;
+	unsigned long		dma;
+};
+
+/* data transfer totals, from the command to the end of the transfer */
+struct s3cmci_xfer_stat {
+	unsigned long		requests;
+	u64			bytes;
+	u64			usecs;
+};
+
 struct s3cmci_host {
 	struct platform_device	*pdev;
 	struct s3c24xx_mci_pdata *pdata;
@@ -29,11 +49,13 @@ struct s3cmci_host {
 	void __iomem		*base;
 	int			irq;
 	int			irq_cd;
+	int			irq_enabled;
 	int			dma;
 
 	unsigned long		clk_rate;
 	unsigned long		clk_div;
 	unsigned long		real_rate;
+	unsigned int		ios_clock;	/* as last asked for */
 	u8			prescaler;
 
 	int			is2440;
@@ -41,6 +63,11 @@ struct s3cmci_host {
 	unsigned		sdidata;
 	int			dodma;
 	int			dmatogo;
+	int			use_dma;	/* -1 if we have no channel */
+	int			dma_setup;
+	unsigned int		dma_batch;	/* entries per DMA callback */
+	enum s3c2410_dmasrc	dma_source;
+	int			slow_read;	/* 2410 SDIPRE still slowed */
 
 	struct mmc_request	*mrq;
 	int			cmd_is_stop;
@@ -67,4 +94,17 @@ struct s3cmci_host {
 
 	unsigned int		ccnt, dcnt;
 	struct tasklet_struct	pio_tasklet;
+
+	ktime_t			xfer_start;
+	struct s3cmci_xfer_stat	xfer_stat[2][2];	/* [dodma][write] */
+	struct s3cmci_errors	errors;
+
+#ifdef CONFIG_CPU_FREQ
+	struct notifier_block	freq_transition;
+#endif
+
+#ifdef CONFIG_DEBUG_FS
+	struct dentry		*debug_root;
+	struct dentry		*debug_stats;
+#endif
 };
@@ -44,6 +44,10 @@ static int do_blktrans_request(struct mtd_blktrans_ops *tr,
 
 	buf = req->buffer;
 
+	/* cache flush ahead of or behind a barrier, see blk_queue_ordered() */
+	if (req->cmd_type == REQ_TYPE_FLUSH)
+		return tr->flush ? !tr->flush(dev) : 1;
+
 	if (!blk_fs_request(req))
 		return 0;
 
@@ -72,6 +76,12 @@ static int do_blktrans_request(struct mtd_blktrans_ops *tr,
 	}
 }
 
+static void mtd_blktrans_prepare_flush(struct request_queue *rq,
+				       struct request *req)
+{
+	req->cmd_type = REQ_TYPE_FLUSH;
+}
+
 static int mtd_blktrans_thread(void *arg)
 {
 	struct mtd_blktrans_ops *tr = arg;
@@ -367,6 +377,10 @@ int register_mtd_blktrans(struct mtd_blktrans_ops *tr)
 
 	tr->blkcore_priv->rq->queuedata = tr;
 	blk_queue_hardsect_size(tr->blkcore_priv->rq, tr->blksize);
+	if (tr->flush)
+		blk_queue_ordered(tr->blkcore_priv->rq,
+				  QUEUE_ORDERED_DRAIN_FLUSH,
+				  mtd_blktrans_prepare_flush);
 	tr->blkshift = ffs(tr->blksize) - 1;
 
 	tr->blkcore_priv->thread = kthread_run(mtd_blktrans_thread, tr,
@@ -13,20 +13,60 @@
 #include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/vmalloc.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/err.h>
 
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/blktrans.h>
 #include <linux/mutex.h>
 
 
+static unsigned int cache_blocks = CONFIG_MTD_BLOCK_CACHE_BLOCKS;
+module_param(cache_blocks, uint, 0644);
+MODULE_PARM_DESC(cache_blocks, "Eraseblocks cached per device, taken on "
+		 "first open");
+
+static unsigned int flush_delay = 5;
+module_param(flush_delay, uint, 0644);
+MODULE_PARM_DESC(flush_delay, "Seconds a dirty eraseblock is kept before "
+		 "it is written back, 0 to only write back when needed");
+
+struct mtdblk_cache {
+	struct list_head list;
+	unsigned char *data;
+	unsigned long offset;
+	unsigned long dirtied;
+	enum { STATE_EMPTY, STATE_CLEAN, STATE_DIRTY } state;
+};
+
+struct mtdblk_stats {
+	unsigned long read_hits;
+	unsigned long read_misses;
+	unsigned long write_hits;
+	unsigned long write_misses;
+	unsigned long sectors_written;
+	unsigned long writebacks;
+	unsigned long evictions;
+	unsigned long direct_writes;
+	unsigned long errors;
+};
+
 static struct mtdblk_dev {
 	struct mtd_info *mtd;
 	int count;
 	struct mutex cache_mutex;
-	unsigned char *cache_data;
-	unsigned long cache_offset;
 	unsigned int cache_size;
-	enum { STATE_EMPTY, STATE_CLEAN, STATE_DIRTY } cache_state;
+	unsigned int cache_max;
+	unsigned int cache_nr;
+	struct list_head cache_lru;	/* most recently used first */
+	struct delayed_work flush_work;
+	struct mtdblk_stats stats;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *debug_stats;
+#endif
 } *mtdblks[MAX_MTD_DEVICES];
 
 /*
@@ -35,8 +75,15 @@ static struct mtdblk_dev {
  * Since typical flash erasable sectors are much larger than what Linux's
  * buffer cache can handle, we must implement read-modify-write on flash
  * sectors for each block write requests.  To avoid over-erasing flash sectors
- * and to speed things up, we locally cache a whole flash sector while it is
- * being written to until a different sector is required.
+ * and to speed things up, we locally cache whole flash sectors while they
+ * are being written to.
+ *
+ * A FAT on raw NAND scatters its writes over a handful of sectors (the
+ * FAT itself, the directory and the data being written), so a single
+ * cached sector is written back almost every time.  Up to cache_max
+ * sectors are kept on an LRU list instead; the least recently used one
+ * is written back when another is needed, on a flush and at last close,
+ * and flush_delay seconds after it was first dirtied.
  */
 
 static void erase_callback(struct erase_info *done)
@@ -94,40 +141,164 @@ static int erase_write (struct mtd_info *mtd, unsigned long pos,
 }
 
 
-static int write_cached_data (struct mtdblk_dev *mtdblk)
+static int write_cached_data (struct mtdblk_dev *mtdblk,
+			      struct mtdblk_cache *cache)
 {
 	struct mtd_info *mtd = mtdblk->mtd;
 	int ret;
 
-	if (mtdblk->cache_state != STATE_DIRTY)
+	if (cache->state != STATE_DIRTY)
 		return 0;
 
 	DEBUG(MTD_DEBUG_LEVEL2, "mtdblock: writing cached data for \"%s\" "
 			"at 0x%lx, size 0x%x\n", mtd->name,
-			mtdblk->cache_offset, mtdblk->cache_size);
+			cache->offset, mtdblk->cache_size);
 
-	ret = erase_write (mtd, mtdblk->cache_offset,
-			   mtdblk->cache_size, mtdblk->cache_data);
-	if (ret)
+	ret = erase_write (mtd, cache->offset,
+			   mtdblk->cache_size, cache->data);
+	if (ret) {
+		mtdblk->stats.errors++;
 		return ret;
+	}
+
+	mtdblk->stats.writebacks++;
 
 	/*
 	 * Here we could argubly set the cache state to STATE_CLEAN.
 	 * However this could lead to inconsistency since we will not
 	 * be notified if this content is altered on the flash by other
 	 * means.  Let's declare it empty and leave buffering tasks to
-	 * the buffer cache instead.
+	 * the buffer cache instead.  Empty entries go to the tail so
+	 * they are reused first.
 	 */
-	mtdblk->cache_state = STATE_EMPTY;
+	cache->state = STATE_EMPTY;
+	list_move_tail(&cache->list, &mtdblk->cache_lru);
 	return 0;
 }
 
+static int write_all_cached_data (struct mtdblk_dev *mtdblk)
+{
+	struct mtdblk_cache *cache, *next;
+	int ret, err = 0;
+
+	list_for_each_entry_safe(cache, next, &mtdblk->cache_lru, list) {
+		ret = write_cached_data(mtdblk, cache);
+		if (ret && !err)
+			err = ret;
+	}
+
+	return err;
+}
+
+static struct mtdblk_cache *find_cached_sect (struct mtdblk_dev *mtdblk,
+					      unsigned long sect_start)
+{
+	struct mtdblk_cache *cache;
+
+	list_for_each_entry(cache, &mtdblk->cache_lru, list)
+		if (cache->state != STATE_EMPTY && cache->offset == sect_start)
+			return cache;
+
+	return NULL;
+}
+
+/*
+ * Find room for another sector: an empty entry, a new one while below
+ * cache_max, or else the least recently used one after writing it back.
+ */
+static struct mtdblk_cache *get_cache_entry (struct mtdblk_dev *mtdblk)
+{
+	struct mtdblk_cache *cache = NULL;
+	int ret;
+
+	if (!list_empty(&mtdblk->cache_lru)) {
+		cache = list_entry(mtdblk->cache_lru.prev,
+				   struct mtdblk_cache, list);
+		if (cache->state == STATE_EMPTY)
+			return cache;
+	}
+
+	if (mtdblk->cache_nr < mtdblk->cache_max) {
+		struct mtdblk_cache *new;
+
+		new = kzalloc(sizeof(*new), GFP_KERNEL);
+		if (new) {
+			new->data = vmalloc(mtdblk->cache_size);
+			if (new->data) {
+				new->state = STATE_EMPTY;
+				list_add_tail(&new->list, &mtdblk->cache_lru);
+				mtdblk->cache_nr++;
+				return new;
+			}
+			kfree(new);
+		}
+	}
+
+	/* -EINTR is not really correct, but it is the best match
+	 * documented in man 2 write for all cases.  We could also
+	 * return -EAGAIN sometimes, but why bother?
+	 */
+	if (!cache)
+		return ERR_PTR(-EINTR);
+
+	mtdblk->stats.evictions++;
+	ret = write_cached_data(mtdblk, cache);
+	if (ret)
+		return ERR_PTR(ret);
+
+	return cache;
+}
+
+static void free_cache (struct mtdblk_dev *mtdblk)
+{
+	struct mtdblk_cache *cache, *next;
+
+	list_for_each_entry_safe(cache, next, &mtdblk->cache_lru, list) {
+		list_del(&cache->list);
+		vfree(cache->data);
+		kfree(cache);
+	}
+	mtdblk->cache_nr = 0;
+}
+
+static void mtdblock_flush_work(struct work_struct *work)
+{
+	struct mtdblk_dev *mtdblk =
+		container_of(work, struct mtdblk_dev, flush_work.work);
+	unsigned long delay = flush_delay * HZ;
+	unsigned long next = 0;
+	struct mtdblk_cache *cache, *tmp;
+	int pending = 0;
+
+	mutex_lock(&mtdblk->cache_mutex);
+
+	list_for_each_entry_safe(cache, tmp, &mtdblk->cache_lru, list) {
+		if (cache->state != STATE_DIRTY)
+			continue;
+
+		if (time_before(jiffies, cache->dirtied + delay)) {
+			if (!pending || time_before(cache->dirtied, next))
+				next = cache->dirtied;
+			pending = 1;
+			continue;
+		}
+
+		write_cached_data(mtdblk, cache);
+	}
+
+	if (pending)
+		schedule_delayed_work(&mtdblk->flush_work,
+				      next + delay - jiffies);
+
+	mutex_unlock(&mtdblk->cache_mutex);
+}
 
 static int do_cached_write (struct mtdblk_dev *mtdblk, unsigned long pos,
 			    int len, const char *buf)
 {
 	struct mtd_info *mtd = mtdblk->mtd;
 	unsigned int sect_size = mtdblk->cache_size;
+	struct mtdblk_cache *cache;
 	size_t retlen;
 	int ret;
 
@@ -144,44 +315,62 @@ static int do_cached_write (struct mtdblk_dev *mtdblk, unsigned long pos,
 		if( size > len )
 			size = len;
 
+		cache = find_cached_sect(mtdblk, sect_start);
+
 		if (size == sect_size) {
 			/*
 			 * We are covering a whole sector.  Thus there is no
 			 * need to bother with the cache while it may still be
-			 * useful for other partial writes.
+			 * useful for other partial writes.  A cached copy is
+			 * stale now and must not be written back over it.
 			 */
+			if (cache) {
+				cache->state = STATE_EMPTY;
+				list_move_tail(&cache->list, &mtdblk->cache_lru);
+			}
+			mtdblk->stats.direct_writes++;
 			ret = erase_write (mtd, pos, size, buf);
-			if (ret)
+			if (ret) {
+				mtdblk->stats.errors++;
 				return ret;
+			}
 		} else {
 			/* Partial sector: need to use the cache */
 
-			if (mtdblk->cache_state == STATE_DIRTY &&
-			    mtdblk->cache_offset != sect_start) {
-				ret = write_cached_data(mtdblk);
-				if (ret)
-					return ret;
-			}
+			if (cache) {
+				mtdblk->stats.write_hits++;
+				list_move(&cache->list, &mtdblk->cache_lru);
+			} else {
+				mtdblk->stats.write_misses++;
+
+				cache = get_cache_entry(mtdblk);
+				if (IS_ERR(cache))
+					return PTR_ERR(cache);
 
-			if (mtdblk->cache_state == STATE_EMPTY ||
-			    mtdblk->cache_offset != sect_start) {
 				/* fill the cache with the current sector */
-				mtdblk->cache_state = STATE_EMPTY;
 				ret = mtd->read(mtd, sect_start, sect_size,
-						&retlen, mtdblk->cache_data);
+						&retlen, cache->data);
 				if (ret)
 					return ret;
 				if (retlen != sect_size)
 					return -EIO;
 
-				mtdblk->cache_offset = sect_start;
-				mtdblk->cache_size = sect_size;
-				mtdblk->cache_state = STATE_CLEAN;
+				cache->offset = sect_start;
+				cache->state = STATE_CLEAN;
+				list_move(&cache->list, &mtdblk->cache_lru);
 			}
 
 			/* write data to our local cache */
-			memcpy (mtdblk->cache_data + offset, buf, size);
-			mtdblk->cache_state = STATE_DIRTY;
+			memcpy (cache->data + offset, buf, size);
+			mtdblk->stats.sectors_written++;
+
+			if (cache->state != STATE_DIRTY) {
+				cache->state = STATE_DIRTY;
+				cache->dirtied = jiffies;
+				if (flush_delay)
+					schedule_delayed_work(&mtdblk->flush_work,
+							      flush_delay * HZ);
+			}
 		}
 
 		buf += size;
@@ -198,6 +387,7 @@ static int do_cached_read (struct mtdblk_dev *mtdblk, unsigned long pos,
 {
 	struct mtd_info *mtd = mtdblk->mtd;
 	unsigned int sect_size = mtdblk->cache_size;
+	struct mtdblk_cache *cache;
 	size_t retlen;
 	int ret;
 
@@ -220,10 +410,12 @@ static int do_cached_read (struct mtdblk_dev *mtdblk, unsigned long pos,
 		 * contains what we want, otherwise we read the data directly
 		 * from flash.
 		 */
-		if (mtdblk->cache_state != STATE_EMPTY &&
-		    mtdblk->cache_offset == sect_start) {
-			memcpy (buf, mtdblk->cache_data + offset, size);
+		cache = find_cached_sect(mtdblk, sect_start);
+		if (cache) {
+			mtdblk->stats.read_hits++;
+			memcpy (buf, cache->data + offset, size);
 		} else {
+			mtdblk->stats.read_misses++;
 			ret = mtd->read(mtd, pos, size, &retlen, buf);
 			if (ret)
 				return ret;
@@ -239,27 +431,116 @@ static int do_cached_read (struct mtdblk_dev *mtdblk, unsigned long pos,
 	return 0;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *mtdblock_debug_root;
+static int mtdblock_debug_users;
+
+static int mtdblock_stats_show(struct seq_file *m, void *v)
+{
+	struct mtdblk_dev *mtdblk = m->private;
+	struct mtdblk_stats *st = &mtdblk->stats;
+	struct mtdblk_cache *cache;
+	unsigned int dirty = 0;
+
+	mutex_lock(&mtdblk->cache_mutex);
+
+	list_for_each_entry(cache, &mtdblk->cache_lru, list)
+		if (cache->state == STATE_DIRTY)
+			dirty++;
+
+	seq_printf(m, "cache: %u/%u blocks of %u bytes, %u dirty\n",
+		   mtdblk->cache_nr, mtdblk->cache_max, mtdblk->cache_size,
+		   dirty);
+	seq_printf(m, "read hits: %lu\nread misses: %lu\n",
+		   st->read_hits, st->read_misses);
+	seq_printf(m, "write hits: %lu\nwrite misses: %lu\n",
+		   st->write_hits, st->write_misses);
+	seq_printf(m, "sectors cached: %lu\nwritebacks: %lu\n"
+		   "evictions: %lu\ndirect writes: %lu\nerrors: %lu\n",
+		   st->sectors_written, st->writebacks, st->evictions,
+		   st->direct_writes, st->errors);
+
+	mutex_unlock(&mtdblk->cache_mutex);
+	return 0;
+}
+
+static int mtdblock_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtdblock_stats_show, inode->i_private);
+}
+
+static const struct file_operations mtdblock_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mtdblock_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void mtdblock_debugfs_init(struct mtdblk_dev *mtdblk, int dev)
+{
+	char name[16];
+
+	if (!mtdblock_debug_root) {
+		mtdblock_debug_root = debugfs_create_dir("mtdblock", NULL);
+		if (IS_ERR(mtdblock_debug_root))
+			mtdblock_debug_root = NULL;
+		if (!mtdblock_debug_root)
+			return;
+	}
+
+	snprintf(name, sizeof(name), "mtdblock%d", dev);
+
+	mtdblk->debug_stats = debugfs_create_file(name, S_IRUGO,
+						  mtdblock_debug_root, mtdblk,
+						  &mtdblock_stats_fops);
+	if (IS_ERR(mtdblk->debug_stats))
+		mtdblk->debug_stats = NULL;
+	if (mtdblk->debug_stats)
+		mtdblock_debug_users++;
+}
+
+static void mtdblock_debugfs_exit(struct mtdblk_dev *mtdblk)
+{
+	if (!mtdblk->debug_stats)
+		return;
+
+	debugfs_remove(mtdblk->debug_stats);
+
+	if (--mtdblock_debug_users == 0) {
+		debugfs_remove(mtdblock_debug_root);
+		mtdblock_debug_root = NULL;
+	}
+}
+#else
+static inline void mtdblock_debugfs_init(struct mtdblk_dev *mtdblk, int dev) {}
+static inline void mtdblock_debugfs_exit(struct mtdblk_dev *mtdblk) {}
+#endif
+
 static int mtdblock_readsect(struct mtd_blktrans_dev *dev,
 			      unsigned long block, char *buf)
 {
 	struct mtdblk_dev *mtdblk = mtdblks[dev->devnum];
-	return do_cached_read(mtdblk, block<<9, 512, buf);
+	int ret;
+
+	mutex_lock(&mtdblk->cache_mutex);
+	ret = do_cached_read(mtdblk, block<<9, 512, buf);
+	mutex_unlock(&mtdblk->cache_mutex);
+
+	return ret;
 }
 
 static int mtdblock_writesect(struct mtd_blktrans_dev *dev,
 			      unsigned long block, char *buf)
 {
 	struct mtdblk_dev *mtdblk = mtdblks[dev->devnum];
-	if (unlikely(!mtdblk->cache_data && mtdblk->cache_size)) {
-		mtdblk->cache_data = vmalloc(mtdblk->mtd->erasesize);
-		if (!mtdblk->cache_data)
-			return -EINTR;
-		/* -EINTR is not really correct, but it is the best match
-		 * documented in man 2 write for all cases.  We could also
-		 * return -EAGAIN sometimes, but why bother?
-		 */
-	}
-	return do_cached_write(mtdblk, block<<9, 512, buf);
+	int ret;
+
+	mutex_lock(&mtdblk->cache_mutex);
+	ret = do_cached_write(mtdblk, block<<9, 512, buf);
+	mutex_unlock(&mtdblk->cache_mutex);
+
+	return ret;
 }
 
 static int mtdblock_open(struct mtd_blktrans_dev *mbd)
@@ -284,13 +565,15 @@ static int mtdblock_open(struct mtd_blktrans_dev *mbd)
 	mtdblk->mtd = mtd;
 
 	mutex_init(&mtdblk->cache_mutex);
-	mtdblk->cache_state = STATE_EMPTY;
+	INIT_LIST_HEAD(&mtdblk->cache_lru);
+	INIT_DELAYED_WORK(&mtdblk->flush_work, mtdblock_flush_work);
 	if ( !(mtdblk->mtd->flags & MTD_NO_ERASE) && mtdblk->mtd->erasesize) {
 		mtdblk->cache_size = mtdblk->mtd->erasesize;
-		mtdblk->cache_data = NULL;
+		mtdblk->cache_max = max(cache_blocks, 1U);
 	}
 
 	mtdblks[dev] = mtdblk;
+	mtdblock_debugfs_init(mtdblk, dev);
 
 	DEBUG(MTD_DEBUG_LEVEL1, "ok\n");
 
@@ -305,15 +588,17 @@ static int mtdblock_release(struct mtd_blktrans_dev *mbd)
    	DEBUG(MTD_DEBUG_LEVEL1, "mtdblock_release\n");
 
 	mutex_lock(&mtdblk->cache_mutex);
-	write_cached_data(mtdblk);
+	write_all_cached_data(mtdblk);
 	mutex_unlock(&mtdblk->cache_mutex);
 
 	if (!--mtdblk->count) {
 		/* It was the last usage. Free the device */
 		mtdblks[dev] = NULL;
+		cancel_delayed_work_sync(&mtdblk->flush_work);
+		mtdblock_debugfs_exit(mtdblk);
 		if (mtdblk->mtd->sync)
 			mtdblk->mtd->sync(mtdblk->mtd);
-		vfree(mtdblk->cache_data);
+		free_cache(mtdblk);
 		kfree(mtdblk);
 	}
 	DEBUG(MTD_DEBUG_LEVEL1, "ok\n");
@@ -324,14 +609,15 @@ static int mtdblock_release(struct mtd_blktrans_dev *mbd)
 static int mtdblock_flush(struct mtd_blktrans_dev *dev)
 {
 	struct mtdblk_dev *mtdblk = mtdblks[dev->devnum];
+	int ret;
 
 	mutex_lock(&mtdblk->cache_mutex);
-	write_cached_data(mtdblk);
+	ret = write_all_cached_data(mtdblk);
 	mutex_unlock(&mtdblk->cache_mutex);
 
 	if (mtdblk->mtd->sync)
 		mtdblk->mtd->sync(mtdblk->mtd);
-	return 0;
+	return ret;
 }
 
 static void mtdblock_add_mtd(struct mtd_blktrans_ops *tr, struct mtd_info *mtd)
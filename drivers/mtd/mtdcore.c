@@ -17,6 +17,11 @@
 #include <linux/init.h>
 #include <linux/mtd/compatmac.h>
 #include <linux/proc_fs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <asm/uaccess.h>
 
 #include <linux/mtd/mtd.h>
 
@@ -32,6 +37,299 @@ EXPORT_SYMBOL_GPL(mtd_table);
 
 static LIST_HEAD(mtd_notifiers);
 
+#ifdef CONFIG_MTD_LATENCY
+
+/*====================================================================*/
+/* Operation latency histograms */
+
+/*
+ * Each device has a debugfs file, mtd_latency/mtdN, with histograms of
+ * how long its read, write and erase calls take. Writing 1 to it puts
+ * timing wrappers around the device's methods and clears the counts,
+ * writing 0 puts the methods back. Until then there is no cost at all.
+ *
+ * Erase is timed until the call returns. That is the whole erase for
+ * NAND, but only the start of it for drivers which complete erases
+ * from the callback.
+ */
+
+#define MTD_LAT_BUCKETS		16	/* bucket 0 is below 64us */
+#define MTD_LAT_SHIFT		6
+
+enum {
+	MTD_LAT_READ,
+	MTD_LAT_WRITE,
+	MTD_LAT_ERASE,
+	MTD_LAT_OPS
+};
+
+struct mtd_latency {
+	spinlock_t lock;
+	int enabled;
+
+	/* the device's own methods, while wrapped */
+	int (*read)(struct mtd_info *mtd, loff_t from, size_t len,
+		    size_t *retlen, u_char *buf);
+	int (*write)(struct mtd_info *mtd, loff_t to, size_t len,
+		     size_t *retlen, const u_char *buf);
+	int (*erase)(struct mtd_info *mtd, struct erase_info *instr);
+
+	unsigned int hist[MTD_LAT_OPS][MTD_LAT_BUCKETS];
+	unsigned int count[MTD_LAT_OPS];
+	unsigned int errors[MTD_LAT_OPS];
+	unsigned long long bytes[MTD_LAT_OPS];
+	unsigned long long total_us[MTD_LAT_OPS];
+	unsigned long since;
+
+	struct dentry *dentry;
+};
+
+static struct mtd_latency *mtd_latency[MAX_MTD_DEVICES];
+static struct dentry *mtd_latency_root;
+static int mtd_latency_users;
+
+static const char *mtd_latency_ops[MTD_LAT_OPS] = {
+	"read", "write", "erase",
+};
+
+static void mtd_latency_account(struct mtd_latency *lat, int op,
+				ktime_t start, size_t len, int ret)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	unsigned long flags;
+	int b = 0;
+
+	if (us >= (1 << MTD_LAT_SHIFT))
+		b = min_t(int, fls((u32)min_t(s64, us, INT_MAX) >>
+				   MTD_LAT_SHIFT), MTD_LAT_BUCKETS - 1);
+
+	spin_lock_irqsave(&lat->lock, flags);
+	lat->hist[op][b]++;
+	lat->count[op]++;
+	lat->bytes[op] += len;
+	lat->total_us[op] += us;
+	if (ret && ret != -EUCLEAN)
+		lat->errors[op]++;
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+
+static int mtd_latency_read(struct mtd_info *mtd, loff_t from, size_t len,
+			    size_t *retlen, u_char *buf)
+{
+	struct mtd_latency *lat = mtd_latency[mtd->index];
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = lat->read(mtd, from, len, retlen, buf);
+	mtd_latency_account(lat, MTD_LAT_READ, start, *retlen, ret);
+	return ret;
+}
+
+static int mtd_latency_write(struct mtd_info *mtd, loff_t to, size_t len,
+			     size_t *retlen, const u_char *buf)
+{
+	struct mtd_latency *lat = mtd_latency[mtd->index];
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = lat->write(mtd, to, len, retlen, buf);
+	mtd_latency_account(lat, MTD_LAT_WRITE, start, *retlen, ret);
+	return ret;
+}
+
+static int mtd_latency_erase(struct mtd_info *mtd, struct erase_info *instr)
+{
+	struct mtd_latency *lat = mtd_latency[mtd->index];
+	ktime_t start = ktime_get();
+	size_t len = instr->len;
+	int ret;
+
+	ret = lat->erase(mtd, instr);
+	mtd_latency_account(lat, MTD_LAT_ERASE, start, len, ret);
+	return ret;
+}
+
+/* called with mtd_table_mutex held */
+static void mtd_latency_enable(struct mtd_info *mtd, int on)
+{
+	struct mtd_latency *lat = mtd_latency[mtd->index];
+
+	if (on && !lat->enabled) {
+		lat->read = mtd->read;
+		lat->write = mtd->write;
+		lat->erase = mtd->erase;
+		if (mtd->read)
+			mtd->read = mtd_latency_read;
+		if (mtd->write)
+			mtd->write = mtd_latency_write;
+		if (mtd->erase)
+			mtd->erase = mtd_latency_erase;
+	} else if (!on && lat->enabled) {
+		mtd->read = lat->read;
+		mtd->write = lat->write;
+		mtd->erase = lat->erase;
+	}
+
+	lat->enabled = on;
+}
+
+static int mtd_latency_show(struct seq_file *m, void *v)
+{
+	struct mtd_info *mtd = m->private;
+	struct mtd_latency *lat, *cur = mtd_latency[mtd->index];
+	int op, b, last = 0;
+
+	lat = kmalloc(sizeof(*lat), GFP_KERNEL);
+	if (!lat)
+		return -ENOMEM;
+
+	spin_lock_irq(&cur->lock);
+	memcpy(lat, cur, sizeof(*lat));
+	spin_unlock_irq(&cur->lock);
+
+	if (!lat->enabled) {
+		seq_printf(m, "off\n");
+		goto out;
+	}
+
+	seq_printf(m, "since: %u ms ago\n\n",
+		   jiffies_to_msecs(jiffies - lat->since));
+	seq_printf(m, "op         calls   errors        bytes   avg us\n");
+
+	for (op = 0; op < MTD_LAT_OPS; op++) {
+		seq_printf(m, "%-5s %10u %8u %12llu %8llu\n",
+			   mtd_latency_ops[op], lat->count[op],
+			   lat->errors[op], lat->bytes[op],
+			   lat->count[op] ? div_u64(lat->total_us[op],
+						    lat->count[op]) : 0);
+		for (b = 0; b < MTD_LAT_BUCKETS; b++)
+			if (lat->hist[op][b] && b > last)
+				last = b;
+	}
+
+	seq_printf(m, "\n        from");
+	for (op = 0; op < MTD_LAT_OPS; op++)
+		seq_printf(m, " %9s", mtd_latency_ops[op]);
+	seq_putc(m, '\n');
+
+	for (b = 0; b <= last; b++) {
+		seq_printf(m, "%10uus", b ? 1 << (b + MTD_LAT_SHIFT - 1) : 0);
+		for (op = 0; op < MTD_LAT_OPS; op++)
+			seq_printf(m, " %9u", lat->hist[op][b]);
+		seq_putc(m, '\n');
+	}
+
+ out:
+	kfree(lat);
+	return 0;
+}
+
+static int mtd_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtd_latency_show, inode->i_private);
+}
+
+static ssize_t mtd_latency_write_file(struct file *file,
+				      const char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct mtd_info *mtd =
+		((struct seq_file *)file->private_data)->private;
+	struct mtd_latency *lat = mtd_latency[mtd->index];
+	char c;
+
+	if (!count)
+		return 0;
+	if (get_user(c, buf))
+		return -EFAULT;
+	if (c != '0' && c != '1')
+		return -EINVAL;
+
+	mutex_lock(&mtd_table_mutex);
+
+	spin_lock_irq(&lat->lock);
+	memset(lat->hist, 0, sizeof(lat->hist));
+	memset(lat->count, 0, sizeof(lat->count));
+	memset(lat->errors, 0, sizeof(lat->errors));
+	memset(lat->bytes, 0, sizeof(lat->bytes));
+	memset(lat->total_us, 0, sizeof(lat->total_us));
+	lat->since = jiffies;
+	spin_unlock_irq(&lat->lock);
+
+	mtd_latency_enable(mtd, c == '1');
+
+	mutex_unlock(&mtd_table_mutex);
+	return count;
+}
+
+static const struct file_operations mtd_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mtd_latency_open,
+	.read		= seq_read,
+	.write		= mtd_latency_write_file,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* called with mtd_table_mutex held */
+static void mtd_latency_add(struct mtd_info *mtd)
+{
+	struct mtd_latency *lat;
+	char name[16];
+
+	if (!mtd_latency_root) {
+		mtd_latency_root = debugfs_create_dir("mtd_latency", NULL);
+		if (IS_ERR(mtd_latency_root))
+			mtd_latency_root = NULL;
+		if (!mtd_latency_root)
+			return;
+	}
+
+	lat = kzalloc(sizeof(*lat), GFP_KERNEL);
+	if (!lat)
+		return;
+
+	spin_lock_init(&lat->lock);
+
+	snprintf(name, sizeof(name), "mtd%d", mtd->index);
+	lat->dentry = debugfs_create_file(name, S_IRUGO | S_IWUSR,
+					  mtd_latency_root, mtd,
+					  &mtd_latency_fops);
+	if (IS_ERR(lat->dentry) || !lat->dentry) {
+		kfree(lat);
+		return;
+	}
+
+	mtd_latency[mtd->index] = lat;
+	mtd_latency_users++;
+}
+
+/* called with mtd_table_mutex held */
+static void mtd_latency_del(struct mtd_info *mtd)
+{
+	struct mtd_latency *lat = mtd_latency[mtd->index];
+
+	if (!lat)
+		return;
+
+	debugfs_remove(lat->dentry);
+	mtd_latency_enable(mtd, 0);
+	mtd_latency[mtd->index] = NULL;
+	kfree(lat);
+
+	if (--mtd_latency_users == 0) {
+		debugfs_remove(mtd_latency_root);
+		mtd_latency_root = NULL;
+	}
+}
+
+#else
+
+static inline void mtd_latency_add(struct mtd_info *mtd) { }
+static inline void mtd_latency_del(struct mtd_info *mtd) { }
+
+#endif /* CONFIG_MTD_LATENCY */
+
 /**
  *	add_mtd_device - register an MTD device
  *	@mtd: pointer to new MTD device info structure
@@ -67,6 +365,8 @@ int add_mtd_device(struct mtd_info *mtd)
 					       mtd->name);
 			}
 
+			mtd_latency_add(mtd);
+
 			DEBUG(0, "mtd: Giving out device %d to %s\n",i, mtd->name);
 			/* No need to get a refcount on the module containing
 			   the notifier, since we hold the mtd_table_mutex */
@@ -116,6 +416,7 @@ int del_mtd_device (struct mtd_info *mtd)
 		list_for_each_entry(not, &mtd_notifiers, list)
 			not->remove(mtd);
 
+		mtd_latency_del(mtd);
 		mtd_table[mtd->index] = NULL;
 
 		module_put(THIS_MODULE);
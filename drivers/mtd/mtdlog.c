@@ -0,0 +1,893 @@
+/*
+ * Persistent compressed kernel log in an MTD partition
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * Unlike mtdoops, which only keeps what is printed during an oops, every
+ * console message is kept, together with binary event records passed to
+ * mtdlog_event(), so the last minutes before a hang can be read back on
+ * the next boot.
+ *
+ * The console only copies each message into a RAM staging buffer. From
+ * a work item, the staged records are deflated a flash page at a time
+ * and appended to the current eraseblock, once flush_interval seconds
+ * after the first record was staged, or sooner when the buffer is half
+ * full. Each page is a complete zlib stream, so it can be read without
+ * its neighbours, and a block is only erased when the log moves on to
+ * it, so the partition is used as a ring of eraseblocks.
+ *
+ * The log, oldest page first, is in /proc/mtdlog.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/console.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+#include <linux/zlib.h>
+#include <linux/crc32.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/mtdlog.h>
+
+#define MTDLOG_MAGIC		0x474f4c4d	/* "MLOG" */
+#define MTDLOG_STAGE_SIZE	(32 * 1024)
+#define MTDLOG_RAW_MAX		(64 * 1024)	/* most a page inflates to */
+
+/* input is deflated in chunks, each followed by a sync flush, while
+ * there is room left in the page for the chunk at its worst; on small
+ * pages the chunks are cut down to what fits */
+#define MTDLOG_CHUNK		512
+#define MTDLOG_SLACK		64
+
+static char *mtddev = "KLOG";
+module_param(mtddev, charp, 0444);
+MODULE_PARM_DESC(mtddev, "Name of the MTD partition to log to, which must "
+		 "not be used for anything else");
+
+static unsigned int flush_interval = 30;
+module_param(flush_interval, uint, 0644);
+MODULE_PARM_DESC(flush_interval, "Seconds a record is kept in RAM at most "
+		 "before it is written");
+
+/* at the start of each page */
+struct mtdlog_page {
+	__le32	magic;
+	__le32	seq;
+	__le16	boot;
+	__le16	len;		/* compressed bytes which follow */
+	__le32	crc;		/* of those bytes */
+};
+
+/* ahead of each record, before compression */
+struct mtdlog_rec {
+	__le16	type;		/* MTDLOG_TEXT or an event type */
+	__le16	len;
+	__le32	msecs;		/* since boot */
+};
+
+static struct mtdlog_context {
+	struct mtd_info *mtd;
+	int ppb;		/* pages per block */
+	int nr_blocks;
+	int block;		/* where the next page goes */
+	int page;
+	u32 seq;
+	u16 boot;
+	int ready;		/* position known */
+
+	/* flash access and the position above */
+	struct mutex lock;
+	struct work_struct work_flush;
+	struct delayed_work work_timer;
+
+	u8 *page_buf;
+	z_stream deflate;
+
+	/* console side, under stage_lock */
+	spinlock_t stage_lock;
+	u8 *stage;
+	u8 *flushing;
+	size_t stage_len;
+	int stage_kick;
+	unsigned long dropped;
+
+	/* statistics */
+	unsigned long pages_written;
+	unsigned long blocks_erased;
+	unsigned long long raw_bytes;
+	unsigned long long flash_bytes;
+	unsigned long errors;
+} mtdlog_cxt;
+
+static inline loff_t mtdlog_offs(struct mtdlog_context *cxt,
+				 int block, int page)
+{
+	return (loff_t)block * cxt->mtd->erasesize +
+		(loff_t)page * cxt->mtd->writesize;
+}
+
+/* staging */
+
+static void mtdlog_stage(struct mtdlog_context *cxt, unsigned int type,
+			 const void *data, size_t len)
+{
+	struct mtdlog_rec rec;
+	unsigned long flags;
+	int kick = 0;
+
+	if (!cxt->stage || !len)
+		return;
+
+	if (len > 0xffff)
+		len = 0xffff;
+
+	rec.type = cpu_to_le16(type);
+	rec.len = cpu_to_le16(len);
+	rec.msecs = cpu_to_le32(jiffies_to_msecs(jiffies - INITIAL_JIFFIES));
+
+	spin_lock_irqsave(&cxt->stage_lock, flags);
+
+	if (cxt->stage_len + sizeof(rec) + len > MTDLOG_STAGE_SIZE) {
+		cxt->dropped++;
+		kick = 1;
+	} else {
+		memcpy(cxt->stage + cxt->stage_len, &rec, sizeof(rec));
+		memcpy(cxt->stage + cxt->stage_len + sizeof(rec), data, len);
+		cxt->stage_len += sizeof(rec) + len;
+
+		if (cxt->stage_len > MTDLOG_STAGE_SIZE / 2 && !cxt->stage_kick) {
+			cxt->stage_kick = 1;
+			kick = 1;
+		}
+	}
+
+	spin_unlock_irqrestore(&cxt->stage_lock, flags);
+
+	if (!cxt->mtd)
+		return;
+
+	if (kick)
+		schedule_work(&cxt->work_flush);
+	else
+		schedule_delayed_work(&cxt->work_timer, flush_interval * HZ);
+}
+
+/**
+ * mtdlog_event - add a binary record to the persistent log
+ * @type:	record type, from MTDLOG_EVENT up
+ * @data:	record contents
+ * @len:	size of the record
+ *
+ * May be called from any context.
+ */
+void mtdlog_event(unsigned int type, const void *data, size_t len)
+{
+	mtdlog_stage(&mtdlog_cxt, type, data, len);
+}
+EXPORT_SYMBOL_GPL(mtdlog_event);
+
+/* flash side */
+
+static void mtdlog_erase_callback(struct erase_info *done)
+{
+	wait_queue_head_t *wait_q = (wait_queue_head_t *)done->priv;
+	wake_up(wait_q);
+}
+
+static int mtdlog_erase_block(struct mtdlog_context *cxt, int block)
+{
+	struct mtd_info *mtd = cxt->mtd;
+	struct erase_info erase;
+	DECLARE_WAITQUEUE(wait, current);
+	wait_queue_head_t wait_q;
+	int ret;
+
+	init_waitqueue_head(&wait_q);
+	memset(&erase, 0, sizeof(erase));
+	erase.mtd = mtd;
+	erase.callback = mtdlog_erase_callback;
+	erase.addr = mtdlog_offs(cxt, block, 0);
+	erase.len = mtd->erasesize;
+	erase.priv = (u_long)&wait_q;
+
+	set_current_state(TASK_INTERRUPTIBLE);
+	add_wait_queue(&wait_q, &wait);
+
+	ret = mtd->erase(mtd, &erase);
+	if (ret) {
+		set_current_state(TASK_RUNNING);
+		remove_wait_queue(&wait_q, &wait);
+		return ret;
+	}
+
+	schedule();  /* Wait for erase to finish. */
+	remove_wait_queue(&wait_q, &wait);
+
+	if (erase.state == MTD_ERASE_FAILED)
+		return -EIO;
+
+	cxt->blocks_erased++;
+	return 0;
+}
+
+/* move on to the next good block, and erase it */
+static int mtdlog_next_block(struct mtdlog_context *cxt)
+{
+	struct mtd_info *mtd = cxt->mtd;
+	int tries, block = cxt->block;
+	int ret;
+
+	for (tries = 0; tries < cxt->nr_blocks; tries++) {
+		block = (block + 1) % cxt->nr_blocks;
+
+		if (mtd->block_isbad &&
+		    mtd->block_isbad(mtd, mtdlog_offs(cxt, block, 0)))
+			continue;
+
+		ret = mtdlog_erase_block(cxt, block);
+		if (ret == 0) {
+			cxt->block = block;
+			cxt->page = 0;
+			return 0;
+		}
+
+		printk(KERN_WARNING "mtdlog: erase of block %d failed (%d)\n",
+		       block, ret);
+		cxt->errors++;
+
+		if (ret == -EIO && mtd->block_markbad)
+			mtd->block_markbad(mtd, mtdlog_offs(cxt, block, 0));
+	}
+
+	printk(KERN_ERR "mtdlog: no usable block left\n");
+	cxt->ready = 0;
+	return -EIO;
+}
+
+/* deflate as much of the stream as fits into one page and write it */
+static int mtdlog_write_page(struct mtdlog_context *cxt)
+{
+	struct mtd_info *mtd = cxt->mtd;
+	struct mtdlog_page *hdr = (struct mtdlog_page *)cxt->page_buf;
+	z_stream *strm = &cxt->deflate;
+	unsigned int todo = strm->avail_in;
+	unsigned int left = todo;
+	unsigned int chunk;
+	size_t retlen;
+	int ret;
+
+	if (cxt->page >= cxt->ppb) {
+		ret = mtdlog_next_block(cxt);
+		if (ret)
+			return ret;
+	}
+
+	zlib_deflateReset(strm);
+	strm->next_out = cxt->page_buf + sizeof(*hdr);
+	strm->avail_out = mtd->writesize - sizeof(*hdr);
+
+	while (left && strm->avail_out > MTDLOG_SLACK) {
+		chunk = min_t(unsigned int, left, MTDLOG_CHUNK);
+		chunk = min_t(unsigned int, chunk,
+			      strm->avail_out - MTDLOG_SLACK);
+
+		strm->avail_in = chunk;
+		ret = zlib_deflate(strm, Z_SYNC_FLUSH);
+		if (ret != Z_OK)
+			return -EINVAL;
+
+		left -= chunk - strm->avail_in;
+	}
+
+	/* otherwise the caller would write empty pages for ever */
+	if (left == todo) {
+		strm->avail_in = left;
+		return -ENOSPC;
+	}
+
+	strm->avail_in = 0;
+	ret = zlib_deflate(strm, Z_FINISH);
+	strm->avail_in = left;
+	if (ret != Z_STREAM_END)
+		return -EINVAL;
+
+	hdr->magic = cpu_to_le32(MTDLOG_MAGIC);
+	hdr->seq = cpu_to_le32(cxt->seq);
+	hdr->boot = cpu_to_le16(cxt->boot);
+	hdr->len = cpu_to_le16(strm->total_out);
+	hdr->crc = cpu_to_le32(crc32(0, cxt->page_buf + sizeof(*hdr),
+				     strm->total_out));
+
+	memset(strm->next_out, 0xff, strm->avail_out);
+
+	ret = mtd->write(mtd, mtdlog_offs(cxt, cxt->block, cxt->page),
+			 mtd->writesize, &retlen, cxt->page_buf);
+
+	/* whatever happened, the page cannot be written again */
+	cxt->page++;
+	cxt->seq++;
+
+	if (ret || retlen != mtd->writesize) {
+		printk(KERN_WARNING "mtdlog: write to block %d failed (%d)\n",
+		       cxt->block, ret);
+		cxt->errors++;
+		cxt->page = cxt->ppb;
+		return 0;
+	}
+
+	cxt->pages_written++;
+	cxt->flash_bytes += mtd->writesize;
+	return 0;
+}
+
+static int mtdlog_write(struct mtdlog_context *cxt, u8 *buf, size_t len)
+{
+	z_stream *strm = &cxt->deflate;
+	int ret;
+
+	cxt->raw_bytes += len;
+
+	strm->next_in = buf;
+	strm->avail_in = len;
+
+	while (strm->avail_in) {
+		ret = mtdlog_write_page(cxt);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int mtdlog_page_free(const struct mtdlog_page *hdr)
+{
+	const u8 *p = (const u8 *)hdr;
+	int i;
+
+	for (i = 0; i < sizeof(*hdr); i++)
+		if (p[i] != 0xff)
+			return 0;
+	return 1;
+}
+
+static int mtdlog_read_hdr(struct mtdlog_context *cxt, int block, int page,
+			   struct mtdlog_page *hdr)
+{
+	size_t retlen;
+	int ret;
+
+	ret = cxt->mtd->read(cxt->mtd, mtdlog_offs(cxt, block, page),
+			     sizeof(*hdr), &retlen, (u_char *)hdr);
+	if ((ret && ret != -EUCLEAN) || retlen != sizeof(*hdr))
+		return -EIO;
+
+	return 0;
+}
+
+/*
+ * Find where the last boot stopped writing: the first free page of the
+ * block with the newest first page. Only one page per block and the
+ * pages of that one block are read.
+ */
+static void mtdlog_scan(struct mtdlog_context *cxt)
+{
+	struct mtd_info *mtd = cxt->mtd;
+	struct mtdlog_page hdr;
+	int block, page, newest = -1;
+	u32 seq = 0;
+	u16 boot = 0;
+
+	for (block = 0; block < cxt->nr_blocks; block++) {
+		if (mtd->block_isbad &&
+		    mtd->block_isbad(mtd, mtdlog_offs(cxt, block, 0)))
+			continue;
+
+		if (mtdlog_read_hdr(cxt, block, 0, &hdr) ||
+		    le32_to_cpu(hdr.magic) != MTDLOG_MAGIC)
+			continue;
+
+		if (newest < 0 || (s32)(le32_to_cpu(hdr.seq) - seq) > 0) {
+			newest = block;
+			seq = le32_to_cpu(hdr.seq);
+			boot = le16_to_cpu(hdr.boot);
+		}
+	}
+
+	cxt->ready = 1;
+
+	if (newest < 0) {
+		/* nothing there yet, start with the first good block */
+		cxt->block = cxt->nr_blocks - 1;
+		cxt->page = cxt->ppb;
+		cxt->seq = 0;
+		cxt->boot = 0;
+		printk(KERN_INFO "mtdlog: empty log on \"%s\"\n", mtd->name);
+		return;
+	}
+
+	cxt->block = newest;
+	cxt->page = cxt->ppb;
+
+	for (page = 1; page < cxt->ppb; page++) {
+		if (mtdlog_read_hdr(cxt, newest, page, &hdr))
+			break;
+
+		if (le32_to_cpu(hdr.magic) == MTDLOG_MAGIC) {
+			seq = le32_to_cpu(hdr.seq);
+			boot = le16_to_cpu(hdr.boot);
+			continue;
+		}
+
+		/* anything but an erased page starts a new block */
+		if (mtdlog_page_free(&hdr))
+			cxt->page = page;
+		break;
+	}
+
+	cxt->seq = seq + 1;
+	cxt->boot = boot + 1;
+
+	printk(KERN_INFO "mtdlog: boot %u, continuing at block %d page %d "
+	       "of \"%s\"\n", cxt->boot, cxt->block, cxt->page, mtd->name);
+}
+
+static void mtdlog_flush(struct mtdlog_context *cxt)
+{
+	unsigned long flags;
+	size_t len;
+	u8 *buf;
+
+	mutex_lock(&cxt->lock);
+
+	if (!cxt->mtd)
+		goto out;
+
+	if (!cxt->ready) {
+		mtdlog_scan(cxt);
+		if (!cxt->ready)
+			goto out;
+	}
+
+	spin_lock_irqsave(&cxt->stage_lock, flags);
+	buf = cxt->stage;
+	len = cxt->stage_len;
+	cxt->stage = cxt->flushing;
+	cxt->stage_len = 0;
+	cxt->stage_kick = 0;
+	cxt->flushing = buf;
+	spin_unlock_irqrestore(&cxt->stage_lock, flags);
+
+	if (len && mtdlog_write(cxt, buf, len))
+		cxt->errors++;
+
+ out:
+	mutex_unlock(&cxt->lock);
+}
+
+static void mtdlog_work_flush(struct work_struct *work)
+{
+	mtdlog_flush(container_of(work, struct mtdlog_context, work_flush));
+}
+
+static void mtdlog_work_timer(struct work_struct *work)
+{
+	mtdlog_flush(container_of(work, struct mtdlog_context,
+				  work_timer.work));
+}
+
+/* reading back */
+
+struct mtdlog_reader {
+	struct mtdlog_context *cxt;
+	z_stream inflate;
+	u8 *page_buf;
+	u8 *raw;
+	loff_t pos;		/* of the page being shown */
+	int empty_block;	/* from pos / ppb, the rest of it is erased */
+
+	/* output state ahead of the page at saved_pos, so that a page
+	 * seq_file shows again after growing its buffer reads the same */
+	int last_boot;
+	int line_start;
+	loff_t saved_pos;
+	int saved_boot;
+	int saved_line_start;
+};
+
+/* pages are numbered from the one after the current block, oldest first */
+static int mtdlog_pos_block(struct mtdlog_context *cxt, loff_t pos)
+{
+	return (cxt->block + 1 + (int)(pos / cxt->ppb)) % cxt->nr_blocks;
+}
+
+static void *mtdlog_seq_start(struct seq_file *m, loff_t *pos)
+{
+	struct mtdlog_reader *rd = m->private;
+	struct mtdlog_context *cxt = rd->cxt;
+
+	mutex_lock(&cxt->lock);
+
+	if (!cxt->mtd || !cxt->ready ||
+	    *pos >= (loff_t)cxt->nr_blocks * cxt->ppb)
+		return NULL;
+
+	rd->pos = *pos;
+	return rd;
+}
+
+static void *mtdlog_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	struct mtdlog_reader *rd = m->private;
+	struct mtdlog_context *cxt = rd->cxt;
+
+	(*pos)++;
+	if ((int)(*pos / cxt->ppb) == rd->empty_block)
+		*pos = (loff_t)(rd->empty_block + 1) * cxt->ppb;
+
+	if (*pos >= (loff_t)cxt->nr_blocks * cxt->ppb)
+		return NULL;
+
+	rd->pos = *pos;
+	return rd;
+}
+
+static void mtdlog_seq_stop(struct seq_file *m, void *v)
+{
+	struct mtdlog_reader *rd = m->private;
+
+	mutex_unlock(&rd->cxt->lock);
+}
+
+static void mtdlog_show_records(struct seq_file *m, struct mtdlog_reader *rd,
+				const u8 *p, size_t len)
+{
+	struct mtdlog_rec rec;
+	unsigned int type, rlen, msecs, i;
+
+	while (len >= sizeof(rec)) {
+		memcpy(&rec, p, sizeof(rec));
+		type = le16_to_cpu(rec.type);
+		rlen = le16_to_cpu(rec.len);
+		msecs = le32_to_cpu(rec.msecs);
+
+		p += sizeof(rec);
+		len -= sizeof(rec);
+		if (rlen > len)
+			rlen = len;
+
+		if (type == MTDLOG_TEXT) {
+			for (i = 0; i < rlen; i++) {
+				if (rd->line_start)
+					seq_printf(m, "[%5u.%03u] ",
+						   msecs / 1000, msecs % 1000);
+				seq_putc(m, p[i]);
+				rd->line_start = (p[i] == '\n');
+			}
+		} else {
+			if (!rd->line_start)
+				seq_putc(m, '\n');
+			seq_printf(m, "[%5u.%03u] event %u:", msecs / 1000,
+				   msecs % 1000, type);
+			for (i = 0; i < rlen; i++)
+				seq_printf(m, " %02x", p[i]);
+			seq_putc(m, '\n');
+			rd->line_start = 1;
+		}
+
+		p += rlen;
+		len -= rlen;
+	}
+}
+
+static int mtdlog_seq_show(struct seq_file *m, void *v)
+{
+	struct mtdlog_reader *rd = v;
+	struct mtdlog_context *cxt = rd->cxt;
+	struct mtd_info *mtd = cxt->mtd;
+	struct mtdlog_page *hdr = (struct mtdlog_page *)rd->page_buf;
+	int block = mtdlog_pos_block(cxt, rd->pos);
+	int page = rd->pos % cxt->ppb;
+	unsigned int len, boot;
+	size_t retlen;
+	int ret;
+
+	if (rd->pos == rd->saved_pos) {
+		rd->last_boot = rd->saved_boot;
+		rd->line_start = rd->saved_line_start;
+	} else {
+		rd->saved_pos = rd->pos;
+		rd->saved_boot = rd->last_boot;
+		rd->saved_line_start = rd->line_start;
+	}
+
+	/* the current block is only written up to cxt->page */
+	if (block == cxt->block && page >= cxt->page)
+		return 0;
+
+	ret = mtd->read(mtd, mtdlog_offs(cxt, block, page), mtd->writesize,
+			&retlen, rd->page_buf);
+	if ((ret && ret != -EUCLEAN) || retlen != mtd->writesize)
+		return 0;
+
+	if (le32_to_cpu(hdr->magic) != MTDLOG_MAGIC) {
+		/* pages are written in order, the rest of it is empty */
+		if (mtdlog_page_free(hdr))
+			rd->empty_block = rd->pos / cxt->ppb;
+		return 0;
+	}
+
+	len = le16_to_cpu(hdr->len);
+	if (len > mtd->writesize - sizeof(*hdr) ||
+	    le32_to_cpu(hdr->crc) != crc32(0, rd->page_buf + sizeof(*hdr), len))
+		return 0;
+
+	zlib_inflateReset(&rd->inflate);
+	rd->inflate.next_in = rd->page_buf + sizeof(*hdr);
+	rd->inflate.avail_in = len;
+	rd->inflate.next_out = rd->raw;
+	rd->inflate.avail_out = MTDLOG_RAW_MAX;
+
+	ret = zlib_inflate(&rd->inflate, Z_FINISH);
+	if (ret != Z_STREAM_END)
+		return 0;
+
+	boot = le16_to_cpu(hdr->boot);
+	if (boot != rd->last_boot) {
+		if (!rd->line_start)
+			seq_putc(m, '\n');
+		seq_printf(m, "--- boot %u ---\n", boot);
+		rd->last_boot = boot;
+		rd->line_start = 1;
+	}
+
+	mtdlog_show_records(m, rd, rd->raw, rd->inflate.total_out);
+	return 0;
+}
+
+static const struct seq_operations mtdlog_seq_ops = {
+	.start	= mtdlog_seq_start,
+	.next	= mtdlog_seq_next,
+	.stop	= mtdlog_seq_stop,
+	.show	= mtdlog_seq_show,
+};
+
+static int mtdlog_proc_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *m = file->private_data;
+	struct mtdlog_reader *rd = m->private;
+
+	vfree(rd->inflate.workspace);
+	vfree(rd->raw);
+	kfree(rd->page_buf);
+	kfree(rd);
+
+	return seq_release(inode, file);
+}
+
+static int mtdlog_proc_open(struct inode *inode, struct file *file)
+{
+	struct mtdlog_context *cxt = &mtdlog_cxt;
+	struct mtdlog_reader *rd;
+	int ret = -ENOMEM;
+
+	if (!cxt->mtd)
+		return -ENODEV;
+
+	/* so the log read includes what is still staged */
+	mtdlog_flush(cxt);
+
+	rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+	if (!rd)
+		return -ENOMEM;
+
+	rd->cxt = cxt;
+	rd->empty_block = -1;
+	rd->saved_pos = -1;
+	rd->last_boot = -1;
+	rd->line_start = 1;
+	rd->page_buf = kmalloc(cxt->mtd->writesize, GFP_KERNEL);
+	rd->raw = vmalloc(MTDLOG_RAW_MAX);
+	rd->inflate.workspace = vmalloc(zlib_inflate_workspacesize());
+	if (!rd->page_buf || !rd->raw || !rd->inflate.workspace)
+		goto err;
+
+	if (zlib_inflateInit(&rd->inflate) != Z_OK)
+		goto err;
+
+	ret = seq_open(file, &mtdlog_seq_ops);
+	if (ret)
+		goto err;
+
+	((struct seq_file *)file->private_data)->private = rd;
+	return 0;
+
+ err:
+	vfree(rd->inflate.workspace);
+	vfree(rd->raw);
+	kfree(rd->page_buf);
+	kfree(rd);
+	return ret;
+}
+
+static const struct file_operations mtdlog_proc_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mtdlog_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= mtdlog_proc_release,
+};
+
+/* mtd and console glue */
+
+static void mtdlog_notify_add(struct mtd_info *mtd)
+{
+	struct mtdlog_context *cxt = &mtdlog_cxt;
+
+	if (cxt->mtd || strcmp(mtd->name, mtddev))
+		return;
+
+	if (mtd->size < mtd->erasesize * 2 || mtd->writesize < 512 ||
+	    !(mtd->flags & MTD_WRITEABLE)) {
+		printk(KERN_ERR "mtdlog: cannot use \"%s\"\n", mtd->name);
+		return;
+	}
+
+	cxt->page_buf = kmalloc(mtd->writesize, GFP_KERNEL);
+	cxt->deflate.workspace = vmalloc(zlib_deflate_workspacesize());
+	if (!cxt->page_buf || !cxt->deflate.workspace)
+		goto err;
+
+	if (zlib_deflateInit(&cxt->deflate, Z_DEFAULT_COMPRESSION) != Z_OK)
+		goto err;
+
+	mutex_lock(&cxt->lock);
+	cxt->mtd = mtd;
+	cxt->ppb = mtd->erasesize / mtd->writesize;
+	cxt->nr_blocks = mtd->size / mtd->erasesize;
+	cxt->ready = 0;
+	mutex_unlock(&cxt->lock);
+
+	/* the scan is left to the work, off the probe path */
+	schedule_work(&cxt->work_flush);
+
+	printk(KERN_INFO "mtdlog: attached to \"%s\"\n", mtd->name);
+	return;
+
+ err:
+	printk(KERN_ERR "mtdlog: no memory for \"%s\"\n", mtd->name);
+	vfree(cxt->deflate.workspace);
+	kfree(cxt->page_buf);
+	cxt->deflate.workspace = NULL;
+	cxt->page_buf = NULL;
+}
+
+static void mtdlog_notify_remove(struct mtd_info *mtd)
+{
+	struct mtdlog_context *cxt = &mtdlog_cxt;
+
+	if (cxt->mtd != mtd)
+		return;
+
+	cancel_delayed_work_sync(&cxt->work_timer);
+	flush_scheduled_work();
+
+	mutex_lock(&cxt->lock);
+	cxt->mtd = NULL;
+	cxt->ready = 0;
+	zlib_deflateEnd(&cxt->deflate);
+	vfree(cxt->deflate.workspace);
+	kfree(cxt->page_buf);
+	cxt->deflate.workspace = NULL;
+	cxt->page_buf = NULL;
+	mutex_unlock(&cxt->lock);
+}
+
+static void mtdlog_console_write(struct console *co, const char *s,
+				 unsigned int count)
+{
+	mtdlog_stage(co->data, MTDLOG_TEXT, s, count);
+}
+
+static struct mtd_notifier mtdlog_notifier = {
+	.add	= mtdlog_notify_add,
+	.remove	= mtdlog_notify_remove,
+};
+
+/* enabled without console= so it sees everything, including the
+ * messages from before it was loaded */
+static struct console mtdlog_console = {
+	.name		= "mtdlog",
+	.write		= mtdlog_console_write,
+	.flags		= CON_ENABLED | CON_PRINTBUFFER,
+	.index		= -1,
+	.data		= &mtdlog_cxt,
+};
+
+static int mtdlog_proc_show_stats(char *page, char **start, off_t off,
+				  int count, int *eof, void *data)
+{
+	struct mtdlog_context *cxt = data;
+	int len;
+
+	len = sprintf(page, "device: %s\nboot: %u\nblock: %d\npage: %d\n"
+		      "pages written: %lu\nblocks erased: %lu\n"
+		      "bytes logged: %llu\nbytes written: %llu\n"
+		      "dropped: %lu\nerrors: %lu\n",
+		      cxt->mtd ? cxt->mtd->name : "-", cxt->boot,
+		      cxt->block, cxt->page, cxt->pages_written,
+		      cxt->blocks_erased, cxt->raw_bytes, cxt->flash_bytes,
+		      cxt->dropped, cxt->errors);
+
+	*eof = 1;
+	return len;
+}
+
+static int __init mtdlog_init(void)
+{
+	struct mtdlog_context *cxt = &mtdlog_cxt;
+
+	/* every block of the partition gets erased in turn */
+	if (!mtddev || !*mtddev) {
+		printk(KERN_ERR "mtdlog: mtddev= must name a partition "
+		       "of its own\n");
+		return -EINVAL;
+	}
+
+	mutex_init(&cxt->lock);
+	spin_lock_init(&cxt->stage_lock);
+	INIT_WORK(&cxt->work_flush, mtdlog_work_flush);
+	INIT_DELAYED_WORK(&cxt->work_timer, mtdlog_work_timer);
+
+	cxt->stage = vmalloc(MTDLOG_STAGE_SIZE);
+	cxt->flushing = vmalloc(MTDLOG_STAGE_SIZE);
+	if (!cxt->stage || !cxt->flushing) {
+		vfree(cxt->stage);
+		vfree(cxt->flushing);
+		cxt->stage = NULL;
+		printk(KERN_ERR "mtdlog: no memory for the staging buffers\n");
+		return -ENOMEM;
+	}
+
+	proc_create("mtdlog", S_IRUSR, NULL, &mtdlog_proc_fops);
+	create_proc_read_entry("mtdlog_stats", S_IRUGO, NULL,
+			       mtdlog_proc_show_stats, cxt);
+
+	register_mtd_user(&mtdlog_notifier);
+	register_console(&mtdlog_console);
+	return 0;
+}
+
+static void __exit mtdlog_exit(void)
+{
+	struct mtdlog_context *cxt = &mtdlog_cxt;
+
+	unregister_console(&mtdlog_console);
+
+	/* write out what is left */
+	cancel_delayed_work_sync(&cxt->work_timer);
+	mtdlog_flush(cxt);
+
+	unregister_mtd_user(&mtdlog_notifier);
+
+	remove_proc_entry("mtdlog_stats", NULL);
+	remove_proc_entry("mtdlog", NULL);
+
+	vfree(cxt->stage);
+	vfree(cxt->flushing);
+}
+
+module_init(mtdlog_init);
+module_exit(mtdlog_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Persistent compressed kernel log in an MTD partition");
@@ -291,29 +291,45 @@ static int nand_verify_buf16(struct mtd_info *mtd, const uint8_t *buf, int len)
 }
 
 #ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
-static int nand_translate_bad(struct nand_chip *chip, loff_t ofs)
+/**
+ * nand_bb_remap - [INTERN] Look up the spare block replacing a bad block
+ * @chip:	nand chip info structure
+ * @ofs:	offset from device start
+ *
+ * Returns the index of the spare block + 1, or 0 if the block is not
+ * remapped. The table is indexed by block, see nand_bbt.c.
+ */
+static inline unsigned int nand_bb_remap(struct nand_chip *chip, loff_t ofs)
 {
-	int block = (ofs >> chip->phys_erase_shift);
-	int i;
+	unsigned int block = ofs >> chip->phys_erase_shift;
+
+	if (!(chip->options & NAND_USE_DUMB_BB_TRANSLATION) || !chip->bb_remap)
+		return 0;
+
+	if (block >= chip->bb_remap_size)
+		return 0;
+
+	return chip->bb_remap[block];
+}
+
+static loff_t nand_translate_bad(struct nand_chip *chip, loff_t ofs)
+{
+	unsigned int spare = nand_bb_remap(chip, ofs);
 	loff_t ofs_res;
 
-	if (block == 0)
+	if (!spare)
 		return ofs;
 
-	if (chip->options & NAND_USE_DUMB_BB_TRANSLATION) {
-		for (i = 0; i < chip->bb_translation_table_size; i++) {
-			if (chip->bb_translation_table[i] == block) {
-				ofs_res = (i << chip->phys_erase_shift) +
-					(ofs - (block << chip->phys_erase_shift));
-				DEBUG(MTD_DEBUG_LEVEL2, "Translate 0x%08x to 0x%08x\n",
-						(unsigned int)ofs, (unsigned int)ofs_res);
-				return ofs_res;
-			}
-		}
-	}
-	DEBUG(MTD_DEBUG_LEVEL1, "%s: block %x not found in table\n",
-			__FUNCTION__, block);
-	return ofs;
+	spare--;
+	chip->bb_remap_hits[spare]++;
+
+	ofs_res = ((loff_t)spare << chip->phys_erase_shift) |
+		(ofs & ((1 << chip->phys_erase_shift) - 1));
+
+	DEBUG(MTD_DEBUG_LEVEL2, "Translate 0x%08x to 0x%08x\n",
+	      (unsigned int)ofs, (unsigned int)ofs_res);
+
+	return ofs_res;
 }
 #endif
 
@@ -440,7 +456,17 @@ static int nand_block_checkbad(struct mtd_info *mtd, loff_t ofs, int getchip,
 	/* Return info from the table */
 
 #ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
-	if (nand_isbad_bbt(mtd, ofs, allowbbt) && (nand_translate_bad(chip, ofs) == ofs))
+	/*
+	 * Spare blocks up to the end of the translation table hold the
+	 * data of remapped blocks, or are bad themselves. Anyone who
+	 * addresses them directly, through a partition over the spare
+	 * area, must leave them alone.
+	 */
+	if ((chip->options & NAND_USE_DUMB_BB_TRANSLATION) &&
+	    (ofs >> chip->phys_erase_shift) < chip->bb_translation_table_size)
+		return 1;
+
+	if (nand_isbad_bbt(mtd, ofs, allowbbt) && !nand_bb_remap(chip, ofs))
 		return 1;
 	else
 		return 0;
@@ -521,9 +547,7 @@ static void nand_command(struct mtd_info *mtd, unsigned int command,
 	}
 	if (page_addr != -1) {
 #ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
-		if ((chip->options & NAND_USE_DUMB_BB_TRANSLATION) &&
-				nand_isbad_bbt(mtd, page_addr << chip->page_shift, 1))
-			page_addr = nand_translate_bad(chip, page_addr << chip->page_shift) >> chip->page_shift;
+		page_addr = nand_translate_bad(chip, (loff_t)page_addr << chip->page_shift) >> chip->page_shift;
 #endif
 
 		chip->cmd_ctrl(mtd, page_addr, ctrl);
@@ -617,9 +641,7 @@ static void nand_command_lp(struct mtd_info *mtd, unsigned int command,
 		}
 		if (page_addr != -1) {
 #ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
-			if ((chip->options & NAND_USE_DUMB_BB_TRANSLATION) &&
-					nand_isbad_bbt(mtd, page_addr << chip->page_shift, 1))
-				page_addr = nand_translate_bad(chip, page_addr << chip->page_shift) >> chip->page_shift;
+			page_addr = nand_translate_bad(chip, (loff_t)page_addr << chip->page_shift) >> chip->page_shift;
 #endif
 			chip->cmd_ctrl(mtd, page_addr, ctrl);
 			chip->cmd_ctrl(mtd, page_addr >> 8,
@@ -1084,9 +1106,10 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 {
 	int chipnr, page, realpage, col, bytes, aligned;
 	struct nand_chip *chip = mtd->priv;
-	struct mtd_ecc_stats stats;
+	struct mtd_ecc_stats stats, pstats;
 	int blkcheck = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
 	int sndcmd = 1;
+	int cache = 0, more;
 	int ret = 0;
 	uint32_t readlen = ops->len;
 	uint32_t oobreadlen = ops->ooblen;
@@ -1109,25 +1132,55 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		bytes = min(mtd->writesize - col, readlen);
 		aligned = (bytes == mtd->writesize);
 
-		/* Is the current page in the buffer ? */
-		if (realpage != chip->pagebuf || oob) {
+		/*
+		 * Is the current page in the buffer ? Not taken during
+		 * a cache read, the chip has already started loading
+		 * this page and has to be moved on past it.
+		 */
+		if (realpage != chip->pagebuf || oob || cache) {
 			bufpoi = aligned ? buf : chip->buffers->databuf;
 
+			/*
+			 * Sequential reads within a block use cache read:
+			 * each READCACHESEQ moves the page just read from
+			 * the array to the cache register and starts on the
+			 * next one, so tR overlaps with the data transfer.
+			 * The last page of the run is fetched with
+			 * READCACHEEND, which starts no further array read.
+			 */
+			more = readlen > bytes && ((page + 1) & blkcheck);
+
 			if (likely(sndcmd)) {
 				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
 				sndcmd = 0;
+				cache = NAND_HAS_CACHEREAD(chip) && more;
+				if (cache)
+					chip->cmdfunc(mtd, NAND_CMD_READCACHESEQ,
+						      -1, -1);
+			} else if (cache) {
+				cache = more;
+				chip->cmdfunc(mtd, more ? NAND_CMD_READCACHESEQ :
+					      NAND_CMD_READCACHEEND, -1, -1);
 			}
 
+			pstats = mtd->ecc_stats;
+
 			/* Now read the page into the buffer */
 			if (unlikely(ops->mode == MTD_OOB_RAW))
 				ret = chip->ecc.read_page_raw(mtd, chip, bufpoi);
-			else if (!aligned && NAND_SUBPAGE_READ(chip) && !oob)
+			else if (!aligned && NAND_SUBPAGE_READ(chip) && !oob &&
+				 !cache)
 				ret = chip->ecc.read_subpage(mtd, chip, col, bytes, bufpoi);
 			else
 				ret = chip->ecc.read_page(mtd, chip, bufpoi);
 			if (ret < 0)
 				break;
 
+			if (likely(ops->mode != MTD_OOB_RAW))
+				nand_scrub_account(mtd, realpage,
+					mtd->ecc_stats.corrected - pstats.corrected,
+					mtd->ecc_stats.failed - pstats.failed);
+
 			/* Transfer not aligned data */
 			if (!aligned) {
 				if (!NAND_SUBPAGE_READ(chip) && !oob)
@@ -1191,10 +1244,14 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		/* Check, if the chip supports auto page increment
 		 * or if we have hit a block boundary.
 		 */
-		if (!NAND_CANAUTOINCR(chip) || !(page & blkcheck))
+		if (!cache && (!NAND_CANAUTOINCR(chip) || !(page & blkcheck)))
 			sndcmd = 1;
 	}
 
+	/* Do not leave the chip in the middle of a cache read */
+	if (cache)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+
 	ops->retlen = ops->len - (size_t) readlen;
 	if (oob)
 		ops->oobretlen = ops->ooblen - oobreadlen;
@@ -2174,6 +2231,8 @@ int nand_erase_nand(struct mtd_info *mtd, struct erase_info *instr,
 		    (page & BBT_PAGE_MASK) == bbt_masked_page)
 			    rewrite_bbt[chipnr] = (page << chip->page_shift);
 
+		nand_scrub_erased(mtd, page);
+
 		/* Increment page address and decrement length */
 		len -= (1 << chip->phys_erase_shift);
 		page += pages_per_block;
@@ -2494,6 +2553,15 @@ static struct nand_flash_dev *nand_get_flash_type(struct mtd_info *mtd,
 	if (mtd->writesize > 512 && chip->cmdfunc == nand_command)
 		chip->cmdfunc = nand_command_lp;
 
+	/*
+	 * Samsung large page chips which can cache program can also cache
+	 * read. It is checked against normal reads in nand_scan_tail()
+	 */
+	if ((chip->options & NAND_CACHEPRG) && !type->pagesize &&
+	    (chip->cellinfo & NAND_CI_CACHEPRG) &&
+	    chip->cmdfunc == nand_command_lp)
+		chip->options |= NAND_CACHERD;
+
 	printk(KERN_INFO "NAND device: Manufacturer ID:"
 	       " 0x%02x, Chip ID: 0x%02x (%s %s)\n", *maf_id, dev_id,
 	       nand_manuf_ids[maf_idx].name, type->name);
@@ -2552,6 +2620,125 @@ int nand_scan_ident(struct mtd_info *mtd, int maxchips)
 }
 
 
+/*
+ * Read consecutive pages of the chip raw, with or without cache read
+ */
+static void nand_read_pages_raw(struct mtd_info *mtd, uint8_t *buf,
+				int page, int pages, int cache)
+{
+	struct nand_chip *chip = mtd->priv;
+	int i;
+
+	chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+
+	for (i = 0; i < pages; i++) {
+		if (cache)
+			chip->cmdfunc(mtd, i < pages - 1 ?
+				      NAND_CMD_READCACHESEQ :
+				      NAND_CMD_READCACHEEND, -1, -1);
+		else if (i)
+			chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page + i);
+
+		chip->ecc.read_page_raw(mtd, chip, buf);
+		buf += mtd->writesize;
+		memcpy(buf, chip->oob_poi, mtd->oobsize);
+		buf += mtd->oobsize;
+	}
+}
+
+#define NAND_CACHERD_CHECK_PAGES	3
+#define NAND_CACHERD_CHECK_BLOCKS	16
+
+/*
+ * Check that all of the pages read by nand_read_pages_raw() have been
+ * written, and that no two of them match
+ */
+static int nand_pages_distinct(struct mtd_info *mtd, uint8_t *buf, int pages)
+{
+	int pagelen = mtd->writesize + mtd->oobsize;
+	int i, j;
+
+	for (i = 0; i < pages; i++) {
+		for (j = 0; j < mtd->writesize; j++)
+			if (buf[i * pagelen + j] != 0xff)
+				break;
+		if (j == mtd->writesize)
+			return 0;
+	}
+
+	for (i = 0; i < pages; i++)
+		for (j = i + 1; j < pages; j++)
+			if (!memcmp(buf + i * pagelen, buf + j * pagelen,
+				    mtd->writesize))
+				return 0;
+
+	return 1;
+}
+
+/**
+ * nand_check_cacheread - [Internal] verify that cache read works
+ * @mtd:	MTD device structure
+ *
+ * The ID bytes only promise cache program, so compare a few pages read
+ * with and without cache read before relying on it. A cache read which
+ * returns the wrong page only shows if the pages differ, so the first
+ * pages of the first few blocks are searched for written, distinct
+ * ones; the spare blocks of the bad block translation are skipped, as
+ * they are normally erased. If none are found cache read stays off.
+ */
+static void nand_check_cacheread(struct mtd_info *mtd)
+{
+	struct nand_chip *chip = mtd->priv;
+	int len = NAND_CACHERD_CHECK_PAGES * (mtd->writesize + mtd->oobsize);
+	int shift = chip->phys_erase_shift - chip->page_shift;
+	int block = 0, last;
+	uint8_t *buf;
+
+	if (!NAND_HAS_CACHEREAD(chip))
+		return;
+
+	buf = kmalloc(len * 2, GFP_KERNEL);
+	if (!buf) {
+		chip->options &= ~NAND_CACHERD;
+		return;
+	}
+
+#ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
+	block = chip->bb_spare_blocks;
+#endif
+	last = min_t(int, block + NAND_CACHERD_CHECK_BLOCKS,
+		     chip->chipsize >> chip->phys_erase_shift);
+
+	nand_get_device(chip, mtd, FL_READING);
+	chip->select_chip(mtd, 0);
+
+	for (; block < last; block++) {
+		nand_read_pages_raw(mtd, buf, block << shift,
+				    NAND_CACHERD_CHECK_PAGES, 0);
+		if (nand_pages_distinct(mtd, buf, NAND_CACHERD_CHECK_PAGES))
+			break;
+	}
+
+	if (block < last)
+		nand_read_pages_raw(mtd, buf + len, block << shift,
+				    NAND_CACHERD_CHECK_PAGES, 1);
+
+	nand_release_device(mtd);
+
+	if (block >= last) {
+		printk(KERN_INFO "NAND device: no written pages to check "
+		       "cache read on, disabled\n");
+		chip->options &= ~NAND_CACHERD;
+	} else if (memcmp(buf, buf + len, len)) {
+		printk(KERN_INFO "NAND device: cache read does not match, "
+		       "disabled\n");
+		chip->options &= ~NAND_CACHERD;
+	} else
+		printk(KERN_INFO "NAND device: using cache read\n");
+
+	kfree(buf);
+}
+
 /**
  * nand_scan_tail - [NAND Interface] Scan for the NAND device
  * @mtd:	    MTD device structure
@@ -2568,10 +2755,23 @@ int nand_scan_tail(struct mtd_info *mtd)
 
 #ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
 	if (chip->options & NAND_USE_DUMB_BB_TRANSLATION) {
-		chip->bb_translation_table = kzalloc(sizeof(*chip->bb_translation_table) * 
+		chip->bb_translation_table = kzalloc(sizeof(*chip->bb_translation_table) *
+				chip->bb_spare_blocks, GFP_KERNEL);
+		chip->bb_remap_hits = kzalloc(sizeof(*chip->bb_remap_hits) *
 				chip->bb_spare_blocks, GFP_KERNEL);
-		if (!chip->bb_translation_table)
+		chip->bb_remap_size = mtd->size >> chip->phys_erase_shift;
+		chip->bb_remap = kzalloc(sizeof(*chip->bb_remap) *
+				chip->bb_remap_size, GFP_KERNEL);
+		if (!chip->bb_translation_table || !chip->bb_remap_hits ||
+		    !chip->bb_remap) {
+			kfree(chip->bb_translation_table);
+			kfree(chip->bb_remap_hits);
+			kfree(chip->bb_remap);
+			chip->bb_translation_table = NULL;
+			chip->bb_remap_hits = NULL;
+			chip->bb_remap = NULL;
 			return -ENOMEM;
+		}
 	}
 #endif
 
@@ -2754,6 +2954,10 @@ int nand_scan_tail(struct mtd_info *mtd)
 	/* propagate ecc.layout to mtd_info */
 	mtd->ecclayout = chip->ecc.layout;
 
+	nand_check_cacheread(mtd);
+
+	nand_scrub_init(mtd);
+
 	/* Check, if we should skip the bad block table scan */
 	if (chip->options & NAND_SKIP_BBTSCAN)
 		return 0;
@@ -2820,9 +3024,11 @@ void nand_release(struct mtd_info *mtd)
 	if (!(chip->options & NAND_OWN_BUFFERS))
 		kfree(chip->buffers);
 #ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
-	if (!chip->bb_translation_table)
-		kfree(chip->bb_translation_table);
+	kfree(chip->bb_translation_table);
+	kfree(chip->bb_remap_hits);
+	kfree(chip->bb_remap);
 #endif
+	nand_scrub_release(mtd);
 }
 
 EXPORT_SYMBOL_GPL(nand_scan);
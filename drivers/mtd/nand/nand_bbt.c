@@ -365,6 +365,10 @@ static void nand_bbt_add_to_translation_table(struct mtd_info *mtd, int block)
 		return;
 	}
 
+	/* left bad, for a flash layer which handles bad blocks itself */
+	if (this->bb_translate_limit && block >= this->bb_translate_limit)
+		return;
+
 	if (this->bb_translation_table_size == this->bb_spare_blocks) {
 		printk(KERN_ERR "Badblock translation table is full (%d blocks)!\n", this->bb_spare_blocks);
 		return;
@@ -384,7 +388,50 @@ static void nand_bbt_add_to_translation_table(struct mtd_info *mtd, int block)
 			this->bb_translation_table_size);
 	this->bb_translation_table_size++;
 
+	/* the reverse map is what the I/O path uses, it holds the spare
+	 * block index + 1 so that zero means not remapped */
+	if (block < this->bb_remap_size)
+		this->bb_remap[block] = this->bb_translation_table_size;
+}
+
+/**
+ * nand_bbt_show_translation - [NAND Interface] Describe the bad block remaps
+ * @mtd:	MTD device structure
+ * @buf:	buffer to fill, as for a sysfs show method
+ * @size:	space left in @buf
+ *
+ * Prints one line per remapped block, giving the bad block, the spare
+ * block which replaces it and the number of accesses translated so far.
+ * Returns the number of characters written, not counting the trailing
+ * null, which is less than @size.
+ */
+ssize_t nand_bbt_show_translation(struct mtd_info *mtd, char *buf,
+				  size_t size)
+{
+	struct nand_chip *this = mtd->priv;
+	ssize_t len = 0;
+	int i;
+
+	if (!(this->options & NAND_USE_DUMB_BB_TRANSLATION) ||
+	    !this->bb_translation_table)
+		return 0;
+
+	for (i = 0; i < this->bb_translation_table_size; i++) {
+		unsigned int block = this->bb_translation_table[i];
+
+		if (block == 0)
+			continue;
+
+		len += scnprintf(buf + len, size - len,
+				 "%s: 0x%x -> 0x%x %lu\n", mtd->name, block, i,
+				 this->bb_remap_hits[i]);
+		if (len >= size - 1)
+			break;
+	}
+
+	return len;
 }
+EXPORT_SYMBOL(nand_bbt_show_translation);
 #endif
 
 /**
@@ -0,0 +1,480 @@
+/*
+ * This file contains a binary BCH code that detects and corrects up to
+ * t bit errors in a block of NAND data.
+ *
+ * drivers/mtd/nand/nand_bch.c
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The code is a shortened, systematic BCH code over GF(2^m). The ECC is
+ * the remainder of the data polynomial, multiplied by x^deg(g), divided
+ * by the generator polynomial g(x). The remainder is at most 56 bits,
+ * so it is kept in a u64 and computed a byte at a time through a 256
+ * entry table, which costs a shift, a mask and two XORs per data byte.
+ *
+ * On reading, the remainder of the data as read is XORed with the ECC
+ * as read. This is the remainder of the error polynomial, and zero for
+ * the (common) error free case. Otherwise the 2t syndromes are found
+ * from the at most 56 set bits of it, the error locator polynomial by
+ * Berlekamp-Massey and its roots by a Chien search over the shortened
+ * codeword only.
+ *
+ * The ECC is stored inverted against that of an all 0xff block, so that
+ * an erased block reads as valid with an all 0xff ECC.
+ */
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/mtd/nand_bch.h>
+
+/* primitive polynomials for GF(2^m), m = 5 ... 15 */
+static const unsigned int nand_bch_prim_poly[] = {
+	0x25, 0x43, 0x83, 0x11d, 0x211, 0x409, 0x805, 0x1053, 0x201b,
+	0x402b, 0x8003,
+};
+
+#define NAND_BCH_MIN_M		5
+#define NAND_BCH_MAX_M		15
+
+/* the remainder, and one more data byte, must fit in a u64 */
+#define NAND_BCH_MAX_ECCBITS	56
+
+struct nand_bch_control {
+	unsigned int	m;
+	unsigned int	n;		/* 2^m - 1 */
+	unsigned int	t;
+	unsigned int	eccsize;	/* data bytes per codeword */
+	unsigned int	eccbits;	/* degree of the generator */
+	unsigned int	eccbytes;
+	uint64_t	mask;
+	uint64_t	ecc_ff;		/* remainder of an all 0xff block */
+	uint16_t	*alpha_to;
+	uint16_t	*index_of;
+	uint64_t	mod_tab[256];
+};
+
+static inline unsigned int gf_mod(struct nand_bch_control *bch,
+				  unsigned int v)
+{
+	while (v >= bch->n)
+		v -= bch->n;
+	return v;
+}
+
+static inline unsigned int gf_mul(struct nand_bch_control *bch,
+				  unsigned int a, unsigned int b)
+{
+	if (a == 0 || b == 0)
+		return 0;
+
+	return bch->alpha_to[gf_mod(bch, bch->index_of[a] + bch->index_of[b])];
+}
+
+static inline unsigned int gf_div(struct nand_bch_control *bch,
+				  unsigned int a, unsigned int b)
+{
+	if (a == 0)
+		return 0;
+
+	return bch->alpha_to[gf_mod(bch, bch->index_of[a] + bch->n -
+				    bch->index_of[b])];
+}
+
+static uint64_t nand_bch_remainder(struct nand_bch_control *bch,
+				   const u_char *dat)
+{
+	unsigned int shift = bch->eccbits - 8;
+	uint64_t r = 0;
+	int i;
+
+	for (i = 0; i < bch->eccsize; i++)
+		r = ((r << 8) & bch->mask) ^
+			bch->mod_tab[((unsigned int)(r >> shift) ^ dat[i]) & 0xff];
+
+	return r;
+}
+
+/* the remainder is stored MSB first, padded at the end with ones */
+
+static void nand_bch_pack(struct nand_bch_control *bch, uint64_t r,
+			  u_char *ecc_code)
+{
+	unsigned int pad = bch->eccbytes * 8 - bch->eccbits;
+	int i;
+
+	r = (r << pad) | ((1ULL << pad) - 1);
+
+	for (i = bch->eccbytes - 1; i >= 0; i--, r >>= 8)
+		ecc_code[i] = r & 0xff;
+}
+
+static uint64_t nand_bch_unpack(struct nand_bch_control *bch,
+				const u_char *ecc_code)
+{
+	unsigned int pad = bch->eccbytes * 8 - bch->eccbits;
+	uint64_t r = 0;
+	int i;
+
+	for (i = 0; i < bch->eccbytes; i++)
+		r = (r << 8) | ecc_code[i];
+
+	return r >> pad;
+}
+
+/**
+ * nand_bch_calculate_ecc - [NAND Interface] Calculate BCH ECC for a block
+ * @bch:	BCH control structure
+ * @dat:	eccsize bytes of data
+ * @ecc_code:	buffer for the nand_bch_eccbytes() bytes of ECC
+ */
+void nand_bch_calculate_ecc(struct nand_bch_control *bch, const u_char *dat,
+			    u_char *ecc_code)
+{
+	uint64_t r = nand_bch_remainder(bch, dat);
+
+	nand_bch_pack(bch, r ^ bch->ecc_ff ^ bch->mask, ecc_code);
+}
+EXPORT_SYMBOL(nand_bch_calculate_ecc);
+
+/* nand_bch_locate
+ *
+ * find the error locator polynomial from the syndromes of the error
+ * remainder, and return its degree (the number of errors) or -1
+*/
+
+static int nand_bch_locate(struct nand_bch_control *bch, uint64_t err,
+			   unsigned int *elp)
+{
+	unsigned int syn[2 * NAND_BCH_MAX_T + 1];
+	unsigned int prev[2 * NAND_BCH_MAX_T + 1];
+	unsigned int tmp[2 * NAND_BCH_MAX_T + 1];
+	unsigned int t2 = 2 * bch->t;
+	unsigned int b = 1;
+	unsigned int d, coef;
+	int l = 0, step = 1;
+	int i, j, k;
+
+	/* S(j) = e(a^j), the even ones being the squares of S(j/2) */
+
+	memset(syn, 0, sizeof(syn));
+
+	for (i = 0; err; i++, err >>= 1) {
+		if (!(err & 1))
+			continue;
+
+		for (j = 1; j <= t2; j += 2)
+			syn[j] ^= bch->alpha_to[(i * j) % bch->n];
+	}
+
+	for (j = 2; j <= t2; j += 2)
+		syn[j] = gf_mul(bch, syn[j / 2], syn[j / 2]);
+
+	/* Berlekamp-Massey */
+
+	memset(elp, 0, sizeof(unsigned int) * (t2 + 1));
+	memset(prev, 0, sizeof(prev));
+	elp[0] = 1;
+	prev[0] = 1;
+
+	for (k = 0; k < t2; k++) {
+		d = syn[k + 1];
+		for (i = 1; i <= l; i++)
+			d ^= gf_mul(bch, elp[i], syn[k + 1 - i]);
+
+		if (d == 0) {
+			step++;
+			continue;
+		}
+
+		coef = gf_div(bch, d, b);
+
+		if (2 * l <= k) {
+			memcpy(tmp, elp, sizeof(unsigned int) * (t2 + 1));
+
+			for (i = 0; i + step <= t2; i++)
+				elp[i + step] ^= gf_mul(bch, coef, prev[i]);
+
+			l = k + 1 - l;
+			memcpy(prev, tmp, sizeof(unsigned int) * (t2 + 1));
+			b = d;
+			step = 1;
+		} else {
+			for (i = 0; i + step <= t2; i++)
+				elp[i + step] ^= gf_mul(bch, coef, prev[i]);
+
+			step++;
+		}
+	}
+
+	if (l > bch->t)
+		return -1;
+
+	for (i = l + 1; i <= t2; i++)
+		if (elp[i])
+			return -1;
+
+	return l;
+}
+
+/**
+ * nand_bch_correct_data - [NAND Interface] Detect and correct bit errors
+ * @bch:	BCH control structure
+ * @dat:	eccsize bytes of data, as read
+ * @read_ecc:	ECC bytes, as read
+ *
+ * Returns the number of bits corrected, in the data or the ECC, or -1
+ * if the block cannot be corrected.
+ */
+int nand_bch_correct_data(struct nand_bch_control *bch, u_char *dat,
+			  const u_char *read_ecc)
+{
+	unsigned int elp[2 * NAND_BCH_MAX_T + 1];
+	unsigned int lg[NAND_BCH_MAX_T + 1];
+	unsigned int pos[NAND_BCH_MAX_T];
+	unsigned int nbits = bch->eccsize * 8 + bch->eccbits;
+	unsigned int i, v;
+	uint64_t err;
+	int nerr, found = 0;
+	int j;
+
+	err = nand_bch_unpack(bch, read_ecc) ^ bch->ecc_ff ^ bch->mask;
+	err ^= nand_bch_remainder(bch, dat);
+
+	if (err == 0)
+		return 0;
+
+	nerr = nand_bch_locate(bch, err, elp);
+	if (nerr <= 0)
+		return -1;
+
+	/* Chien search: bit i of the codeword is in error if elp(a^-i)
+	 * is zero. The terms are stepped along in the log domain. */
+
+	for (j = 1; j <= nerr; j++)
+		lg[j] = elp[j] ? bch->index_of[elp[j]] : 0;
+
+	for (i = 0; i < nbits && found < nerr; i++) {
+		v = elp[0];
+
+		for (j = 1; j <= nerr; j++) {
+			if (!elp[j])
+				continue;
+
+			v ^= bch->alpha_to[lg[j]];
+			lg[j] = gf_mod(bch, lg[j] + bch->n - j);
+		}
+
+		if (v == 0)
+			pos[found++] = i;
+	}
+
+	if (found != nerr)
+		return -1;
+
+	/* the lowest eccbits bits are the ECC itself, the data follows
+	 * with the last byte's least significant bit first */
+
+	for (j = 0; j < found; j++) {
+		if (pos[j] < bch->eccbits)
+			continue;
+
+		i = pos[j] - bch->eccbits;
+		dat[bch->eccsize - 1 - i / 8] ^= 1 << (i % 8);
+	}
+
+	return found;
+}
+EXPORT_SYMBOL(nand_bch_correct_data);
+
+unsigned int nand_bch_eccbytes(struct nand_bch_control *bch)
+{
+	return bch->eccbytes;
+}
+EXPORT_SYMBOL(nand_bch_eccbytes);
+
+/* nand_bch_build_gf
+ *
+ * build the log and antilog tables for GF(2^m)
+*/
+
+static void nand_bch_build_gf(struct nand_bch_control *bch)
+{
+	unsigned int poly = nand_bch_prim_poly[bch->m - NAND_BCH_MIN_M];
+	unsigned int x = 1;
+	int i;
+
+	for (i = 0; i < bch->n; i++) {
+		bch->alpha_to[i] = x;
+		bch->index_of[x] = i;
+
+		x <<= 1;
+		if (x & (1 << bch->m))
+			x ^= poly;
+	}
+
+	bch->alpha_to[bch->n] = 1;
+	bch->index_of[0] = 0;
+}
+
+/* nand_bch_build_generator
+ *
+ * g(x) is the product of the minimal polynomials of a^1, a^3 ...
+ * a^(2t-1). Each minimal polynomial is the product of (x + a^c) over
+ * the cyclotomic coset of its root, and has binary coefficients.
+*/
+
+static int nand_bch_build_generator(struct nand_bch_control *bch,
+				    uint64_t *genp)
+{
+	unsigned int mpoly[NAND_BCH_MAX_M + 1];
+	unsigned long *done;
+	uint64_t gen = 1, prod, mbits;
+	unsigned int deg = 0;
+	unsigned int c, i, j, len;
+	int k;
+
+	done = kzalloc(BITS_TO_LONGS(bch->n) * sizeof(long), GFP_KERNEL);
+	if (done == NULL)
+		return -ENOMEM;
+
+	for (j = 1; j < 2 * bch->t; j += 2) {
+		if (test_bit(j, done))
+			continue;
+
+		memset(mpoly, 0, sizeof(mpoly));
+		mpoly[0] = 1;
+		len = 0;
+
+		c = j;
+		do {
+			set_bit(c, done);
+
+			/* mpoly *= (x + a^c) */
+			for (k = len + 1; k > 0; k--)
+				mpoly[k] = mpoly[k - 1] ^
+					gf_mul(bch, mpoly[k], bch->alpha_to[c]);
+			mpoly[0] = gf_mul(bch, mpoly[0], bch->alpha_to[c]);
+			len++;
+
+			c = gf_mod(bch, c * 2);
+		} while (c != j);
+
+		mbits = 0;
+		for (i = 0; i <= len; i++)
+			if (mpoly[i])
+				mbits |= 1ULL << i;
+
+		deg += len;
+		if (deg > NAND_BCH_MAX_ECCBITS) {
+			kfree(done);
+			return -EINVAL;
+		}
+
+		/* gen *= mbits, over GF(2) */
+		prod = 0;
+		for (i = 0; i <= len; i++)
+			if (mbits & (1ULL << i))
+				prod ^= gen << i;
+		gen = prod;
+	}
+
+	kfree(done);
+
+	*genp = gen;
+	return deg;
+}
+
+/**
+ * nand_bch_init - [NAND Interface] Set up a BCH code
+ * @m:		Galois field order, the codeword can be up to 2^m - 1 bits
+ * @t:		number of bit errors to correct
+ * @eccsize:	data bytes covered by each ECC
+ *
+ * m * t must not be more than 56. For instance m = 13, t = 4 corrects 4
+ * bits in each 512 bytes with 7 bytes of ECC.
+ */
+struct nand_bch_control *nand_bch_init(unsigned int m, unsigned int t,
+				       unsigned int eccsize)
+{
+	struct nand_bch_control *bch;
+	uint64_t gen, r;
+	unsigned int i, b;
+	int deg;
+	u_char *ff;
+
+	if (m < NAND_BCH_MIN_M || m > NAND_BCH_MAX_M ||
+	    t == 0 || t > NAND_BCH_MAX_T)
+		return NULL;
+
+	if (eccsize * 8 + m * t > (1 << m) - 1)
+		return NULL;
+
+	bch = kzalloc(sizeof(*bch), GFP_KERNEL);
+	if (bch == NULL)
+		return NULL;
+
+	bch->m = m;
+	bch->n = (1 << m) - 1;
+	bch->t = t;
+	bch->eccsize = eccsize;
+
+	bch->alpha_to = kmalloc(sizeof(uint16_t) * (bch->n + 1), GFP_KERNEL);
+	bch->index_of = kmalloc(sizeof(uint16_t) * (bch->n + 1), GFP_KERNEL);
+	if (bch->alpha_to == NULL || bch->index_of == NULL)
+		goto err;
+
+	nand_bch_build_gf(bch);
+
+	deg = nand_bch_build_generator(bch, &gen);
+	if (deg < 8)
+		goto err;
+
+	bch->eccbits = deg;
+	bch->eccbytes = (deg + 7) / 8;
+	bch->mask = (1ULL << deg) - 1;
+
+	/* mod_tab[i] = i(x) * x^deg mod g(x) */
+
+	for (i = 0; i < 256; i++) {
+		r = (uint64_t)i << deg;
+
+		for (b = deg + 7; b >= deg; b--)
+			if (r & (1ULL << b))
+				r ^= gen << (b - deg);
+
+		bch->mod_tab[i] = r;
+	}
+
+	ff = kmalloc(eccsize, GFP_KERNEL);
+	if (ff == NULL)
+		goto err;
+
+	memset(ff, 0xff, eccsize);
+	bch->ecc_ff = nand_bch_remainder(bch, ff);
+	kfree(ff);
+
+	return bch;
+
+ err:
+	nand_bch_free(bch);
+	return NULL;
+}
+EXPORT_SYMBOL(nand_bch_init);
+
+void nand_bch_free(struct nand_bch_control *bch)
+{
+	if (bch) {
+		kfree(bch->alpha_to);
+		kfree(bch->index_of);
+		kfree(bch);
+	}
+}
+EXPORT_SYMBOL(nand_bch_free);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Binary BCH ECC for NAND flash");
@@ -0,0 +1,279 @@
+/*
+ *  drivers/mtd/nand/nand_scrub.c
+ *
+ *  Per eraseblock read statistics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Every page read through nand_do_read_ops() is accounted to its
+ * eraseblock: the number of reads, the most bits the ECC had to correct
+ * in a single page read, the total it corrected and the number of ECC
+ * steps which could not be corrected, all since the block was last
+ * erased.
+ *
+ * Nothing is rewritten here. Moving the data of a block with too many
+ * bit flips out of the way needs somewhere free to put it, which only
+ * the flash layer above knows about; reads which needed correction
+ * already return -EUCLEAN for it, which is what UBI scrubs on. A block
+ * whose worst page read reaches warn_threshold corrected bits is only
+ * reported, once per erase.
+ *
+ * The counters are in debugfs, as nand/nandN/blocks.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/err.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/nand.h>
+
+static unsigned int warn_threshold = 4;
+module_param(warn_threshold, uint, 0644);
+MODULE_PARM_DESC(warn_threshold, "Bits corrected in a single page read "
+		 "after which an eraseblock is reported, 0 to never report");
+
+struct nand_blkstat {
+	uint32_t		reads;
+	uint16_t		corrected;
+	uint8_t			worst;
+	uint8_t			failed:7,
+				warned:1;
+};
+
+struct nand_scrub {
+	struct mtd_info		*mtd;
+	struct nand_blkstat	*stats;
+	unsigned int		nr_blocks;
+
+	struct dentry		*dir;
+	struct dentry		*blocks;
+};
+
+static struct dentry *nand_scrub_root;
+static int nand_scrub_users;
+static atomic_t nand_scrub_count = ATOMIC_INIT(0);
+
+static inline int nand_scrub_page_to_block(struct nand_chip *chip, int page)
+{
+	return page >> (chip->phys_erase_shift - chip->page_shift);
+}
+
+/**
+ * nand_scrub_account - account a page read to its eraseblock
+ * @mtd:	MTD device structure
+ * @page:	page number, from the start of the device
+ * @corrected:	bits the ECC corrected in the page
+ * @failed:	ECC steps which could not be corrected
+ *
+ * Called with the chip held, once per page read.
+ */
+void nand_scrub_account(struct mtd_info *mtd, int page,
+			unsigned int corrected, unsigned int failed)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct nand_scrub *scrub = chip->scrub;
+	struct nand_blkstat *st;
+	int block;
+
+	if (!scrub)
+		return;
+
+	block = nand_scrub_page_to_block(chip, page);
+	st = &scrub->stats[block];
+
+	st->reads++;
+
+	if (likely(!corrected && !failed))
+		return;
+
+	st->corrected = min_t(unsigned int, st->corrected + corrected, 0xffff);
+	st->failed = min_t(unsigned int, st->failed + failed, 0x7f);
+
+	/*
+	 * One stuck bit is corrected on every read of its page, so the
+	 * sum says more about how often the page is read than about how
+	 * close it is to failing; only the worst single read counts.
+	 */
+	if (corrected > st->worst)
+		st->worst = min_t(unsigned int, corrected, 0xff);
+
+	if (!warn_threshold || st->warned ||
+	    (st->worst < warn_threshold && !st->failed))
+		return;
+
+	st->warned = 1;
+	printk(KERN_NOTICE "%s: block %d at 0x%08x needs scrubbing, "
+	       "%u bits corrected in one read, %u uncorrectable\n",
+	       mtd->name, block, block << chip->phys_erase_shift,
+	       st->worst, st->failed);
+}
+
+/**
+ * nand_scrub_erased - reset the counters of an erased block
+ * @mtd:	MTD device structure
+ * @page:	first page of the block
+ *
+ * Called with the chip held.
+ */
+void nand_scrub_erased(struct mtd_info *mtd, int page)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct nand_scrub *scrub = chip->scrub;
+	struct nand_blkstat *st;
+	int block;
+
+	if (!scrub)
+		return;
+
+	block = nand_scrub_page_to_block(chip, page);
+	st = &scrub->stats[block];
+
+	memset(st, 0, sizeof(*st));
+}
+
+static int nand_scrub_blocks_show(struct seq_file *m, void *v)
+{
+	struct nand_scrub *scrub = m->private;
+	struct mtd_info *mtd = scrub->mtd;
+	struct nand_blkstat *st;
+	unsigned long reads = 0, corrected = 0, failed = 0, worn = 0;
+	int block;
+
+	for (block = 0; block < scrub->nr_blocks; block++) {
+		st = &scrub->stats[block];
+		reads += st->reads;
+		corrected += st->corrected;
+		failed += st->failed;
+		worn += st->warned;
+	}
+
+	seq_printf(m, "reads: %lu\ncorrected: %lu\nfailed: %lu\n",
+		   reads, corrected, failed);
+	seq_printf(m, "over threshold: %lu\nthreshold: %u\n\n",
+		   worn, warn_threshold);
+	seq_printf(m, "block offset     reads      corrected worst failed\n");
+
+	for (block = 0; block < scrub->nr_blocks; block++) {
+		st = &scrub->stats[block];
+
+		if (!st->reads && !st->corrected && !st->failed)
+			continue;
+
+		seq_printf(m, "%5d 0x%08x %10u %9u %5u %6u\n", block,
+			   block * mtd->erasesize, st->reads,
+			   st->corrected, st->worst, st->failed);
+	}
+
+	return 0;
+}
+
+static int nand_scrub_blocks_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nand_scrub_blocks_show, inode->i_private);
+}
+
+static const struct file_operations nand_scrub_blocks_fops = {
+	.owner		= THIS_MODULE,
+	.open		= nand_scrub_blocks_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void nand_scrub_debugfs_init(struct nand_scrub *scrub)
+{
+	char name[16];
+
+	if (!nand_scrub_root) {
+		nand_scrub_root = debugfs_create_dir("nand", NULL);
+		if (IS_ERR(nand_scrub_root))
+			nand_scrub_root = NULL;
+		if (!nand_scrub_root)
+			return;
+	}
+
+	snprintf(name, sizeof(name), "nand%d",
+		 atomic_inc_return(&nand_scrub_count) - 1);
+
+	scrub->dir = debugfs_create_dir(name, nand_scrub_root);
+	if (IS_ERR(scrub->dir))
+		scrub->dir = NULL;
+	if (!scrub->dir)
+		return;
+
+	nand_scrub_users++;
+
+	scrub->blocks = debugfs_create_file("blocks", S_IRUGO, scrub->dir,
+					    scrub, &nand_scrub_blocks_fops);
+	if (IS_ERR(scrub->blocks))
+		scrub->blocks = NULL;
+}
+
+/**
+ * nand_scrub_init - set up the statistics for a chip
+ * @mtd:	MTD device structure
+ *
+ * Called from nand_scan_tail(). Failing here only loses the statistics,
+ * so the chip is still usable.
+ */
+void nand_scrub_init(struct mtd_info *mtd)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct nand_scrub *scrub;
+
+	scrub = kzalloc(sizeof(*scrub), GFP_KERNEL);
+	if (!scrub)
+		goto err;
+
+	scrub->mtd = mtd;
+	scrub->nr_blocks = mtd->size >> chip->phys_erase_shift;
+
+	scrub->stats = vmalloc(scrub->nr_blocks * sizeof(*scrub->stats));
+	if (!scrub->stats)
+		goto err_free;
+
+	memset(scrub->stats, 0, scrub->nr_blocks * sizeof(*scrub->stats));
+
+	nand_scrub_debugfs_init(scrub);
+	chip->scrub = scrub;
+	return;
+
+ err_free:
+	kfree(scrub);
+ err:
+	printk(KERN_WARNING "%s: no read statistics\n", mtd->name);
+}
+
+/**
+ * nand_scrub_release - free the statistics
+ * @mtd:	MTD device structure
+ */
+void nand_scrub_release(struct mtd_info *mtd)
+{
+	struct nand_chip *chip = mtd->priv;
+	struct nand_scrub *scrub = chip->scrub;
+
+	if (!scrub)
+		return;
+
+	if (scrub->dir) {
+		debugfs_remove(scrub->blocks);
+		debugfs_remove(scrub->dir);
+
+		if (--nand_scrub_users == 0) {
+			debugfs_remove(nand_scrub_root);
+			nand_scrub_root = NULL;
+		}
+	}
+
+	chip->scrub = NULL;
+
+	vfree(scrub->stats);
+	kfree(scrub);
+}
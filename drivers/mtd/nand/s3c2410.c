@@ -37,10 +37,14 @@
 #include <linux/slab.h>
 #include <linux/clk.h>
 #include <linux/cpufreq.h>
+#include <linux/completion.h>
+#include <linux/dma-mapping.h>
+#include <linux/moduleparam.h>
 
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/nand.h>
 #include <linux/mtd/nand_ecc.h>
+#include <linux/mtd/nand_bch.h>
 #include <linux/mtd/partitions.h>
 
 #include <asm/io.h>
@@ -48,6 +52,11 @@
 #include <asm/plat-s3c/regs-nand.h>
 #include <asm/plat-s3c/nand.h>
 
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+#include <asm/dma.h>
+#include <mach/dma.h>
+#endif
+
 #ifdef CONFIG_MTD_NAND_S3C2410_HWECC
 static int hardware_ecc = 1;
 #else
@@ -60,6 +69,21 @@ static int clock_stop = 1;
 static const int clock_stop = 0;
 #endif
 
+static int auto_timing = 1;
+module_param(auto_timing, bool, 0444);
+MODULE_PARM_DESC(auto_timing, "Use the faster timings for known chips");
+
+static int verify_timing = 1;
+module_param(verify_timing, bool, 0444);
+MODULE_PARM_DESC(verify_timing, "Read back pages at the faster timings "
+		 "before using them");
+
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+static int dma_min = 64;
+module_param(dma_min, int, 0644);
+MODULE_PARM_DESC(dma_min, "Smallest transfer in bytes to be done by DMA");
+#endif
+
 
 /* new oob placement block for use with hardware ecc generation
  */
@@ -78,6 +102,26 @@ static struct nand_ecclayout nand_hw_eccoob = {
 };
 #endif
 
+#ifdef CONFIG_MTD_NAND_S3C2410_BCH
+/* The hardware ECC is still written where the bootloader expects it,
+ * and the BCH ECC for each 512 byte step follows the free bytes. */
+
+#define S3C2410_BCH_M		13
+#define S3C2410_BCH_T		4
+#define S3C2410_BCH_SIZE	512
+#define S3C2410_BCH_HWBYTES	3
+
+static struct nand_ecclayout nand_bch_eccoob = {
+	.eccbytes = 31,
+	.eccpos = {2, 3, 4,
+		   16, 17, 18, 19, 20, 21, 22,
+		   23, 24, 25, 26, 27, 28, 29,
+		   30, 31, 32, 33, 34, 35, 36,
+		   37, 38, 39, 40, 41, 42, 43},
+	.oobfree = { {6, 10} }
+};
+#endif
+
 /* controller and mtd information */
 
 struct s3c2410_nand_info;
@@ -88,6 +132,32 @@ struct s3c2410_nand_mtd {
 	struct s3c2410_nand_set		*set;
 	struct s3c2410_nand_info	*info;
 	int				scan_res;
+
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+	/* where the current data transfer started, to restart it if
+	 * a DMA fails part way through */
+	void		(*cmdfunc)(struct mtd_info *mtd, unsigned command,
+				   int column, int page_addr);
+	int		(*waitfunc)(struct mtd_info *mtd,
+				    struct nand_chip *this);
+	void		(*hwctl)(struct mtd_info *mtd, int mode);
+	int		cmd;
+	int		column;
+	int		page;
+	int		xfer;
+	int		ecc_at;
+	int		ecc_mode;
+	int		read_failed;
+	int		write_failed;
+#endif
+};
+
+/* controller timings, either in nanoseconds or in clocks */
+
+struct s3c2410_nand_rate {
+	int	tacls;
+	int	twrph0;
+	int	twrph1;
 };
 
 enum s3c_cpu_type {
@@ -114,9 +184,24 @@ struct s3c2410_nand_info {
 	int				mtd_count;
 	unsigned long			save_sel;
 	unsigned long			clk_rate;
+	unsigned long			data_phys;
 
 	enum s3c_cpu_type		cpu_type;
 
+	struct s3c2410_nand_rate	timing;
+	struct s3c2410_nand_rate	clocks;
+	const char			*timing_src;
+
+#ifdef CONFIG_MTD_NAND_S3C2410_BCH
+	struct nand_bch_control		*bch;
+#endif
+
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+	int				dma_ok;
+	enum s3c2410_dma_buffresult	dma_result;
+	struct completion		dma_done;
+#endif
+
 #ifdef CONFIG_CPU_FREQ
 	struct notifier_block	freq_transition;
 #endif
@@ -144,6 +229,17 @@ static struct s3c2410_platform_nand *to_nand_plat(struct platform_device *dev)
 	return dev->dev.platform_data;
 }
 
+/* a DMA read failed in a way which could not be restarted */
+
+static inline int s3c2410_nand_dma_failed(struct mtd_info *mtd)
+{
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+	return s3c2410_nand_mtd_toours(mtd)->read_failed;
+#else
+	return 0;
+#endif
+}
+
 static inline int allow_clk_stop(struct s3c2410_nand_info *info)
 {
 	return clock_stop;
@@ -192,9 +288,9 @@ static int s3c2410_nand_setrate(struct s3c2410_nand_info *info)
 	clkrate /= 1000;	/* turn clock into kHz for ease of use */
 
 	if (plat != NULL) {
-		tacls = s3c_nand_calc_rate(plat->tacls, clkrate, tacls_max);
-		twrph0 = s3c_nand_calc_rate(plat->twrph0, clkrate, 8);
-		twrph1 = s3c_nand_calc_rate(plat->twrph1, clkrate, 8);
+		tacls = s3c_nand_calc_rate(info->timing.tacls, clkrate, tacls_max);
+		twrph0 = s3c_nand_calc_rate(info->timing.twrph0, clkrate, 8);
+		twrph1 = s3c_nand_calc_rate(info->timing.twrph1, clkrate, 8);
 	} else {
 		/* default timings */
 		tacls = tacls_max;
@@ -210,6 +306,10 @@ static int s3c2410_nand_setrate(struct s3c2410_nand_info *info)
 	dev_info(info->device, "Tacls=%d, %dns Twrph0=%d %dns, Twrph1=%d %dns\n",
 	       tacls, to_ns(tacls, clkrate), twrph0, to_ns(twrph0, clkrate), twrph1, to_ns(twrph1, clkrate));
 
+	info->clocks.tacls = tacls;
+	info->clocks.twrph0 = twrph0;
+	info->clocks.twrph1 = twrph1;
+
 	switch (info->cpu_type) {
 	case TYPE_S3C2410:
 		mask = (S3C2410_NFCONF_TACLS(3) |
@@ -384,6 +484,9 @@ static int s3c2410_nand_correct_data(struct mtd_info *mtd, u_char *dat,
 
 	pr_debug("%s(%p,%p,%p,%p)\n", __func__, mtd, dat, read_ecc, calc_ecc);
 
+	if (s3c2410_nand_dma_failed(mtd))
+		return -1;
+
 	diff0 = read_ecc[0] ^ calc_ecc[0];
 	diff1 = read_ecc[1] ^ calc_ecc[1];
 	diff2 = read_ecc[2] ^ calc_ecc[2];
@@ -449,6 +552,150 @@ static int s3c2410_nand_correct_data(struct mtd_info *mtd, u_char *dat,
 	return -1;
 }
 
+static int s3c2410_nand_blank(const uint8_t *buf, int len)
+{
+	while (len--)
+		if (*buf++ != 0xff)
+			return 0;
+
+	return 1;
+}
+
+/* BCH ECC
+ *
+ * With the lBook's 2KiB pages the hardware ECC only corrects a single
+ * bit over the whole page. The hardware ECC is kept, so the bootloader
+ * can still read what we write, and a BCH code correcting 4 bits in
+ * each 512 bytes is added in the OOB. Pages which were written before
+ * the BCH ECC was enabled have no BCH ECC, and are checked with the
+ * hardware ECC alone.
+*/
+
+#ifdef CONFIG_MTD_NAND_S3C2410_BCH
+
+static int s3c2410_nand_read_page_bch(struct mtd_info *mtd,
+				      struct nand_chip *chip, uint8_t *buf)
+{
+	struct s3c2410_nand_info *info = s3c2410_nand_mtd_toinfo(mtd);
+	uint8_t *ecc_calc = chip->buffers->ecccalc;
+	uint8_t *ecc_code = chip->buffers->ecccode;
+	uint32_t *eccpos = chip->ecc.layout->eccpos;
+	int eccbytes = nand_bch_eccbytes(info->bch);
+	int steps = mtd->writesize / S3C2410_BCH_SIZE;
+	uint8_t *bch_code = ecc_code + S3C2410_BCH_HWBYTES;
+	int i, stat;
+
+	chip->ecc.hwctl(mtd, NAND_ECC_READ);
+	chip->read_buf(mtd, buf, mtd->writesize);
+	chip->ecc.calculate(mtd, buf, ecc_calc);
+	chip->read_buf(mtd, chip->oob_poi, mtd->oobsize);
+
+	if (s3c2410_nand_dma_failed(mtd)) {
+		mtd->ecc_stats.failed++;
+		return 0;
+	}
+
+	for (i = 0; i < chip->ecc.total; i++)
+		ecc_code[i] = chip->oob_poi[eccpos[i]];
+
+	if (s3c2410_nand_blank(bch_code, steps * eccbytes) &&
+	    !s3c2410_nand_blank(ecc_code, S3C2410_BCH_HWBYTES)) {
+		stat = s3c2410_nand_correct_data(mtd, buf, ecc_code, ecc_calc);
+		if (stat < 0)
+			mtd->ecc_stats.failed++;
+		else
+			mtd->ecc_stats.corrected += stat;
+		return 0;
+	}
+
+	for (i = 0; i < steps; i++) {
+		stat = nand_bch_correct_data(info->bch,
+					     buf + i * S3C2410_BCH_SIZE,
+					     bch_code + i * eccbytes);
+		if (stat < 0)
+			mtd->ecc_stats.failed++;
+		else
+			mtd->ecc_stats.corrected += stat;
+	}
+
+	return 0;
+}
+
+static void s3c2410_nand_write_page_bch(struct mtd_info *mtd,
+					struct nand_chip *chip,
+					const uint8_t *buf)
+{
+	struct s3c2410_nand_info *info = s3c2410_nand_mtd_toinfo(mtd);
+	uint8_t *ecc_calc = chip->buffers->ecccalc;
+	uint32_t *eccpos = chip->ecc.layout->eccpos;
+	int eccbytes = nand_bch_eccbytes(info->bch);
+	int steps = mtd->writesize / S3C2410_BCH_SIZE;
+	int i;
+
+	chip->ecc.hwctl(mtd, NAND_ECC_WRITE);
+	chip->write_buf(mtd, buf, mtd->writesize);
+	chip->ecc.calculate(mtd, buf, ecc_calc);
+
+	for (i = 0; i < steps; i++)
+		nand_bch_calculate_ecc(info->bch, buf + i * S3C2410_BCH_SIZE,
+				       ecc_calc + S3C2410_BCH_HWBYTES +
+				       i * eccbytes);
+
+	for (i = 0; i < chip->ecc.total; i++)
+		chip->oob_poi[eccpos[i]] = ecc_calc[i];
+
+	chip->write_buf(mtd, chip->oob_poi, mtd->oobsize);
+}
+
+static void s3c2410_nand_bch_setup(struct s3c2410_nand_info *info,
+				   struct s3c2410_nand_mtd *nmtd)
+{
+	struct nand_chip *chip = &nmtd->chip;
+	struct mtd_info *mtd = &nmtd->mtd;
+	int steps = mtd->writesize / S3C2410_BCH_SIZE;
+
+	if (info->bch == NULL)
+		info->bch = nand_bch_init(S3C2410_BCH_M, S3C2410_BCH_T,
+					  S3C2410_BCH_SIZE);
+
+	if (info->bch == NULL) {
+		dev_err(info->device, "cannot set up BCH ECC\n");
+		return;
+	}
+
+	if (S3C2410_BCH_HWBYTES + steps * nand_bch_eccbytes(info->bch) !=
+	    nand_bch_eccoob.eccbytes) {
+		dev_err(info->device, "BCH ECC does not fit %d byte page\n",
+			mtd->writesize);
+		return;
+	}
+
+	chip->ecc.bytes	     = nand_bch_eccoob.eccbytes;
+	chip->ecc.layout     = &nand_bch_eccoob;
+	chip->ecc.read_page  = s3c2410_nand_read_page_bch;
+	chip->ecc.write_page = s3c2410_nand_write_page_bch;
+
+	dev_info(info->device, "%d bit BCH ECC per %d bytes\n",
+		 S3C2410_BCH_T, S3C2410_BCH_SIZE);
+}
+
+static void s3c2410_nand_bch_free(struct s3c2410_nand_info *info)
+{
+	nand_bch_free(info->bch);
+	info->bch = NULL;
+}
+
+#else
+static inline void s3c2410_nand_bch_setup(struct s3c2410_nand_info *info,
+					  struct s3c2410_nand_mtd *nmtd)
+{
+}
+
+static inline void s3c2410_nand_bch_free(struct s3c2410_nand_info *info)
+{
+}
+#endif
+
 /* ECC functions
  *
  * These allow the s3c2410 and s3c2440 to use the controller's ECC
@@ -525,34 +772,569 @@ static int s3c2440_nand_calculate_ecc(struct mtd_info *mtd, const u_char *dat, u
 	return 0;
 }
 
+/* DMA support
+ *
+ * The NAND controller has no DMA request line, so the transfers are
+ * done as software triggered, whole service transfers between memory
+ * and the fixed NFDATA address. The ECC generator sees the data pass
+ * through exactly as it would for the CPU, and since we wait for the
+ * transfer to complete before returning the ECC registers are valid
+ * by the time the NAND core reads them.
+*/
+
+#ifdef CONFIG_MTD_NAND_S3C2410_DMA
+
+static struct s3c2410_dma_client s3c2410_nand_dma_client = {
+	.name		= "s3c2410-nand",
+};
+
+static void s3c2410_nand_dma_done(struct s3c2410_dma_chan *chan,
+				  void *buf_id, int size,
+				  enum s3c2410_dma_buffresult result)
+{
+	struct s3c2410_nand_info *info = buf_id;
+
+	info->dma_result = result;
+	complete(&info->dma_done);
+}
+
+/* s3c2410_nand_dma_xfer
+ *
+ * try and move the buffer by DMA, returning 0 if it was done, or an
+ * error if the caller should fall back to PIO. Small transfers are not
+ * worth the setup and interrupt, and buffers which do not sit on whole
+ * cache lines of lowmem cannot be safely mapped.
+*/
+
+static int s3c2410_nand_dma_xfer(struct s3c2410_nand_info *info,
+				 void *buf, int len, int write)
+{
+	enum dma_data_direction dir = write ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
+	int xferunit = (info->cpu_type == TYPE_S3C2410) ? 1 : 4;
+	dma_addr_t dma;
+	int ret;
+
+	if (!info->dma_ok || len < dma_min)
+		return -EINVAL;
+
+	if (in_atomic() || irqs_disabled())
+		return -EINVAL;
+
+	if (!virt_addr_valid(buf) || !virt_addr_valid(buf + len - 1))
+		return -EINVAL;
+
+	if (((unsigned long)buf | len) & (L1_CACHE_BYTES - 1))
+		return -EINVAL;
+
+	dma = dma_map_single(info->device, buf, len, dir);
+
+	s3c2410_dma_devconfig(DMACH_MEM,
+			      write ? S3C2410_DMASRC_MEM : S3C2410_DMASRC_HW,
+			      1, info->data_phys);
+
+	s3c2410_dma_config(DMACH_MEM, xferunit,
+			   S3C2410_DCON_SYNC_HCLK | S3C2410_DCON_SERVMODE);
+
+	INIT_COMPLETION(info->dma_done);
+
+	ret = s3c2410_dma_enqueue(DMACH_MEM, info, dma, len);
+	if (ret == 0)
+		ret = s3c2410_dma_ctrl(DMACH_MEM, S3C2410_DMAOP_START);
+
+	if (ret == 0) {
+		if (!wait_for_completion_timeout(&info->dma_done, HZ / 10)) {
+			dev_err(info->device, "dma %s of %d bytes timed out\n",
+				write ? "write" : "read", len);
+			s3c2410_dma_ctrl(DMACH_MEM, S3C2410_DMAOP_FLUSH);
+			ret = -ETIMEDOUT;
+		} else if (info->dma_result != S3C2410_RES_OK) {
+			dev_err(info->device, "dma %s failed (%d)\n",
+				write ? "write" : "read", info->dma_result);
+			ret = -EIO;
+		}
+	}
+
+	dma_unmap_single(info->device, dma, len, dir);
+
+	/* nothing has been transferred if we failed to queue the buffer.
+	 * After a timeout or a failed transfer the controller has already
+	 * moved part of the data, so the caller must not simply carry on
+	 * by PIO; see s3c2410_nand_dma_buf(). */
+
+	if (ret == -ETIMEDOUT || ret == -EIO) {
+		info->dma_ok = 0;
+		dev_err(info->device, "disabling dma, using pio\n");
+	}
+
+	return ret;
+}
+
+/* recovering from a failed DMA
+ *
+ * Every command which starts a data transfer is noted, along with how
+ * many bytes have been moved since and where the ECC generator was
+ * started. A failed read is restarted from the command, the bytes
+ * before the buffer are read again, by PIO, so the ECC sees the same
+ * stream, and the buffer is then read by PIO.
+ *
+ * A failed write cannot be restarted, the chip's page register has
+ * already taken the data, so the chip is reset instead of programmed
+ * and the write is failed with the status the NAND core checks. Reads
+ * which cannot be restarted (the cache reads, which have already moved
+ * on to the next page) are failed as uncorrectable.
+*/
+
+static void s3c2410_nand_dma_cmdfunc(struct mtd_info *mtd, unsigned command,
+				     int column, int page_addr)
+{
+	struct s3c2410_nand_mtd *nmtd = s3c2410_nand_mtd_toours(mtd);
+
+	switch (command) {
+	case NAND_CMD_READ0:
+	case NAND_CMD_READ1:
+	case NAND_CMD_READOOB:
+		nmtd->read_failed = 0;
+		/* fall through */
+	case NAND_CMD_RNDOUT:
+		nmtd->cmd = command;
+		nmtd->column = column;
+		nmtd->page = page_addr;
+		nmtd->xfer = 0;
+		nmtd->ecc_at = -1;
+		break;
+
+	case NAND_CMD_PAGEPROG:
+	case NAND_CMD_CACHEDPROG:
+		if (nmtd->write_failed) {
+			nmtd->cmdfunc(mtd, NAND_CMD_RESET, -1, -1);
+			return;
+		}
+		break;
+
+	case NAND_CMD_STATUS:
+		break;
+
+	case NAND_CMD_RNDIN:
+		nmtd->cmd = -1;
+		break;
+
+	default:
+		nmtd->cmd = -1;
+		nmtd->read_failed = 0;
+		nmtd->write_failed = 0;
+		break;
+	}
+
+	nmtd->cmdfunc(mtd, command, column, page_addr);
+}
+
+static int s3c2410_nand_dma_waitfunc(struct mtd_info *mtd,
+				     struct nand_chip *chip)
+{
+	struct s3c2410_nand_mtd *nmtd = s3c2410_nand_mtd_toours(mtd);
+	int status = nmtd->waitfunc(mtd, chip);
+
+	if (nmtd->write_failed) {
+		nmtd->write_failed = 0;
+		status |= NAND_STATUS_FAIL;
+	}
+
+	return status;
+}
+
+static void s3c2410_nand_dma_hwctl(struct mtd_info *mtd, int mode)
+{
+	struct s3c2410_nand_mtd *nmtd = s3c2410_nand_mtd_toours(mtd);
+
+	nmtd->ecc_at = nmtd->xfer;
+	nmtd->ecc_mode = mode;
+	nmtd->hwctl(mtd, mode);
+}
+
+static void s3c2410_nand_dma_skip(struct mtd_info *mtd, int len)
+{
+	struct nand_chip *chip = mtd->priv;
+
+	while (len-- > 0)
+		chip->read_byte(mtd);
+}
+
+/* s3c2410_nand_dma_recover
+ *
+ * returns 0 if the transfer has been dealt with, or non-zero if the
+ * caller should now move the buffer by PIO.
+*/
+
+static int s3c2410_nand_dma_recover(struct s3c2410_nand_mtd *nmtd, int write)
+{
+	struct mtd_info *mtd = &nmtd->mtd;
+
+	if (write) {
+		nmtd->write_failed = 1;
+		return 0;
+	}
+
+	if (nmtd->cmd < 0) {
+		nmtd->read_failed = 1;
+		return 0;
+	}
+
+	nmtd->cmdfunc(mtd, nmtd->cmd, nmtd->column, nmtd->page);
+
+	if (nmtd->ecc_at >= 0) {
+		s3c2410_nand_dma_skip(mtd, nmtd->ecc_at);
+		nmtd->hwctl(mtd, nmtd->ecc_mode);
+		s3c2410_nand_dma_skip(mtd, nmtd->xfer - nmtd->ecc_at);
+	} else
+		s3c2410_nand_dma_skip(mtd, nmtd->xfer);
+
+	return -EIO;
+}
+
+/* s3c2410_nand_dma_buf
+ *
+ * move a read_buf or write_buf buffer, returning 0 if it was done, or
+ * non-zero if the caller should move it by PIO.
+*/
+
+static int s3c2410_nand_dma_buf(struct mtd_info *mtd, void *buf,
+				int len, int write)
+{
+	struct s3c2410_nand_mtd *nmtd = s3c2410_nand_mtd_toours(mtd);
+	int ret;
+
+	if (write && nmtd->write_failed)
+		return 0;
+
+	ret = s3c2410_nand_dma_xfer(nmtd->info, buf, len, write);
+	if (ret == -ETIMEDOUT || ret == -EIO)
+		ret = s3c2410_nand_dma_recover(nmtd, write);
+
+	nmtd->xfer += len;
+	return ret;
+}
+
+static void s3c2410_nand_dma_setup(struct s3c2410_nand_mtd *nmtd)
+{
+	struct nand_chip *chip = &nmtd->chip;
+
+	nmtd->cmd = -1;
+
+	nmtd->cmdfunc = chip->cmdfunc;
+	chip->cmdfunc = s3c2410_nand_dma_cmdfunc;
+
+	nmtd->waitfunc = chip->waitfunc;
+	chip->waitfunc = s3c2410_nand_dma_waitfunc;
+
+	if (chip->ecc.hwctl) {
+		nmtd->hwctl = chip->ecc.hwctl;
+		chip->ecc.hwctl = s3c2410_nand_dma_hwctl;
+	}
+}
+
+static int s3c2410_nand_dma_init(struct s3c2410_nand_info *info)
+{
+	int ret;
+
+	init_completion(&info->dma_done);
+
+	ret = s3c2410_dma_request(DMACH_MEM, &s3c2410_nand_dma_client, NULL);
+	if (ret < 0) {
+		dev_info(info->device, "no dma channel, using pio\n");
+		return 0;
+	}
+
+	s3c2410_dma_set_buffdone_fn(DMACH_MEM, s3c2410_nand_dma_done);
+	s3c2410_dma_setflags(DMACH_MEM, S3C2410_DMAF_SWTRIG);
+
+	info->dma_ok = 1;
+	return 0;
+}
+
+static void s3c2410_nand_dma_free(struct s3c2410_nand_info *info)
+{
+	if (info->dma_ok) {
+		s3c2410_dma_free(DMACH_MEM, &s3c2410_nand_dma_client);
+		info->dma_ok = 0;
+	}
+}
+
+#else
+static inline int s3c2410_nand_dma_buf(struct mtd_info *mtd, void *buf,
+				       int len, int write)
+{
+	return -EINVAL;
+}
+
+static inline void s3c2410_nand_dma_setup(struct s3c2410_nand_mtd *nmtd)
+{
+}
+
+static inline int s3c2410_nand_dma_init(struct s3c2410_nand_info *info)
+{
+	return 0;
+}
+
+static inline void s3c2410_nand_dma_free(struct s3c2410_nand_info *info)
+{
+}
+#endif
+
 /* over-ride the standard functions for a little more speed. We can
- * use read/write block to move the data buffers to/from the controller
+ * use DMA, or read/write block to move the data buffers to/from the
+ * controller
 */
 
 static void s3c2410_nand_read_buf(struct mtd_info *mtd, u_char *buf, int len)
 {
 	struct nand_chip *this = mtd->priv;
+
+	if (s3c2410_nand_dma_buf(mtd, buf, len, 0) == 0)
+		return;
+
 	readsb(this->IO_ADDR_R, buf, len);
 }
 
 static void s3c2440_nand_read_buf(struct mtd_info *mtd, u_char *buf, int len)
 {
 	struct s3c2410_nand_info *info = s3c2410_nand_mtd_toinfo(mtd);
+
+	if (s3c2410_nand_dma_buf(mtd, buf, len, 0) == 0)
+		return;
+
 	readsl(info->regs + S3C2440_NFDATA, buf, len / 4);
 }
 
 static void s3c2410_nand_write_buf(struct mtd_info *mtd, const u_char *buf, int len)
 {
 	struct nand_chip *this = mtd->priv;
+
+	if (s3c2410_nand_dma_buf(mtd, (void *)buf, len, 1) == 0)
+		return;
+
 	writesb(this->IO_ADDR_W, buf, len);
 }
 
 static void s3c2440_nand_write_buf(struct mtd_info *mtd, const u_char *buf, int len)
 {
 	struct s3c2410_nand_info *info = s3c2410_nand_mtd_toinfo(mtd);
+
+	if (s3c2410_nand_dma_buf(mtd, (void *)buf, len, 1) == 0)
+		return;
+
 	writesl(info->regs + S3C2440_NFDATA, buf, len / 4);
 }
 
+/* timing selection
+ *
+ * The platform timings have to suit every chip a board may have been
+ * built with. Once the chips are identified, the faster timings from
+ * the platform table are used if all of them are listed there, and
+ * optionally only if the first page of a few written blocks reads back
+ * the same at the faster timings, with no more bits corrected by the
+ * ECC. The spare blocks of the bad block translation are normally
+ * erased, so the search starts after them, and erased pages, which
+ * read back as all 0xff whatever the timing, are not counted.
+*/
+
+#define S3C2410_NAND_VERIFY_BLOCKS	8
+#define S3C2410_NAND_VERIFY_SEARCH	64
+
+static int s3c2410_nand_set_timing(struct s3c2410_nand_info *info,
+				   const struct s3c2410_nand_rate *timing)
+{
+	info->timing = *timing;
+	return s3c2410_nand_setrate(info);
+}
+
+static void s3c2410_nand_read_id(struct s3c2410_nand_mtd *nmtd,
+				 int *maf_id, int *dev_id)
+{
+	struct mtd_info *mtd = &nmtd->mtd;
+	struct nand_chip *chip = &nmtd->chip;
+
+	chip->select_chip(mtd, 0);
+	chip->cmdfunc(mtd, NAND_CMD_READID, 0x00, -1);
+	*maf_id = chip->read_byte(mtd);
+	*dev_id = chip->read_byte(mtd);
+	chip->select_chip(mtd, -1);
+}
+
+static struct s3c2410_nand_timing *
+s3c2410_nand_find_timing(struct s3c2410_nand_info *info,
+			 struct s3c2410_nand_mtd *nmtd)
+{
+	struct s3c2410_platform_nand *plat = info->platform;
+	int maf_id, dev_id;
+	int i;
+
+	s3c2410_nand_read_id(nmtd, &maf_id, &dev_id);
+
+	for (i = 0; i < plat->nr_timings; i++) {
+		if (plat->timings[i].maf_id == maf_id &&
+		    plat->timings[i].dev_id == dev_id)
+			return &plat->timings[i];
+	}
+
+	dev_info(info->device, "no timings for chip %02x:%02x\n",
+		 maf_id, dev_id);
+	return NULL;
+}
+
+static int s3c2410_nand_read_page(struct s3c2410_nand_mtd *nmtd,
+				  loff_t offs, u_char *buf)
+{
+	struct mtd_info *mtd = &nmtd->mtd;
+	size_t retlen;
+	int ret;
+
+	/* make sure the page is really read again */
+	nmtd->chip.pagebuf = -1;
+
+	ret = mtd->read(mtd, offs, mtd->writesize, &retlen, buf);
+	if (ret == -EUCLEAN)
+		ret = 0;
+	if (ret == 0 && retlen != mtd->writesize)
+		ret = -EIO;
+
+	return ret;
+}
+
+static int s3c2410_nand_verify_timing(struct s3c2410_nand_info *info,
+				      struct s3c2410_nand_mtd *nmtd,
+				      const struct s3c2410_nand_rate *safe,
+				      const struct s3c2410_nand_rate *fast)
+{
+	struct mtd_info *mtd = &nmtd->mtd;
+	struct mtd_ecc_stats stats;
+	unsigned int corrected;
+	u_char *ref, *buf;
+	loff_t offs = 0;
+	int checked = 0;
+	int tried = 0;
+	int ret = 0;
+
+	ref = kmalloc(mtd->writesize * 2, GFP_KERNEL);
+	if (ref == NULL)
+		return -ENOMEM;
+
+	buf = ref + mtd->writesize;
+
+#ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
+	offs = (loff_t)nmtd->chip.bb_spare_blocks << nmtd->chip.phys_erase_shift;
+#endif
+
+	for (; offs < mtd->size && checked < S3C2410_NAND_VERIFY_BLOCKS &&
+		     tried < S3C2410_NAND_VERIFY_SEARCH;
+	     offs += mtd->erasesize) {
+		if (mtd->block_isbad(mtd, offs))
+			continue;
+
+		tried++;
+
+		s3c2410_nand_set_timing(info, safe);
+
+		stats = mtd->ecc_stats;
+		if (s3c2410_nand_read_page(nmtd, offs, ref) ||
+		    mtd->ecc_stats.failed != stats.failed)
+			continue;
+
+		if (s3c2410_nand_blank(ref, mtd->writesize))
+			continue;
+
+		corrected = mtd->ecc_stats.corrected - stats.corrected;
+
+		s3c2410_nand_set_timing(info, fast);
+
+		stats = mtd->ecc_stats;
+		ret = s3c2410_nand_read_page(nmtd, offs, buf);
+		if (ret == 0 &&
+		    (mtd->ecc_stats.failed != stats.failed ||
+		     mtd->ecc_stats.corrected - stats.corrected > corrected ||
+		     memcmp(ref, buf, mtd->writesize) != 0))
+			ret = -EIO;
+
+		if (ret) {
+			dev_warn(info->device, "page at 0x%08llx differs at "
+				 "faster timings\n", (unsigned long long)offs);
+			break;
+		}
+
+		checked++;
+	}
+
+	if (ret == 0 && checked == 0)
+		ret = -ENODATA;
+
+	kfree(ref);
+	return ret;
+}
+
+/* s3c2410_nand_tune
+ *
+ * called once all the sets have been scanned, before any partition is
+ * added, so nothing else is using the chips yet
+*/
+
+static void s3c2410_nand_tune(struct s3c2410_nand_info *info)
+{
+	struct s3c2410_nand_mtd *nmtd = info->mtds;
+	struct s3c2410_nand_timing *t;
+	struct s3c2410_nand_rate safe = info->timing;
+	struct s3c2410_nand_rate fast = { 0, 0, 0 };
+	int mtdno;
+	int ret;
+
+	if (!auto_timing || info->platform == NULL ||
+	    info->platform->nr_timings == 0)
+		return;
+
+	/* the controller runs every chip at the same timings, so take the
+	 * slowest of those needed by each of them */
+
+	for (mtdno = 0; mtdno < info->mtd_count; mtdno++, nmtd++) {
+		if (nmtd->scan_res != 0)
+			continue;
+
+		t = s3c2410_nand_find_timing(info, nmtd);
+		if (t == NULL)
+			return;
+
+		fast.tacls = max(fast.tacls, t->tacls);
+		fast.twrph0 = max(fast.twrph0, t->twrph0);
+		fast.twrph1 = max(fast.twrph1, t->twrph1);
+	}
+
+	if (fast.tacls >= safe.tacls && fast.twrph0 >= safe.twrph0 &&
+	    fast.twrph1 >= safe.twrph1)
+		return;
+
+	if (!verify_timing) {
+		s3c2410_nand_set_timing(info, &fast);
+		info->timing_src = "chip table";
+		return;
+	}
+
+	nmtd = info->mtds;
+
+	for (mtdno = 0; mtdno < info->mtd_count; mtdno++, nmtd++) {
+		if (nmtd->scan_res != 0)
+			continue;
+
+		ret = s3c2410_nand_verify_timing(info, nmtd, &safe, &fast);
+		if (ret != 0) {
+			dev_warn(info->device, "faster timings failed (%d), "
+				 "keeping the platform ones\n", ret);
+			s3c2410_nand_set_timing(info, &safe);
+			info->timing_src = "platform, chip table failed";
+			return;
+		}
+	}
+
+	/* leaves the controller at the fast timings */
+	info->timing_src = "chip table, verified";
+}
+
 /* cpufreq driver support */
 
 #ifdef CONFIG_CPU_FREQ
@@ -599,6 +1381,94 @@ static inline void s3c2410_nand_cpufreq_deregister(struct s3c2410_nand_info *inf
 }
 #endif
 
+/* sysfs support */
+
+static ssize_t s3c2410_nand_show_timing(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct s3c2410_nand_info *info = dev_get_drvdata(dev);
+	unsigned long clkrate = info->clk_rate / 1000;
+
+	return snprintf(buf, PAGE_SIZE,
+			"tacls: %dns (%d clocks)\n"
+			"twrph0: %dns (%d clocks)\n"
+			"twrph1: %dns (%d clocks)\n"
+			"source: %s\n",
+			to_ns(info->clocks.tacls, clkrate), info->clocks.tacls,
+			to_ns(info->clocks.twrph0, clkrate), info->clocks.twrph0,
+			to_ns(info->clocks.twrph1, clkrate), info->clocks.twrph1,
+			info->timing_src);
+}
+
+static DEVICE_ATTR(timing, S_IRUGO, s3c2410_nand_show_timing, NULL);
+
+#ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
+
+static ssize_t s3c2410_nand_show_bbtrans(struct device *dev,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	struct s3c2410_nand_info *info = dev_get_drvdata(dev);
+	struct s3c2410_nand_mtd *nmtd = info->mtds;
+	ssize_t len = 0;
+	int mtdno;
+
+	for (mtdno = 0; mtdno < info->mtd_count; mtdno++, nmtd++) {
+		if (nmtd->scan_res != 0)
+			continue;
+
+		len += nand_bbt_show_translation(&nmtd->mtd, buf + len,
+						 PAGE_SIZE - len);
+	}
+
+	return len;
+}
+
+static DEVICE_ATTR(bb_translation, S_IRUGO, s3c2410_nand_show_bbtrans, NULL);
+
+static inline int s3c2410_nand_sysfs_add_bbtrans(struct s3c2410_nand_info *info)
+{
+	return device_create_file(info->device, &dev_attr_bb_translation);
+}
+
+static inline void s3c2410_nand_sysfs_remove_bbtrans(struct s3c2410_nand_info *info)
+{
+	device_remove_file(info->device, &dev_attr_bb_translation);
+}
+
+#else
+static inline int s3c2410_nand_sysfs_add_bbtrans(struct s3c2410_nand_info *info)
+{
+	return 0;
+}
+
+static inline void s3c2410_nand_sysfs_remove_bbtrans(struct s3c2410_nand_info *info)
+{
+}
+#endif
+
+static int s3c2410_nand_sysfs_add(struct s3c2410_nand_info *info)
+{
+	int ret;
+
+	ret = device_create_file(info->device, &dev_attr_timing);
+	if (ret < 0)
+		return ret;
+
+	ret = s3c2410_nand_sysfs_add_bbtrans(info);
+	if (ret < 0)
+		device_remove_file(info->device, &dev_attr_timing);
+
+	return ret;
+}
+
+static void s3c2410_nand_sysfs_remove(struct s3c2410_nand_info *info)
+{
+	s3c2410_nand_sysfs_remove_bbtrans(info);
+	device_remove_file(info->device, &dev_attr_timing);
+}
+
 /* device management functions */
 
 static int s3c2410_nand_remove(struct platform_device *pdev)
@@ -611,6 +1481,10 @@ static int s3c2410_nand_remove(struct platform_device *pdev)
 		return 0;
 
 	s3c2410_nand_cpufreq_deregister(info);
+	s3c2410_nand_dma_free(info);
+
+	if (info->mtds != NULL)
+		s3c2410_nand_sysfs_remove(info);
 
 	/* Release all our mtds  and their partitions, then go through
 	 * freeing the resources used
@@ -628,6 +1502,8 @@ static int s3c2410_nand_remove(struct platform_device *pdev)
 		kfree(info->mtds);
 	}
 
+	s3c2410_nand_bch_free(info);
+
 	/* free the common resources */
 
 	if (info->clk != NULL && !IS_ERR(info->clk)) {
@@ -780,6 +1656,16 @@ static void s3c2410_nand_init_chip(struct s3c2410_nand_info *info,
 #endif
 }
 
+#ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
+static int s3c2410_nand_spare_blocks(struct s3c2410_nand_mtd *nmtd)
+{
+	if (nmtd->set != NULL && nmtd->set->nr_spare_blocks)
+		return nmtd->set->nr_spare_blocks;
+
+	return 64;
+}
+#endif
+
 /* s3c2410_nand_update_chip
  *
  * post-probe chip update, to change any items, such as the
@@ -804,8 +1690,9 @@ static void s3c2410_nand_update_chip(struct s3c2410_nand_info *info,
 			chip->ecc.size	    = 2048;
 			chip->ecc.layout    = &nand_hw_eccoob;
 #ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
-			chip->bb_spare_blocks = 64;
+			chip->bb_spare_blocks = s3c2410_nand_spare_blocks(nmtd);
 #endif
+			s3c2410_nand_bch_setup(info, nmtd);
 
 #else
 			chip->ecc.size	    = 256;
@@ -815,10 +1702,18 @@ static void s3c2410_nand_update_chip(struct s3c2410_nand_info *info,
 			chip->ecc.bytes	    = 3;
 			chip->ecc.layout    = &nand_hw_eccoob;
 #ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
-			chip->bb_spare_blocks = 64;
+			chip->bb_spare_blocks = s3c2410_nand_spare_blocks(nmtd);
 #endif
 		}
 	}
+
+#ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_UBI
+	if (chip->bb_spare_blocks && nmtd->set != NULL)
+		chip->bb_translate_limit =
+			nmtd->set->translate_limit >> chip->phys_erase_shift;
+#endif
+
+	s3c2410_nand_dma_setup(nmtd);
 }
 
 /* s3c2410_nand_probe
@@ -886,6 +1781,8 @@ static int s3c24xx_nand_probe(struct platform_device *pdev,
 	info->platform   = plat;
 	info->regs       = ioremap(res->start, size);
 	info->cpu_type   = cpu_type;
+	info->data_phys  = res->start + ((cpu_type == TYPE_S3C2410) ?
+					 S3C2410_NFDATA : S3C2440_NFDATA);
 
 	if (info->regs == NULL) {
 		dev_err(&pdev->dev, "cannot reserve register region\n");
@@ -895,12 +1792,24 @@ static int s3c24xx_nand_probe(struct platform_device *pdev,
 
 	dev_dbg(&pdev->dev, "mapped registers at %p\n", info->regs);
 
+	if (plat != NULL) {
+		info->timing.tacls  = plat->tacls;
+		info->timing.twrph0 = plat->twrph0;
+		info->timing.twrph1 = plat->twrph1;
+		info->timing_src = "platform";
+	} else
+		info->timing_src = "default";
+
 	/* initialise the hardware */
 
 	err = s3c2410_nand_inithw(info);
 	if (err != 0)
 		goto exit_error;
 
+	err = s3c2410_nand_dma_init(info);
+	if (err != 0)
+		goto exit_error;
+
 	sets = (plat != NULL) ? plat->sets : NULL;
 	nr_sets = (plat != NULL) ? plat->nr_sets : 1;
 
@@ -933,19 +1842,33 @@ static int s3c24xx_nand_probe(struct platform_device *pdev,
 		if (nmtd->scan_res == 0) {
 			s3c2410_nand_update_chip(info, nmtd);
 			nand_scan_tail(&nmtd->mtd);
-			s3c2410_nand_add_partition(info, nmtd, sets);
 		}
 
 		if (sets != NULL)
 			sets++;
 	}
 
+	s3c2410_nand_tune(info);
+
+	nmtd = info->mtds;
+
+	for (setno = 0; setno < nr_sets; setno++, nmtd++) {
+		if (nmtd->scan_res == 0)
+			s3c2410_nand_add_partition(info, nmtd, nmtd->set);
+	}
+
 	err = s3c2410_nand_cpufreq_register(info);
 	if (err < 0) {
 		dev_err(&pdev->dev, "failed to init cpufreq support\n");
 		goto exit_error;
 	}
 
+	err = s3c2410_nand_sysfs_add(info);
+	if (err < 0) {
+		dev_err(&pdev->dev, "failed to add sysfs attributes\n");
+		goto exit_error;
+	}
+
 	if (allow_clk_stop(info)) {
 		dev_info(&pdev->dev, "clock idle support enabled\n");
 		clk_disable(info->clk);
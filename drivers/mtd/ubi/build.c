@@ -41,6 +41,7 @@
 #include <linux/miscdevice.h>
 #include <linux/log2.h>
 #include <linux/kthread.h>
+#include <linux/reboot.h>
 #include "ubi.h"
 
 /* Maximum length of the 'mtd=' parameter */
@@ -477,17 +478,18 @@ static void free_internal_volumes(struct ubi_device *ubi)
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  *
- * Note, currently this is the only method to attach UBI devices. Hopefully in
- * the future we'll have more scalable attaching methods and avoid full media
- * scanning. But even in this case scanning will be needed as a fall-back
- * attaching method if there are some on-flash table corruptions.
+ * If the device was detached cleanly and %CONFIG_MTD_UBI_CKPT is enabled, the
+ * scanning information is taken from the checkpoint written at that time,
+ * otherwise the whole device is scanned.
  */
 static int attach_by_scanning(struct ubi_device *ubi)
 {
 	int err;
 	struct ubi_scan_info *si;
 
-	si = ubi_scan(ubi);
+	si = ubi_ckpt_scan(ubi);
+	if (!si)
+		si = ubi_scan(ubi);
 	if (IS_ERR(si))
 		return PTR_ERR(si);
 
@@ -946,6 +948,9 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	if (ubi->bgt_thread)
 		kthread_stop(ubi->bgt_thread);
 
+	if (!ubi->ref_count)
+		ubi_ckpt_write(ubi);
+
 	uif_close(ubi);
 	ubi_wl_close(ubi);
 	free_internal_volumes(ubi);
@@ -989,6 +994,35 @@ static struct mtd_info * __init open_mtd_device(const char *mtd_dev)
 	return mtd;
 }
 
+#ifdef CONFIG_MTD_UBI_CKPT
+/*
+ * Devices of a built-in UBI are never detached, so this is where they get
+ * their checkpoint.
+ */
+static int ubi_reboot_notify(struct notifier_block *nb, unsigned long code,
+			     void *unused)
+{
+	struct ubi_device *ubi;
+	int i;
+
+	mutex_lock(&ubi_devices_mutex);
+	for (i = 0; i < UBI_MAX_DEVICES; i++) {
+		ubi = ubi_get_device(i);
+		if (!ubi)
+			continue;
+		ubi_ckpt_write(ubi);
+		ubi_put_device(ubi);
+	}
+	mutex_unlock(&ubi_devices_mutex);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ubi_reboot_nb = {
+	.notifier_call = ubi_reboot_notify,
+};
+#endif
+
 static int __init ubi_init(void)
 {
 	int err, i, k;
@@ -1028,6 +1062,10 @@ static int __init ubi_init(void)
 	if (!ubi_wl_entry_slab)
 		goto out_dev_unreg;
 
+#ifdef CONFIG_MTD_UBI_CKPT
+	register_reboot_notifier(&ubi_reboot_nb);
+#endif
+
 	/* Attach MTD devices */
 	for (i = 0; i < mtd_devs; i++) {
 		struct mtd_dev_param *p = &mtd_dev_param[i];
@@ -1061,6 +1099,9 @@ out_detach:
 			ubi_detach_mtd_dev(ubi_devices[k]->ubi_num, 1);
 			mutex_unlock(&ubi_devices_mutex);
 		}
+#ifdef CONFIG_MTD_UBI_CKPT
+	unregister_reboot_notifier(&ubi_reboot_nb);
+#endif
 	kmem_cache_destroy(ubi_wl_entry_slab);
 out_dev_unreg:
 	misc_deregister(&ubi_ctrl_cdev);
@@ -1084,6 +1125,9 @@ static void __exit ubi_exit(void)
 			ubi_detach_mtd_dev(ubi_devices[i]->ubi_num, 1);
 			mutex_unlock(&ubi_devices_mutex);
 		}
+#ifdef CONFIG_MTD_UBI_CKPT
+	unregister_reboot_notifier(&ubi_reboot_nb);
+#endif
 	kmem_cache_destroy(ubi_wl_entry_slab);
 	misc_deregister(&ubi_ctrl_cdev);
 	class_remove_file(ubi_class, &ubi_version);
@@ -0,0 +1,586 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * UBI attach checkpoint.
+ *
+ * Attaching by scanning reads the EC and VID headers of every physical
+ * eraseblock, which takes a while on a large NAND. When a device is detached
+ * cleanly, or the system is rebooted with no volume open for writing, the
+ * state the scan would find - the erase counter of every PEB and the volume
+ * and LEB it is mapped to - is written to a free PEB near the start of the
+ * device as the only LEB of the checkpoint volume. The next attach looks for
+ * it among the first %UBI_CKPT_ANCHORS PEBs, builds the scanning information
+ * from it and only has to read the volume table.
+ *
+ * The checkpoint is only valid until anything is written to the device, so
+ * the PEB holding it is erased before the attach finishes, and nothing is
+ * written after it until the device is gone. If it is missing, damaged or
+ * does not match the device, or the erasure fails, UBI falls back to the
+ * full scan, which erases the checkpoint volume straight away as well, see
+ * 'process_eb()'.
+ *
+ * Implementations which do not know about checkpoints attach the image as
+ * usual, since the volume is "delete" compatible, but may write to the device
+ * before they get round to erasing it. Everything UBI writes goes to a PEB
+ * which was free or has been erased, so before it is trusted the checkpoint
+ * is checked against those: its free PEBs must still have no VID header, and
+ * those it has waiting for erasure must still have the same erase counter.
+ * This costs a read for each of them, which is still far less than the scan.
+ * Only an erasure with nothing written after it, such as unmapping a LEB just
+ * before the device went away, is not noticed.
+ *
+ * A checkpoint is only written if one of the first %UBI_CKPT_ANCHORS PEBs is
+ * free, which is nearly always the case unless the device is full.
+ */
+
+#include <linux/crc32.h>
+#include <linux/err.h>
+#include <asm/div64.h>
+#include "ubi.h"
+
+/* how many PEBs at the start of the device are looked at for a checkpoint */
+#define UBI_CKPT_ANCHORS 64
+
+static int ckpt_size(const struct ubi_device *ubi, int vol_count)
+{
+	return sizeof(struct ubi_ckpt_hdr) +
+	       vol_count * sizeof(struct ubi_ckpt_vol) +
+	       ubi->peb_count * sizeof(struct ubi_ckpt_peb);
+}
+
+/**
+ * ckpt_fill - describe the current state of the device in the checkpoint.
+ * @ubi: UBI device description object
+ * @buf: buffer of @ubi->leb_size bytes
+ *
+ * Has to be called with the WL sub-system quiet and no volume open for
+ * writing. Returns the size of the checkpoint, or a negative error code if
+ * the state cannot be described.
+ */
+static int ckpt_fill(struct ubi_device *ubi, void *buf)
+{
+	struct ubi_ckpt_hdr *hdr = buf;
+	struct ubi_ckpt_vol *cv;
+	struct ubi_ckpt_peb *cp;
+	struct ubi_wl_entry *e;
+	struct rb_node *rb;
+	int i, pnum, lnum, vol_count = 0, size;
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++)
+		if (ubi->volumes[i])
+			vol_count += 1;
+
+	size = ckpt_size(ubi, vol_count);
+	if (size > ubi->leb_size) {
+		dbg_msg("checkpoint of %d bytes does not fit", size);
+		return -ENOSPC;
+	}
+
+	memset(buf, 0, size);
+	cv = buf + sizeof(struct ubi_ckpt_hdr);
+	cp = (void *)(cv + vol_count);
+
+	/* everything starts as waiting for erasure, then gets refined */
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		e = ubi->lookuptbl[pnum];
+		if (e) {
+			cp[pnum].ec = cpu_to_be32(e->ec);
+			cp[pnum].vol_id = cpu_to_be32(UBI_CKPT_PEB_ERASE);
+		} else if (ubi_io_is_bad(ubi, pnum) > 0) {
+			cp[pnum].vol_id = cpu_to_be32(UBI_CKPT_PEB_BAD);
+		} else {
+			/* e.g. a "preserve" compatible internal volume */
+			dbg_msg("PEB %d is not known to the WL unit", pnum);
+			return -EINVAL;
+		}
+	}
+
+	spin_lock(&ubi->wl_lock);
+	ubi_rb_for_each_entry(rb, e, &ubi->free, rb)
+		cp[e->pnum].vol_id = cpu_to_be32(UBI_CKPT_PEB_FREE);
+	spin_unlock(&ubi->wl_lock);
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		struct ubi_volume *vol = ubi->volumes[i];
+
+		if (!vol)
+			continue;
+
+		cv->vol_id = cpu_to_be32(vol->vol_id);
+		cv->data_pad = cpu_to_be32(vol->data_pad);
+		if (vol->vol_type == UBI_DYNAMIC_VOLUME) {
+			cv->vol_type = UBI_VID_DYNAMIC;
+		} else {
+			cv->vol_type = UBI_VID_STATIC;
+			cv->used_ebs = cpu_to_be32(vol->used_ebs);
+			cv->last_eb_bytes = cpu_to_be32(vol->last_eb_bytes);
+		}
+		if (vol->vol_id == UBI_LAYOUT_VOLUME_ID)
+			cv->compat = UBI_LAYOUT_VOLUME_COMPAT;
+		cv += 1;
+
+		for (lnum = 0; lnum < vol->reserved_pebs; lnum++) {
+			pnum = vol->eba_tbl[lnum];
+			if (pnum < 0)
+				continue;
+
+			cp[pnum].vol_id = cpu_to_be32(vol->vol_id);
+			cp[pnum].lnum = cpu_to_be32(lnum);
+		}
+	}
+
+	hdr->magic = cpu_to_be32(UBI_CKPT_MAGIC);
+	hdr->version = UBI_VERSION;
+	hdr->peb_count = cpu_to_be32(ubi->peb_count);
+	hdr->vol_count = cpu_to_be32(vol_count);
+	hdr->vid_hdr_offset = cpu_to_be32(ubi->vid_hdr_offset);
+	hdr->leb_start = cpu_to_be32(ubi->leb_start);
+	hdr->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, hdr + 1,
+					  size - sizeof(struct ubi_ckpt_hdr)));
+
+	return size;
+}
+
+/**
+ * ubi_ckpt_write - write the attach checkpoint and stop writing to the device.
+ * @ubi: UBI device description object
+ *
+ * This function is called when the device is about to go away, either on
+ * detach or on reboot. Nothing is written if a volume is open for writing,
+ * because the checkpoint could not be kept up to date. Otherwise the device
+ * is switched to read-only mode once the checkpoint is on the flash, so that
+ * it stays valid.
+ */
+void ubi_ckpt_write(struct ubi_device *ubi)
+{
+	struct ubi_vid_hdr *vid_hdr;
+	struct ubi_wl_entry *e;
+	struct rb_node *rb;
+	int i, err, size, pnum = -1;
+
+	if (ubi->ro_mode)
+		return;
+
+	spin_lock(&ubi->volumes_lock);
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		struct ubi_volume *vol = ubi->volumes[i];
+
+		if (vol && (vol->writers || vol->exclusive)) {
+			spin_unlock(&ubi->volumes_lock);
+			dbg_msg("volume %d is open, no checkpoint", vol->vol_id);
+			return;
+		}
+	}
+	spin_unlock(&ubi->volumes_lock);
+
+	/* finish the pending erasures, so that there is less to describe */
+	err = ubi_wl_flush(ubi);
+	if (err)
+		return;
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr)
+		return;
+
+	/* keep the WL worker from moving anything from now on */
+	down_write(&ubi->work_sem);
+
+	spin_lock(&ubi->wl_lock);
+	ubi_rb_for_each_entry(rb, e, &ubi->free, rb)
+		if (e->pnum < UBI_CKPT_ANCHORS && (pnum < 0 || e->pnum < pnum))
+			pnum = e->pnum;
+	spin_unlock(&ubi->wl_lock);
+
+	if (pnum < 0) {
+		ubi_msg("no free PEB for the checkpoint");
+		goto out_unlock;
+	}
+
+	mutex_lock(&ubi->buf_mutex);
+	size = ckpt_fill(ubi, ubi->peb_buf1);
+	if (size < 0) {
+		mutex_unlock(&ubi->buf_mutex);
+		goto out_unlock;
+	}
+
+	vid_hdr->vol_type = UBI_CKPT_VOLUME_TYPE;
+	vid_hdr->compat = UBI_CKPT_VOLUME_COMPAT;
+	vid_hdr->vol_id = cpu_to_be32(UBI_CKPT_VOLUME_ID);
+	vid_hdr->lnum = 0;
+
+	spin_lock(&ubi->ltree_lock);
+	vid_hdr->sqnum = cpu_to_be64(ubi->global_sqnum);
+	((struct ubi_ckpt_hdr *)ubi->peb_buf1)->max_sqnum = vid_hdr->sqnum;
+	ubi->global_sqnum += 1;
+	spin_unlock(&ubi->ltree_lock);
+
+	((struct ubi_ckpt_hdr *)ubi->peb_buf1)->hdr_crc =
+		cpu_to_be32(crc32(UBI_CRC32_INIT, ubi->peb_buf1,
+				  UBI_CKPT_HDR_SIZE_CRC));
+
+	err = ubi_io_write_vid_hdr(ubi, pnum, vid_hdr);
+	if (!err)
+		err = ubi_io_write_data(ubi, ubi->peb_buf1, pnum, 0,
+					ALIGN(size, ubi->min_io_size));
+	if (err) {
+		ubi_warn("cannot write checkpoint to PEB %d, error %d",
+			 pnum, err);
+		goto out_unlock_buf;
+	}
+
+	ubi_msg("checkpoint written to PEB %d", pnum);
+
+out_unlock_buf:
+	/*
+	 * Even if writing failed the PEB may have been touched, and the WL
+	 * unit still thinks it is free, so nothing is to be written anymore.
+	 */
+	ubi->ro_mode = 1;
+	mutex_unlock(&ubi->buf_mutex);
+out_unlock:
+	up_write(&ubi->work_sem);
+	ubi_free_vid_hdr(ubi, vid_hdr);
+}
+
+/**
+ * ckpt_find - look for the checkpoint among the anchor PEBs.
+ * @ubi: UBI device description object
+ * @vid_hdr: buffer for the VID headers
+ *
+ * Returns the PEB number, or %-ENOENT if there is no checkpoint or more than
+ * one, which can only happen if an invalidation was interrupted.
+ */
+static int ckpt_find(struct ubi_device *ubi, struct ubi_vid_hdr *vid_hdr)
+{
+	int pnum, err, found = -ENOENT;
+
+	for (pnum = 0; pnum < UBI_CKPT_ANCHORS && pnum < ubi->peb_count;
+	     pnum++) {
+		if (ubi_io_is_bad(ubi, pnum))
+			continue;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+		if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		if (be32_to_cpu(vid_hdr->vol_id) != UBI_CKPT_VOLUME_ID)
+			continue;
+
+		if (found >= 0) {
+			ubi_warn("checkpoints in PEBs %d and %d", found, pnum);
+			return -ENOENT;
+		}
+		found = pnum;
+	}
+
+	return found;
+}
+
+/**
+ * ckpt_read - read and check the checkpoint.
+ * @ubi: UBI device description object
+ * @pnum: PEB holding the checkpoint
+ * @buf: buffer of @ubi->leb_size bytes
+ *
+ * Returns zero if the checkpoint is good and describes this device.
+ */
+static int ckpt_read(struct ubi_device *ubi, int pnum, void *buf)
+{
+	struct ubi_ckpt_hdr *hdr = buf;
+	int err, size, vol_count;
+	uint32_t crc;
+
+	err = ubi_io_read_data(ubi, buf, pnum, 0, ubi->min_io_size);
+	if (err && err != UBI_IO_BITFLIPS)
+		return err;
+
+	crc = crc32(UBI_CRC32_INIT, hdr, UBI_CKPT_HDR_SIZE_CRC);
+	if (be32_to_cpu(hdr->magic) != UBI_CKPT_MAGIC ||
+	    be32_to_cpu(hdr->hdr_crc) != crc || hdr->version != UBI_VERSION)
+		return -EINVAL;
+
+	if (be32_to_cpu(hdr->peb_count) != ubi->peb_count ||
+	    be32_to_cpu(hdr->vid_hdr_offset) != ubi->vid_hdr_offset ||
+	    be32_to_cpu(hdr->leb_start) != ubi->leb_start) {
+		dbg_msg("checkpoint is for a different geometry");
+		return -EINVAL;
+	}
+
+	vol_count = be32_to_cpu(hdr->vol_count);
+	if (vol_count > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT)
+		return -EINVAL;
+
+	size = ckpt_size(ubi, vol_count);
+	if (size > ubi->leb_size)
+		return -EINVAL;
+
+	err = ubi_io_read_data(ubi, buf, pnum, 0,
+			       ALIGN(size, ubi->min_io_size));
+	if (err && err != UBI_IO_BITFLIPS)
+		return err;
+
+	crc = crc32(UBI_CRC32_INIT, hdr + 1,
+		    size - sizeof(struct ubi_ckpt_hdr));
+	if (be32_to_cpu(hdr->data_crc) != crc)
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * ckpt_check_unused - check that an unused PEB has not changed since.
+ * @ubi: UBI device description object
+ * @pnum: PEB to check
+ * @ec: erase counter the checkpoint has for it
+ * @erase: the checkpoint has it waiting for erasure rather than free
+ * @vid_hdr: buffer for the VID header
+ * @ec_hdr: buffer for the EC header
+ *
+ * Returns zero if the PEB is as the checkpoint describes it, %-ESTALE if it
+ * has been written or erased since, or another negative error code.
+ */
+static int ckpt_check_unused(struct ubi_device *ubi, int pnum, int ec,
+			     int erase, struct ubi_vid_hdr *vid_hdr,
+			     struct ubi_ec_hdr *ec_hdr)
+{
+	int err;
+
+	if (!erase) {
+		err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+		if (err < 0)
+			return err;
+		if (err != UBI_IO_PEB_FREE) {
+			dbg_msg("free PEB %d has been written to", pnum);
+			return -ESTALE;
+		}
+		return 0;
+	}
+
+	err = ubi_io_read_ec_hdr(ubi, pnum, ec_hdr, 0);
+	if (err < 0)
+		return err;
+	if ((err == 0 || err == UBI_IO_BITFLIPS) &&
+	    be64_to_cpu(ec_hdr->ec) != ec) {
+		dbg_msg("PEB %d has been erased since", pnum);
+		return -ESTALE;
+	}
+
+	return 0;
+}
+
+static void ckpt_account_ec(struct ubi_scan_info *si, int ec)
+{
+	si->ec_sum += ec;
+	si->ec_count += 1;
+	if (ec > si->max_ec)
+		si->max_ec = ec;
+	if (ec < si->min_ec)
+		si->min_ec = ec;
+}
+
+/**
+ * ckpt_build_si - build the scanning information from the checkpoint.
+ * @ubi: UBI device description object
+ * @si: empty scanning information
+ * @buf: the checkpoint
+ * @anchor: PEB holding the checkpoint
+ * @vid_hdr: buffer for the made up VID headers
+ * @ec_hdr: buffer for the EC headers
+ *
+ * Returns zero on success, a negative error code if the checkpoint does not
+ * agree with the device.
+ */
+static int ckpt_build_si(struct ubi_device *ubi, struct ubi_scan_info *si,
+			 void *buf, int anchor, struct ubi_vid_hdr *vid_hdr,
+			 struct ubi_ec_hdr *ec_hdr)
+{
+	struct ubi_ckpt_hdr *hdr = buf;
+	struct ubi_ckpt_vol *cv = buf + sizeof(struct ubi_ckpt_hdr);
+	int vol_count = be32_to_cpu(hdr->vol_count);
+	struct ubi_ckpt_peb *cp = (void *)(cv + vol_count);
+	int pnum, i, err;
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		uint32_t vol_id = be32_to_cpu(cp[pnum].vol_id);
+		int ec = be32_to_cpu(cp[pnum].ec);
+		int lnum, bad;
+
+		bad = ubi_io_is_bad(ubi, pnum);
+		if (bad < 0)
+			return bad;
+		if (bad != (vol_id == UBI_CKPT_PEB_BAD)) {
+			dbg_msg("bad block state of PEB %d changed", pnum);
+			return -EINVAL;
+		}
+
+		if (bad) {
+			si->bad_peb_count += 1;
+			continue;
+		}
+
+		if (ec < 0 || (long long)ec >= UBI_MAX_ERASECOUNTER)
+			return -EINVAL;
+
+		/* it is erased before we are done, see ubi_ckpt_scan() */
+		if (pnum == anchor) {
+			ckpt_account_ec(si, ec + 1);
+			continue;
+		}
+
+		ckpt_account_ec(si, ec);
+
+		if (vol_id == UBI_CKPT_PEB_FREE || vol_id == UBI_CKPT_PEB_ERASE) {
+			err = ckpt_check_unused(ubi, pnum, ec,
+						vol_id == UBI_CKPT_PEB_ERASE,
+						vid_hdr, ec_hdr);
+			if (err)
+				return err;
+
+			err = ubi_scan_add_to_list(si, pnum, ec,
+						   vol_id == UBI_CKPT_PEB_ERASE);
+			if (err)
+				return err;
+			continue;
+		}
+
+		for (i = 0; i < vol_count; i++)
+			if (be32_to_cpu(cv[i].vol_id) == vol_id)
+				break;
+		if (i == vol_count)
+			return -EINVAL;
+
+		lnum = be32_to_cpu(cp[pnum].lnum);
+		if (lnum < 0)
+			return -EINVAL;
+
+		memset(vid_hdr, 0, UBI_VID_HDR_SIZE);
+		vid_hdr->vol_type = cv[i].vol_type;
+		vid_hdr->compat = cv[i].compat;
+		vid_hdr->vol_id = cp[pnum].vol_id;
+		vid_hdr->lnum = cp[pnum].lnum;
+		vid_hdr->data_pad = cv[i].data_pad;
+		if (cv[i].vol_type == UBI_VID_STATIC) {
+			int used_ebs = be32_to_cpu(cv[i].used_ebs);
+			int data_pad = be32_to_cpu(cv[i].data_pad);
+
+			vid_hdr->used_ebs = cv[i].used_ebs;
+			if (lnum == used_ebs - 1)
+				vid_hdr->data_size = cv[i].last_eb_bytes;
+			else
+				vid_hdr->data_size =
+					cpu_to_be32(ubi->leb_size - data_pad);
+		}
+
+		err = ubi_scan_add_used(ubi, si, pnum, ec, vid_hdr, 0);
+		if (err)
+			return err;
+	}
+
+	si->is_empty = 0;
+	si->max_sqnum = be64_to_cpu(hdr->max_sqnum);
+	if (si->ec_count) {
+		do_div(si->ec_sum, si->ec_count);
+		si->mean_ec = si->ec_sum;
+	}
+
+	return 0;
+}
+
+/**
+ * ubi_ckpt_scan - attach using the checkpoint.
+ * @ubi: UBI device description object
+ *
+ * Returns the scanning information, as 'ubi_scan()' would, or %NULL if the
+ * device has to be scanned.
+ */
+struct ubi_scan_info *ubi_ckpt_scan(struct ubi_device *ubi)
+{
+	struct ubi_scan_info *si;
+	struct ubi_vid_hdr *vid_hdr;
+	struct ubi_ec_hdr *ec_hdr;
+	struct ubi_ckpt_peb *cp;
+	int err, anchor, ec;
+
+	ec_hdr = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	if (!ec_hdr)
+		return NULL;
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr)
+		goto out_ec_hdr;
+
+	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
+	if (!si)
+		goto out_vid_hdr;
+
+	INIT_LIST_HEAD(&si->corr);
+	INIT_LIST_HEAD(&si->free);
+	INIT_LIST_HEAD(&si->erase);
+	INIT_LIST_HEAD(&si->alien);
+	si->volumes = RB_ROOT;
+	si->min_ec = UBI_MAX_ERASECOUNTER;
+
+	anchor = ckpt_find(ubi, vid_hdr);
+	if (anchor < 0)
+		goto out_si;
+
+	mutex_lock(&ubi->buf_mutex);
+	err = ckpt_read(ubi, anchor, ubi->peb_buf1);
+	if (!err)
+		err = ckpt_build_si(ubi, si, ubi->peb_buf1, anchor, vid_hdr,
+				    ec_hdr);
+	if (err) {
+		mutex_unlock(&ubi->buf_mutex);
+		ubi_warn("checkpoint in PEB %d is not usable, error %d",
+			 anchor, err);
+		goto out_si;
+	}
+
+	cp = ubi->peb_buf1 + sizeof(struct ubi_ckpt_hdr) +
+	     be32_to_cpu(((struct ubi_ckpt_hdr *)ubi->peb_buf1)->vol_count) *
+	     sizeof(struct ubi_ckpt_vol);
+	ec = be32_to_cpu(cp[anchor].ec) + 1;
+	mutex_unlock(&ubi->buf_mutex);
+
+	/*
+	 * From here on the device is going to change, so the checkpoint has to
+	 * go before anything else is written.
+	 */
+	err = ubi_scan_erase_peb(ubi, si, anchor, ec);
+	if (err) {
+		ubi_warn("cannot erase checkpoint in PEB %d, error %d",
+			 anchor, err);
+		goto out_si;
+	}
+
+	err = ubi_scan_add_to_list(si, anchor, ec, 0);
+	if (err)
+		goto out_si;
+
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	kfree(ec_hdr);
+	ubi_msg("attached using the checkpoint in PEB %d", anchor);
+	return si;
+
+out_si:
+	ubi_scan_destroy_si(si);
+out_vid_hdr:
+	ubi_free_vid_hdr(ubi, vid_hdr);
+out_ec_hdr:
+	kfree(ec_hdr);
+	return NULL;
+}
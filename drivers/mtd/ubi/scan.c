@@ -92,6 +92,58 @@ static int add_to_list(struct ubi_scan_info *si, int pnum, int ec,
 	return 0;
 }
 
+/**
+ * ubi_scan_add_to_list - add a free or to be erased PEB to scanning info.
+ * @si: scanning information
+ * @pnum: physical eraseblock number to add
+ * @ec: erase counter of the physical eraseblock
+ * @erase: add to the erase list rather than to the free list
+ *
+ * This is used when the scanning information is built from somewhere else
+ * than the flash headers, see ckpt.c. Returns zero in case of success and a
+ * negative error code in case of failure.
+ */
+int ubi_scan_add_to_list(struct ubi_scan_info *si, int pnum, int ec,
+			 int erase)
+{
+	return add_to_list(si, pnum, ec, erase ? &si->erase : &si->free);
+}
+
+/**
+ * drop_ckpt - erase a stale attach checkpoint.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ * @pnum: PEB holding the checkpoint
+ * @ec: erase counter of the PEB, or %UBI_SCAN_UNKNOWN_EC
+ *
+ * A checkpoint found by scanning describes the device as it was before this
+ * attach. Left for the WL unit to erase in the background, it would still be
+ * there if the power went after the first writes, and the next attach would
+ * take it as valid. So it is erased right away, and if that fails nothing is
+ * written to the device at all. Returns zero in case of success and a negative
+ * error code in case of failure.
+ */
+static int drop_ckpt(struct ubi_device *ubi, struct ubi_scan_info *si,
+		     int pnum, int ec)
+{
+	int err;
+
+	if (ec != UBI_SCAN_UNKNOWN_EC) {
+		err = ubi_scan_erase_peb(ubi, si, pnum, ec + 1);
+		if (!err)
+			return add_to_list(si, pnum, ec + 1, &si->free);
+	} else {
+		err = ubi_io_sync_erase(ubi, pnum, 0);
+		if (err >= 0)
+			return add_to_list(si, pnum, ec, &si->erase);
+	}
+
+	ubi_warn("cannot erase checkpoint in PEB %d, error %d, switch to "
+		 "read-only mode", pnum, err);
+	ubi->ro_mode = 1;
+	return add_to_list(si, pnum, ec, &si->corr);
+}
+
 /**
  * validate_vid_hdr - check volume identifier header.
  * @vid_hdr: the volume identifier header to check
@@ -811,6 +863,12 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 		case UBI_COMPAT_DELETE:
 			ubi_msg("\"delete\" compatible internal volume %d:%d"
 				" found, remove it", vol_id, lnum);
+			if (vol_id == UBI_CKPT_VOLUME_ID) {
+				err = drop_ckpt(ubi, si, pnum, ec);
+				if (err)
+					return err;
+				goto adjust_mean_ec;
+			}
 			err = add_to_list(si, pnum, ec, &si->corr);
 			if (err)
 				return err;
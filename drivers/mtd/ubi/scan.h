@@ -147,6 +147,8 @@ static inline void ubi_scan_move_to_list(struct ubi_scan_volume *sv,
 int ubi_scan_add_used(struct ubi_device *ubi, struct ubi_scan_info *si,
 		      int pnum, int ec, const struct ubi_vid_hdr *vid_hdr,
 		      int bitflips);
+int ubi_scan_add_to_list(struct ubi_scan_info *si, int pnum, int ec,
+			 int erase);
 struct ubi_scan_volume *ubi_scan_find_sv(const struct ubi_scan_info *si,
 					 int vol_id);
 struct ubi_scan_leb *ubi_scan_find_seb(const struct ubi_scan_volume *sv,
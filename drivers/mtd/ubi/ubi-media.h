@@ -302,6 +302,20 @@ struct ubi_vid_hdr {
 #define UBI_LAYOUT_VOLUME_NAME   "layout volume"
 #define UBI_LAYOUT_VOLUME_COMPAT UBI_COMPAT_REJECT
 
+/*
+ * The checkpoint volume holds the attach information written when the device
+ * was last detached, see ckpt.c. It is not counted in %UBI_INT_VOL_COUNT
+ * because it is never attached as a volume, and it is "delete" compatible so
+ * that scanning, or an implementation which does not know it, drops it.
+ */
+
+#define UBI_CKPT_VOLUME_ID       (UBI_INTERNAL_VOL_START + 1)
+#define UBI_CKPT_VOLUME_TYPE     UBI_VID_DYNAMIC
+#define UBI_CKPT_VOLUME_COMPAT   UBI_COMPAT_DELETE
+
+/* Checkpoint magic number (ASCII "UBI@") */
+#define UBI_CKPT_MAGIC 0x55424940
+
 /* The maximum number of volumes per one UBI device */
 #define UBI_MAX_VOLUMES 128
 
@@ -365,4 +379,80 @@ struct ubi_vtbl_record {
 	__be32  crc;
 } __attribute__ ((packed));
 
+/* Size of the checkpoint header without the ending CRC */
+#define UBI_CKPT_HDR_SIZE_CRC (sizeof(struct ubi_ckpt_hdr) - sizeof(__be32))
+
+/**
+ * struct ubi_ckpt_hdr - checkpoint header.
+ * @magic: checkpoint magic number (%UBI_CKPT_MAGIC)
+ * @version: version of the checkpoint format (%UBI_VERSION)
+ * @padding1: reserved for future, zeroes
+ * @peb_count: number of physical eraseblocks described
+ * @vol_count: number of &struct ubi_ckpt_vol records
+ * @vid_hdr_offset: VID header offset the device was attached with
+ * @leb_start: data offset the device was attached with
+ * @max_sqnum: the highest sequence number in use when the checkpoint was made
+ * @data_crc: CRC checksum of the records which follow the header
+ * @padding2: reserved for future, zeroes
+ * @hdr_crc: checkpoint header CRC checksum
+ *
+ * The checkpoint is stored at the start of the only logical eraseblock of the
+ * checkpoint volume. The header is followed by @vol_count volume records and
+ * then by @peb_count physical eraseblock records, indexed by PEB number.
+ */
+struct ubi_ckpt_hdr {
+	__be32  magic;
+	__u8    version;
+	__u8    padding1[3];
+	__be32  peb_count;
+	__be32  vol_count;
+	__be32  vid_hdr_offset;
+	__be32  leb_start;
+	__be64  max_sqnum;
+	__be32  data_crc;
+	__u8    padding2[20];
+	__be32  hdr_crc;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_ckpt_vol - volume record in the checkpoint.
+ * @vol_id: volume ID
+ * @used_ebs: number of used logical eraseblocks (static volumes only)
+ * @last_eb_bytes: bytes in the last used logical eraseblock (static only)
+ * @data_pad: bytes unused at the end of each logical eraseblock
+ * @vol_type: volume type (%UBI_VID_DYNAMIC or %UBI_VID_STATIC)
+ * @compat: compatibility flags of the volume
+ * @padding: reserved for future, zeroes
+ */
+struct ubi_ckpt_vol {
+	__be32  vol_id;
+	__be32  used_ebs;
+	__be32  last_eb_bytes;
+	__be32  data_pad;
+	__u8    vol_type;
+	__u8    compat;
+	__u8    padding[2];
+} __attribute__ ((packed));
+
+/*
+ * Values of @vol_id in &struct ubi_ckpt_peb for physical eraseblocks which do
+ * not belong to a volume.
+ */
+#define UBI_CKPT_PEB_FREE  0xFFFFFFFFU
+#define UBI_CKPT_PEB_ERASE 0xFFFFFFFEU
+#define UBI_CKPT_PEB_BAD   0xFFFFFFFDU
+
+/**
+ * struct ubi_ckpt_peb - physical eraseblock record in the checkpoint.
+ * @ec: erase counter
+ * @vol_id: volume the PEB is mapped to, or one of %UBI_CKPT_PEB_FREE,
+ *          %UBI_CKPT_PEB_ERASE or %UBI_CKPT_PEB_BAD
+ * @lnum: logical eraseblock number within @vol_id
+ */
+struct ubi_ckpt_peb {
+	__be32  ec;
+	__be32  vol_id;
+	__be32  lnum;
+} __attribute__ ((packed));
+
 #endif /* !__UBI_MEDIA_H__ */
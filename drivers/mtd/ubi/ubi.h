@@ -490,6 +490,15 @@ void ubi_gluebi_updated(struct ubi_volume *vol);
 #define ubi_gluebi_updated(vol)
 #endif
 
+/* ckpt.c */
+#ifdef CONFIG_MTD_UBI_CKPT
+struct ubi_scan_info *ubi_ckpt_scan(struct ubi_device *ubi);
+void ubi_ckpt_write(struct ubi_device *ubi);
+#else
+#define ubi_ckpt_scan(ubi) NULL
+#define ubi_ckpt_write(ubi)
+#endif
+
 /* eba.c */
 int ubi_eba_unmap_leb(struct ubi_device *ubi, struct ubi_volume *vol,
 		      int lnum);
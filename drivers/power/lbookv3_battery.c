@@ -21,6 +21,7 @@
 
 #include <mach/regs-gpio.h>
 #include <asm/plat-s3c/regs-adc.h>
+#include <asm/plat-s3c24xx/clock-idle.h>
 #include <mach/io.h>
 #include <asm/mach/map.h>
 #include <asm/io.h>
@@ -45,17 +46,22 @@ static struct clk* adc_clk;
 #define LBOOK_V3_MIN_VOLT 3150
 #define LBOOK_V3_5PERC_VOLT 3540
 
+/* the ADC clock is gated after this much idle time */
+#define ADC_IDLE_TIMEOUT_MS 100
+
 static unsigned int adc_get_val (unsigned int ch)
 {
 	int wait = 0xffff;
+	unsigned int val = 0;
 	ch &= 0x07;
 	ch <<= 3;
+	s3c24xx_clk_active_get(adc_clk);
 	__raw_writel(0x4c41 | ch, adc_base);
 	while (((__raw_readl(adc_base) & 0x8000) == 0) && (--wait != 0));
-	if (wait == 0)
-		return 0;
-	else
-		return (__raw_readl(adc_base+0xc) & 0x3ff);
+	if (wait != 0)
+		val = __raw_readl(adc_base+0xc) & 0x3ff;
+	s3c24xx_clk_active_put(adc_clk);
+	return val;
 }
 
 static int lbookv3_battery_get_voltage(struct power_supply *b)
@@ -242,6 +248,7 @@ static int s3c2410_adc_init(void)
 
 	__raw_writel(0x00, adc_base + 0x04);
 	__raw_writel(0x00, adc_base + 0x08);
+	s3c24xx_clk_idle_init(adc_clk, ADC_IDLE_TIMEOUT_MS);
 	return 0;
 err2:
 	clk_put(adc_clk);
@@ -359,15 +366,19 @@ static int lbookv3_battery_remove(struct platform_device *dev)
 #ifdef CONFIG_PM
 static int lbookv3_battery_suspend(struct platform_device *pdev, pm_message_t message)
 {
+	s3c24xx_clk_active_get(adc_clk);
 	__raw_writel(__raw_readl(adc_base + S3C2410_ADCCON) |
 			S3C2410_ADCCON_STDBM, adc_base + S3C2410_ADCCON);
+	s3c24xx_clk_active_put(adc_clk);
 	return 0;
 }
 
 static int lbookv3_battery_resume(struct platform_device *pdev)
 {
+	s3c24xx_clk_active_get(adc_clk);
 	__raw_writel(__raw_readl(adc_base + S3C2410_ADCCON) ^
 			S3C2410_ADCCON_STDBM, adc_base + S3C2410_ADCCON);
+	s3c24xx_clk_active_put(adc_clk);
 	return 0;
 }
 
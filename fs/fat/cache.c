@@ -15,6 +15,14 @@
 /* this must be > 0. */
 #define FAT_MAX_CACHE	8
 
+/*
+ * Large files get one cache entry per fragment, up to this many, so a
+ * seek within a book does not have to walk the FAT chain from the last
+ * place it was read at.
+ */
+#define FAT_MAX_CACHE_LARGE	256
+#define FAT_LARGE_FILE		(1 << 20)
+
 struct fat_cache {
 	struct list_head cache_list;
 	int nr_contig;	/* number of contiguous clusters */
@@ -31,6 +39,8 @@ struct fat_cache_id {
 
 static inline int fat_max_cache(struct inode *inode)
 {
+	if (i_size_read(inode) >= FAT_LARGE_FILE)
+		return FAT_MAX_CACHE_LARGE;
 	return FAT_MAX_CACHE;
 }
 
@@ -220,7 +230,7 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 	const int limit = sb->s_maxbytes >> MSDOS_SB(sb)->cluster_bits;
 	struct fat_entry fatent;
 	struct fat_cache_id cid;
-	int nr;
+	int nr, extents;
 
 	BUG_ON(MSDOS_I(inode)->i_start == 0);
 
@@ -237,6 +247,9 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		cache_init(&cid, -1, -1);
 	}
 
+	/* remember every fragment passed on the way when there is room */
+	extents = fat_max_cache(inode) > FAT_MAX_CACHE;
+
 	fatent_init(&fatent);
 	while (*fclus < cluster) {
 		/* prevent the infinite loop of cluster chain */
@@ -263,8 +276,13 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		}
 		(*fclus)++;
 		*dclus = nr;
-		if (!cache_contiguous(&cid, *dclus))
+		if (!cache_contiguous(&cid, *dclus)) {
+			if (extents) {
+				cid.nr_contig--;
+				fat_cache_add(inode, &cid);
+			}
 			cache_init(&cid, *fclus, *dclus);
+		}
 	}
 	nr = 0;
 	fat_cache_add(inode, &cid);
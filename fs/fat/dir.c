@@ -20,6 +20,8 @@
 #include <linux/smp_lock.h>
 #include <linux/buffer_head.h>
 #include <linux/compat.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 #include <asm/uaccess.h>
 
 static inline loff_t fat_make_i_pos(struct super_block *sb,
@@ -338,41 +340,40 @@ parse_long:
 #define FAT_MAX_UNI_SIZE	(FAT_MAX_UNI_CHARS * sizeof(wchar_t))
 
 /*
- * Return values: negative -> error, 0 -> not found, positive -> found,
- * value is the total amount of slots, including the shortname entry.
+ * Decode the next record of the directory from *cpos on, into its short
+ * name and, if it has one, its long name, both in the io charset.
+ * Returns the number of long name slots, -ENOENT at the end of the
+ * directory or another negative error.
  */
-int fat_search_long(struct inode *inode, const unsigned char *name,
-		    int name_len, struct fat_slot_info *sinfo)
+static int fat_next_names(struct inode *inode, loff_t *cpos,
+			  struct buffer_head **bh, struct msdos_dir_entry **de,
+			  wchar_t **unicode, unsigned char *shortname,
+			  int *short_len, unsigned char **longname,
+			  int *long_len)
 {
 	struct super_block *sb = inode->i_sb;
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
-	struct buffer_head *bh = NULL;
-	struct msdos_dir_entry *de;
 	struct nls_table *nls_disk = sbi->nls_disk;
 	unsigned char nr_slots;
 	wchar_t bufuname[14];
-	wchar_t *unicode = NULL;
 	unsigned char work[MSDOS_NAME];
-	unsigned char bufname[FAT_MAX_SHORT_SIZE];
 	unsigned short opt_shortname = sbi->options.shortname;
-	loff_t cpos = 0;
-	int chl, i, j, last_u, err, len;
+	int chl, i, j, last_u;
 
-	err = -ENOENT;
 	while (1) {
-		if (fat_get_entry(inode, &cpos, &bh, &de) == -1)
-			goto end_of_dir;
+		if (fat_get_entry(inode, cpos, bh, de) == -1)
+			return -ENOENT;
 parse_record:
 		nr_slots = 0;
-		if (de->name[0] == DELETED_FLAG)
+		if ((*de)->name[0] == DELETED_FLAG)
 			continue;
-		if (de->attr != ATTR_EXT && (de->attr & ATTR_VOLUME))
+		if ((*de)->attr != ATTR_EXT && ((*de)->attr & ATTR_VOLUME))
 			continue;
-		if (de->attr != ATTR_EXT && IS_FREE(de->name))
+		if ((*de)->attr != ATTR_EXT && IS_FREE((*de)->name))
 			continue;
-		if (de->attr == ATTR_EXT) {
-			int status = fat_parse_long(inode, &cpos, &bh, &de,
-						    &unicode, &nr_slots);
+		if ((*de)->attr == ATTR_EXT) {
+			int status = fat_parse_long(inode, cpos, bh, de,
+						    unicode, &nr_slots);
 			if (status < 0)
 				return status;
 			else if (status == PARSE_INVALID)
@@ -380,10 +381,10 @@ parse_record:
 			else if (status == PARSE_NOT_LONGNAME)
 				goto parse_record;
 			else if (status == PARSE_EOF)
-				goto end_of_dir;
+				return -ENOENT;
 		}
 
-		memcpy(work, de->name, sizeof(de->name));
+		memcpy(work, (*de)->name, sizeof((*de)->name));
 		/* see namei.c, msdos_format_name */
 		if (work[0] == 0x05)
 			work[0] = 0xE5;
@@ -392,7 +393,7 @@ parse_record:
 				break;
 			chl = fat_shortname2uni(nls_disk, &work[i], 8 - i,
 						&bufuname[j++], opt_shortname,
-						de->lcase & CASE_LOWER_BASE);
+						(*de)->lcase & CASE_LOWER_BASE);
 			if (chl <= 1) {
 				if (work[i] != ' ')
 					last_u = j;
@@ -409,7 +410,7 @@ parse_record:
 			chl = fat_shortname2uni(nls_disk, &work[i],
 						MSDOS_NAME - i,
 						&bufuname[j++], opt_shortname,
-						de->lcase & CASE_LOWER_EXT);
+						(*de)->lcase & CASE_LOWER_EXT);
 			if (chl <= 1) {
 				if (work[i] != ' ')
 					last_u = j;
@@ -421,21 +422,288 @@ parse_record:
 		if (!last_u)
 			continue;
 
-		/* Compare shortname */
 		bufuname[last_u] = 0x0000;
-		len = fat_uni_to_x8(sbi, bufuname, bufname, sizeof(bufname));
-		if (fat_name_match(sbi, name, name_len, bufname, len))
-			goto found;
+		*short_len = fat_uni_to_x8(sbi, bufuname, shortname,
+					   FAT_MAX_SHORT_SIZE);
 
+		*long_len = 0;
 		if (nr_slots) {
-			void *longname = unicode + FAT_MAX_UNI_CHARS;
-			int size = PATH_MAX - FAT_MAX_UNI_SIZE;
+			*longname = (unsigned char *)(*unicode + FAT_MAX_UNI_CHARS);
+			*long_len = fat_uni_to_x8(sbi, *unicode, *longname,
+						  PATH_MAX - FAT_MAX_UNI_SIZE);
+		}
 
-			/* Compare longname */
-			len = fat_uni_to_x8(sbi, unicode, longname, size);
-			if (fat_name_match(sbi, name, name_len, longname, len))
-				goto found;
+		return nr_slots;
+	}
+}
+
+/*
+ * Name hash of a directory
+ *
+ * A lookup in a directory holding thousands of books has to convert and
+ * compare every name before it. Once a directory has been searched twice
+ * without being changed in between, every short and long name in it is
+ * hashed, with the offset of its record, so later lookups only look at
+ * the records whose hash matches. Adding or removing entries drops the
+ * hash. All of this runs under lock_super(), as do the lookups and the
+ * changes to the directory.
+ */
+
+/* small directories are quicker to search than to hash */
+#define FAT_DIRHASH_MIN		64
+#define FAT_DIRHASH_END		(~0U)
+
+struct fat_dirhash_ent {
+	u32		hash;
+	u32		next;
+	u32		pos;		/* offset of the first slot */
+};
+
+struct fat_dirhash {
+	unsigned int		mask;
+	u32			*buckets;
+	unsigned int		nr_ents;
+	struct fat_dirhash_ent	ents[0];
+};
+
+static u32 fat_name_hash(struct msdos_sb_info *sbi,
+			 const unsigned char *name, int len)
+{
+	unsigned long hash = init_name_hash();
+
+	/* must agree with fat_name_match() */
+	if (sbi->options.name_check != 's') {
+		while (len--)
+			hash = partial_name_hash(nls_tolower(sbi->nls_io,
+							     *name++), hash);
+	} else {
+		while (len--)
+			hash = partial_name_hash(*name++, hash);
+	}
+
+	return end_name_hash(hash);
+}
+
+void fat_dirhash_inval(struct inode *dir)
+{
+	struct msdos_inode_info *i = MSDOS_I(dir);
+
+	if (i->i_dirhash) {
+		vfree(i->i_dirhash->buckets);
+		vfree(i->i_dirhash);
+		i->i_dirhash = NULL;
+	}
+	i->i_dirhash_scans = 0;
+}
+
+static struct fat_dirhash *fat_dirhash_grow(struct fat_dirhash *dh,
+					    unsigned int *max_ents)
+{
+	struct fat_dirhash *new;
+	unsigned int max = *max_ents ? *max_ents * 2 : 256;
+
+	new = vmalloc(sizeof(*new) + max * sizeof(new->ents[0]));
+	if (!new)
+		goto out;
+
+	if (dh) {
+		memcpy(new, dh, sizeof(*dh) + dh->nr_ents * sizeof(dh->ents[0]));
+		vfree(dh);
+	} else {
+		new->nr_ents = 0;
+	}
+	*max_ents = max;
+	return new;
+
+ out:
+	vfree(dh);
+	return NULL;
+}
+
+static int fat_dirhash_add(struct fat_dirhash **dh, unsigned int *max_ents,
+			   struct msdos_sb_info *sbi, loff_t pos,
+			   const unsigned char *name, int len)
+{
+	struct fat_dirhash_ent *ent;
+
+	if ((*dh)->nr_ents == *max_ents) {
+		*dh = fat_dirhash_grow(*dh, max_ents);
+		if (!*dh)
+			return -ENOMEM;
+	}
+
+	ent = &(*dh)->ents[(*dh)->nr_ents++];
+	ent->hash = fat_name_hash(sbi, name, len);
+	ent->pos = pos;
+	return 0;
+}
+
+static void fat_dirhash_build(struct inode *dir)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(dir->i_sb);
+	struct fat_dirhash *dh;
+	struct buffer_head *bh = NULL;
+	struct msdos_dir_entry *de = NULL;
+	wchar_t *unicode = NULL;
+	unsigned char shortname[FAT_MAX_SHORT_SIZE], *longname;
+	int short_len, long_len, nr_slots;
+	unsigned int max_ents = 0, nr_buckets, i;
+	loff_t cpos = 0, pos;
+
+	dh = fat_dirhash_grow(NULL, &max_ents);
+	if (!dh)
+		return;
+
+	while (1) {
+		nr_slots = fat_next_names(dir, &cpos, &bh, &de, &unicode,
+					  shortname, &short_len,
+					  &longname, &long_len);
+		if (nr_slots == -ENOENT)
+			break;
+		if (nr_slots < 0)
+			goto out_free;	/* the buffer is gone already */
+
+		pos = cpos - (nr_slots + 1) * sizeof(*de);
+
+		if (fat_dirhash_add(&dh, &max_ents, sbi, pos,
+				    shortname, short_len))
+			goto err;
+		if (long_len && fat_dirhash_add(&dh, &max_ents, sbi, pos,
+						longname, long_len))
+			goto err;
+	}
+
+	if (dh->nr_ents < FAT_DIRHASH_MIN)
+		goto out_free;
+
+	nr_buckets = roundup_pow_of_two(dh->nr_ents);
+	dh->buckets = vmalloc(nr_buckets * sizeof(u32));
+	if (!dh->buckets)
+		goto out_free;
+
+	dh->mask = nr_buckets - 1;
+	for (i = 0; i < nr_buckets; i++)
+		dh->buckets[i] = FAT_DIRHASH_END;
+
+	for (i = 0; i < dh->nr_ents; i++) {
+		u32 *bucket = &dh->buckets[dh->ents[i].hash & dh->mask];
+
+		dh->ents[i].next = *bucket;
+		*bucket = i;
+	}
+
+	MSDOS_I(dir)->i_dirhash = dh;
+	goto out;
+
+ err:
+	brelse(bh);
+ out_free:
+	vfree(dh);
+ out:
+	if (unicode)
+		__putname(unicode);
+}
+
+static int fat_search_hashed(struct inode *inode, const unsigned char *name,
+			     int name_len, struct fat_slot_info *sinfo)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(inode->i_sb);
+	struct fat_dirhash *dh = MSDOS_I(inode)->i_dirhash;
+	struct buffer_head *bh = NULL;
+	struct msdos_dir_entry *de;
+	wchar_t *unicode = NULL;
+	unsigned char shortname[FAT_MAX_SHORT_SIZE], *longname;
+	int short_len, long_len, nr_slots;
+	loff_t cpos;
+	u32 hash, i;
+	int err = -ENOENT;
+
+	hash = fat_name_hash(sbi, name, name_len);
+
+	for (i = dh->buckets[hash & dh->mask]; i != FAT_DIRHASH_END;
+	     i = dh->ents[i].next) {
+		if (dh->ents[i].hash != hash)
+			continue;
+
+		/* not the entry after the last one, so read it afresh */
+		cpos = dh->ents[i].pos;
+		de = NULL;
+
+		nr_slots = fat_next_names(inode, &cpos, &bh, &de, &unicode,
+					  shortname, &short_len,
+					  &longname, &long_len);
+		if (nr_slots == -ENOENT)
+			continue;
+		if (nr_slots < 0) {
+			err = nr_slots;
+			goto out;
+		}
+
+		if (fat_name_match(sbi, name, name_len, shortname, short_len) ||
+		    (long_len && fat_name_match(sbi, name, name_len,
+						longname, long_len))) {
+			nr_slots++;	/* include the de */
+			sinfo->slot_off = cpos - nr_slots * sizeof(*de);
+			sinfo->nr_slots = nr_slots;
+			sinfo->de = de;
+			sinfo->bh = bh;
+			sinfo->i_pos = fat_make_i_pos(inode->i_sb, bh, de);
+			err = 0;
+			goto out;
+		}
+	}
+
+	brelse(bh);
+ out:
+	if (unicode)
+		__putname(unicode);
+
+	return err;
+}
+
+/*
+ * Return values: negative -> error, 0 -> not found, positive -> found,
+ * value is the total amount of slots, including the shortname entry.
+ */
+int fat_search_long(struct inode *inode, const unsigned char *name,
+		    int name_len, struct fat_slot_info *sinfo)
+{
+	struct super_block *sb = inode->i_sb;
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct msdos_inode_info *i = MSDOS_I(inode);
+	struct buffer_head *bh = NULL;
+	struct msdos_dir_entry *de = NULL;
+	wchar_t *unicode = NULL;
+	unsigned char shortname[FAT_MAX_SHORT_SIZE], *longname;
+	int short_len, long_len, nr_slots;
+	loff_t cpos = 0;
+	int err;
+
+	/* not worth it while the directory is being filled, and only
+	 * tried once until it changes */
+	if (!i->i_dirhash && i->i_dirhash_scans++ == 1)
+		fat_dirhash_build(inode);
+
+	if (i->i_dirhash)
+		return fat_search_hashed(inode, name, name_len, sinfo);
+
+	while (1) {
+		nr_slots = fat_next_names(inode, &cpos, &bh, &de, &unicode,
+					  shortname, &short_len,
+					  &longname, &long_len);
+		if (nr_slots < 0) {
+			err = nr_slots;
+			goto end_of_dir;
 		}
+
+		/* Compare shortname */
+		if (fat_name_match(sbi, name, name_len, shortname, short_len))
+			goto found;
+
+		/* Compare longname */
+		if (long_len && fat_name_match(sbi, name, name_len,
+					       longname, long_len))
+			goto found;
 	}
 
 found:
@@ -985,6 +1253,8 @@ int fat_remove_entries(struct inode *dir, struct fat_slot_info *sinfo)
 	struct buffer_head *bh;
 	int err = 0, nr_slots;
 
+	fat_dirhash_inval(dir);
+
 	/*
 	 * First stage: Remove the shortname. By this, the directory
 	 * entry is removed.
@@ -1233,6 +1503,8 @@ int fat_add_entries(struct inode *dir, void *slots, int nr_slots,
 	int err, free_slots, i, nr_bhs;
 	loff_t pos, i_pos;
 
+	fat_dirhash_inval(dir);
+
 	sinfo->nr_slots = nr_slots;
 
 	/* First stage: search free direcotry entries */
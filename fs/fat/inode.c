@@ -450,6 +450,8 @@ static void fat_clear_inode(struct inode *inode)
 	fat_cache_inval_inode(inode);
 	hlist_del_init(&MSDOS_I(inode)->i_fat_hash);
 	spin_unlock(&sbi->inode_hash_lock);
+
+	fat_dirhash_inval(inode);
 }
 
 static void fat_write_super(struct super_block *sb)
@@ -490,6 +492,8 @@ static struct inode *fat_alloc_inode(struct super_block *sb)
 	ei = kmem_cache_alloc(fat_inode_cachep, GFP_NOFS);
 	if (!ei)
 		return NULL;
+	ei->i_dirhash = NULL;
+	ei->i_dirhash_scans = 0;
 	return &ei->vfs_inode;
 }
 
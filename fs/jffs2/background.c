@@ -23,7 +23,7 @@ static int jffs2_garbage_collect_thread(void *);
 void jffs2_garbage_collect_trigger(struct jffs2_sb_info *c)
 {
 	spin_lock(&c->erase_completion_lock);
-	if (c->gc_task && jffs2_thread_should_wake(c))
+	if (c->gc_task && (jffs2_thread_should_wake(c) || jffs2_gc_sched_kick(c)))
 		send_sig(SIGHUP, c->gc_task, 1);
 	spin_unlock(&c->erase_completion_lock);
 }
@@ -70,6 +70,8 @@ void jffs2_stop_garbage_collect_thread(struct jffs2_sb_info *c)
 static int jffs2_garbage_collect_thread(void *_c)
 {
 	struct jffs2_sb_info *c = _c;
+	long timeout;
+	int ret;
 
 	daemonize("jffs2_gcd_mtd%d", c->mtd->index);
 	allow_signal(SIGKILL);
@@ -85,14 +87,15 @@ static int jffs2_garbage_collect_thread(void *_c)
 	for (;;) {
 		allow_signal(SIGHUP);
 	again:
-		if (!jffs2_thread_should_wake(c)) {
+		if (!jffs2_thread_should_wake(c) &&
+		    (timeout = jffs2_gc_sched_timeout(c))) {
 			set_current_state (TASK_INTERRUPTIBLE);
 			D1(printk(KERN_DEBUG "jffs2_garbage_collect_thread sleeping...\n"));
 			/* Yes, there's a race here; we checked jffs2_thread_should_wake()
 			   before setting current->state to TASK_INTERRUPTIBLE. But it doesn't
 			   matter - We don't care if we miss a wakeup, because the GC thread
 			   is only an optimisation anyway. */
-			schedule();
+			schedule_timeout(timeout);
 		}
 
 		/* This thread is purely an optimisation. But if it runs when
@@ -135,8 +138,14 @@ static int jffs2_garbage_collect_thread(void *_c)
 		/* We don't want SIGHUP to interrupt us. STOP and KILL are OK though. */
 		disallow_signal(SIGHUP);
 
+		/* Woken up for idle GC, but the system isn't idle (any more) */
+		if (!jffs2_gc_sched_begin(c))
+			continue;
+
 		D1(printk(KERN_DEBUG "jffs2_garbage_collect_thread(): pass\n"));
-		if (jffs2_garbage_collect_pass(c) == -ENOSPC) {
+		ret = jffs2_garbage_collect_pass(c);
+		jffs2_gc_sched_end(c);
+		if (ret == -ENOSPC) {
 			printk(KERN_NOTICE "No space for garbage collection. Aborting GC thread\n");
 			goto die;
 		}
@@ -64,11 +64,16 @@ static int jffs2_is_best_compression(struct jffs2_compressor *this,
  * Returns: Lower byte to be stored with data indicating compression type used.
  * Zero is used to show that the data could not be compressed - the
  * compressed version was actually larger than the original.
- * Upper byte will be used later. (soon)
+ * The upper byte is always zero. Older kernels read it back from the raw
+ * inode's usercompr field and cannot decompress LZO data with it set, so
+ * the compression hint goes in the raw inode's flags instead.
  *
  * If the cdata buffer isn't large enough to hold all the uncompressed data,
  * jffs2_compress should compress as much as will fit, and should set
  * *datalen accordingly to show the amount of data which were compressed.
+ *
+ * An inode with a compression hint overrides the mode: its data is either
+ * stored uncompressed or only offered to the compressor it asked for.
  */
 uint16_t jffs2_compress(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 			unsigned char *data_in, unsigned char **cpage_out,
@@ -80,8 +85,17 @@ uint16_t jffs2_compress(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 	unsigned char *output_buf = NULL, *tmp_buf;
 	uint32_t orig_slen, orig_dlen;
 	uint32_t best_slen=0, best_dlen=0;
+	int mode = jffs2_compression_mode;
+	uint8_t usercompr = JFFS2_COMPR_NONE;
 
-	switch (jffs2_compression_mode) {
+	if (f->flags & JFFS2_INO_FLAG_NOCOMPR) {
+		mode = JFFS2_COMPR_MODE_NONE;
+	} else if (f->flags & JFFS2_INO_FLAG_LZOCOMPR) {
+		usercompr = JFFS2_COMPR_LZO;
+		mode = JFFS2_COMPR_MODE_PRIORITY;
+	}
+
+	switch (mode) {
 	case JFFS2_COMPR_MODE_NONE:
 		break;
 	case JFFS2_COMPR_MODE_PRIORITY:
@@ -97,6 +111,8 @@ uint16_t jffs2_compress(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 			/* Skip decompress-only backwards-compatibility and disabled modules */
 			if ((!this->compress)||(this->disabled))
 				continue;
+			if (usercompr && this->compr != usercompr)
+				continue;
 
 			this->usecount++;
 			spin_unlock(&jffs2_compressor_list_lock);
@@ -303,6 +319,39 @@ void jffs2_free_comprbuf(unsigned char *comprbuf, unsigned char *orig)
 		kfree(comprbuf);
 }
 
+/* jffs2_set_compr_hint:
+ * Store the compression hint of an inode in the flags of a raw inode
+ * about to be written. Every kernel ignores those flags on read, while
+ * usercompr is left zero since older ones take it as part of the
+ * compression type. Returns 1 if the raw inode changed and its node_crc
+ * has to be recalculated.
+ */
+int jffs2_set_compr_hint(struct jffs2_inode_info *f, struct jffs2_raw_inode *ri)
+{
+	uint16_t flags = f->flags & JFFS2_INO_FLAG_COMPR_HINT;
+
+	if (je16_to_cpu(ri->flags) == flags && !ri->usercompr)
+		return 0;
+
+	ri->flags = cpu_to_je16(flags);
+	ri->usercompr = 0;
+	return 1;
+}
+
+/* jffs2_get_compr_hint:
+ * Pick up the compression hint from the latest raw inode. Hints which
+ * this code would not honour are dropped.
+ */
+void jffs2_get_compr_hint(struct jffs2_inode_info *f, struct jffs2_raw_inode *ri)
+{
+	uint16_t flags = je16_to_cpu(ri->flags) & JFFS2_INO_FLAG_COMPR_HINT;
+
+	f->flags &= ~JFFS2_INO_FLAG_COMPR_HINT;
+
+	if (flags != JFFS2_INO_FLAG_COMPR_HINT)
+		f->flags |= flags;
+}
+
 int __init jffs2_compressors_init(void)
 {
 /* Registering compressors */
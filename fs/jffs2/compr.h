@@ -77,6 +77,9 @@ int jffs2_decompress(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 
 void jffs2_free_comprbuf(unsigned char *comprbuf, unsigned char *orig);
 
+int jffs2_set_compr_hint(struct jffs2_inode_info *f, struct jffs2_raw_inode *ri);
+void jffs2_get_compr_hint(struct jffs2_inode_info *f, struct jffs2_raw_inode *ri);
+
 /* Compressor modules */
 /* These functions will be called by jffs2_compressors_init/exit */
 
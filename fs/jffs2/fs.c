@@ -438,6 +438,9 @@ struct inode *jffs2_new_inode (struct inode *dir_i, int mode, struct jffs2_raw_i
 	jffs2_init_inode_info(f);
 	mutex_lock(&f->sem);
 
+	/* New inodes take the compression hint of their directory */
+	f->flags = JFFS2_INODE_INFO(dir_i)->flags & JFFS2_INO_FLAG_COMPR_HINT;
+
 	memset(ri, 0, sizeof(*ri));
 	/* Set OS-specific defaults for new inodes */
 	ri->uid = cpu_to_je16(current->fsuid);
@@ -556,6 +559,7 @@ int jffs2_do_fill_super(struct super_block *sb, void *data, int silent)
 	sb->s_blocksize = PAGE_CACHE_SIZE;
 	sb->s_blocksize_bits = PAGE_CACHE_SHIFT;
 	sb->s_magic = JFFS2_SUPER_MAGIC;
+	jffs2_gc_sched_init(c);
 	if (!(sb->s_flags & MS_RDONLY))
 		jffs2_start_garbage_collect_thread(c);
 	return 0;
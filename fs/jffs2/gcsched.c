@@ -0,0 +1,392 @@
+/*
+ * JFFS2 -- Journalling Flash File System, Version 2.
+ *
+ * For licensing information, see the file 'LICENCE' in this directory.
+ *
+ * Idle time garbage collection.
+ *
+ * Normally the GC thread only runs once the number of free blocks drops
+ * to resv_blocks_gctrigger, which is just one block above the point at
+ * which writes have to garbage collect synchronously, inside
+ * jffs2_reserve_space(). On a filesystem which is kept nearly full that
+ * means many writes end up waiting for GC.
+ *
+ * Here the GC thread also collects when nothing else is going on: no
+ * write to the filesystem for idle_ms, and the CPU idle for most of the
+ * time the thread slept. It then keeps up to 'reserve' more blocks free,
+ * and pays off the checking left over by JFFS2_FS_LAZY_CHECK. Screen
+ * updates and page rendering keep the CPU busy, so GC keeps out of their
+ * way too.
+ *
+ * The statistics, including latency histograms of background passes and
+ * of writes stalled by synchronous GC, are in debugfs, as
+ * jffs2/mtdN/gc. The reserve and idle time can be tuned next to it.
+ */
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/kernel_stat.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/err.h>
+#include <linux/mtd/mtd.h>
+#include "nodelist.h"
+
+/* Foreground quiet time before idle GC starts, by default */
+#define JFFS2_GC_IDLE_MS	2000
+
+/* The CPU must have been idle this much of the time */
+#define JFFS2_GC_IDLE_PERCENT	90
+
+/* Sleep between idle bursts, which is also the idle sample period */
+#define JFFS2_GC_IDLE_SAMPLE	(HZ / 20)
+
+/* How long an idle burst may keep collecting without sleeping */
+#define JFFS2_GC_IDLE_BURST	(HZ / 50 ? HZ / 50 : 1)
+
+static struct dentry *jffs2_gc_root;
+static int jffs2_gc_users;
+static DEFINE_MUTEX(jffs2_gc_root_lock);
+
+static const char *jffs2_gc_sync_names[JFFS2_GC_SYNC_NR] = {
+	[JFFS2_GC_SYNC_CHECK]	= "check",
+	[JFFS2_GC_SYNC_COLLECT]	= "collect",
+	[JFFS2_GC_SYNC_ERASE]	= "erase",
+};
+
+static int jffs2_gc_hist_bucket(s64 us)
+{
+	unsigned int ms = clamp_t(s64, us, 0, UINT_MAX) / 1000;
+
+	return min(ms ? fls(ms) : 0, JFFS2_GC_HIST_NR - 1);
+}
+
+static u64 jffs2_gc_idle_jiffies(void)
+{
+	cputime64_t idle = cputime64_zero;
+	int i;
+
+	for_each_online_cpu(i)
+		idle = cputime64_add(idle, kstat_cpu(i).cpustat.idle);
+
+	return cputime64_to_jiffies64(idle);
+}
+
+/* Is there anything worth collecting when idle? */
+static int jffs2_gc_sched_wanted(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+	uint32_t dirty;
+
+	if (c->unchecked_size)
+		return 1;
+
+	if (!s->reserve)
+		return 0;
+
+	dirty = c->dirty_size + c->erasing_size - c->nr_erasing_blocks * c->sector_size;
+
+	return c->nr_free_blocks + c->nr_erasing_blocks <
+		c->resv_blocks_gctrigger + s->reserve &&
+		dirty > c->nospc_dirty_size;
+}
+
+static int jffs2_gc_sched_fg_quiet(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+
+	return time_after_eq(jiffies, s->last_fg + msecs_to_jiffies(s->idle_ms));
+}
+
+static int jffs2_gc_sched_quiet(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+	unsigned long busy;
+	u64 idle;
+
+	if (!jffs2_gc_sched_fg_quiet(c))
+		return 0;
+
+	if (time_before(jiffies, s->burst_end))
+		return 1;
+
+	busy = jiffies - s->jiffies_stamp;
+	if (busy < JFFS2_GC_IDLE_SAMPLE)
+		return 0;
+
+	idle = jffs2_gc_idle_jiffies() - s->idle_stamp;
+	if (idle * 100 < (u64)busy * num_online_cpus() * JFFS2_GC_IDLE_PERCENT)
+		return 0;
+
+	s->burst_end = jiffies + JFFS2_GC_IDLE_BURST;
+	return 1;
+}
+
+/**
+ *	jffs2_gc_sched_foreground - note a write to the filesystem
+ *	@c: superblock info
+ *
+ *	Called for every space reservation on behalf of a user, which
+ *	also ends any idle burst in progress.
+ */
+void jffs2_gc_sched_foreground(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+
+	s->last_fg = jiffies;
+	s->burst_end = jiffies;
+}
+
+/**
+ *	jffs2_gc_sched_kick - should the GC thread be woken for idle GC
+ *	@c: superblock info
+ *
+ *	Called with the erase_completion_lock held. Only a thread which
+ *	went to sleep with nothing to do needs waking, the others will
+ *	look again when their timeout expires.
+ */
+int jffs2_gc_sched_kick(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+
+	if (!s->parked || !jffs2_gc_sched_wanted(c))
+		return 0;
+
+	s->parked = 0;
+	return 1;
+}
+
+/**
+ *	jffs2_gc_sched_timeout - how long the GC thread should sleep
+ *	@c: superblock info
+ *
+ *	Called by the GC thread when there's no need to collect. Returns 0
+ *	to carry on with an idle burst straight away.
+ */
+long jffs2_gc_sched_timeout(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+	long fg_wait;
+
+	if (!jffs2_gc_sched_wanted(c)) {
+		s->parked = 1;
+		return MAX_SCHEDULE_TIMEOUT;
+	}
+	s->parked = 0;
+
+	if (time_before(jiffies, s->burst_end) && jffs2_gc_sched_fg_quiet(c))
+		return 0;
+
+	s->jiffies_stamp = jiffies;
+	s->idle_stamp = jffs2_gc_idle_jiffies();
+
+	fg_wait = (long)(s->last_fg + msecs_to_jiffies(s->idle_ms) - jiffies);
+
+	return max_t(long, fg_wait, JFFS2_GC_IDLE_SAMPLE);
+}
+
+/**
+ *	jffs2_gc_sched_begin - decide whether the GC thread does a pass
+ *	@c: superblock info
+ *
+ *	Returns 1 if a pass is needed to free space, or if the system is
+ *	idle and there's something to get ahead with.
+ */
+int jffs2_gc_sched_begin(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+
+	if (jffs2_thread_should_wake(c)) {
+		s->idle_pass = 0;
+	} else {
+		if (!jffs2_gc_sched_wanted(c) || !jffs2_gc_sched_quiet(c))
+			return 0;
+		s->idle_pass = 1;
+	}
+
+	s->pass_start = ktime_get();
+	return 1;
+}
+
+void jffs2_gc_sched_end(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+	s64 us = ktime_to_us(ktime_sub(ktime_get(), s->pass_start));
+
+	s->bg_hist[jffs2_gc_hist_bucket(us)]++;
+	if (s->idle_pass)
+		s->idle_passes++;
+	else
+		s->bg_passes++;
+}
+
+/**
+ *	jffs2_gc_sched_sync - account a GC pass done by a write
+ *	@c: superblock info
+ *	@start: start of the stall, zero before the first pass
+ *	@reason: JFFS2_GC_SYNC_*
+ */
+void jffs2_gc_sched_sync(struct jffs2_sb_info *c, ktime_t *start, int reason)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+
+	if (!ktime_to_ns(*start)) {
+		*start = ktime_get();
+		s->sync_stalls++;
+	}
+	s->sync_passes[reason]++;
+}
+
+void jffs2_gc_sched_sync_done(struct jffs2_sb_info *c, ktime_t start)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+	s64 us;
+
+	if (!ktime_to_ns(start))
+		return;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	s->sync_hist[jffs2_gc_hist_bucket(us)]++;
+	if (us > s->sync_max_us)
+		s->sync_max_us = us;
+}
+
+static void jffs2_gc_show_hist(struct seq_file *m, const char *name,
+			       uint32_t *hist)
+{
+	int i;
+
+	seq_printf(m, "%-6s", name);
+	for (i = 0; i < JFFS2_GC_HIST_NR; i++)
+		seq_printf(m, " %6u", hist[i]);
+	seq_putc(m, '\n');
+}
+
+static int jffs2_gc_stats_show(struct seq_file *m, void *v)
+{
+	struct jffs2_sb_info *c = m->private;
+	struct jffs2_gc_sched *s = &c->gc_sched;
+	char label[8];
+	int i;
+
+	spin_lock(&c->erase_completion_lock);
+	seq_printf(m, "free blocks: %u (write %u, gc %u, idle %u)\n",
+		   c->nr_free_blocks + c->nr_erasing_blocks,
+		   c->resv_blocks_write, c->resv_blocks_gctrigger,
+		   c->resv_blocks_gctrigger + s->reserve);
+	seq_printf(m, "dirty: %u KiB\nunchecked: %u KiB\n",
+		   c->dirty_size >> 10, c->unchecked_size >> 10);
+	spin_unlock(&c->erase_completion_lock);
+
+	seq_printf(m, "background passes: %u\nidle passes: %u\n",
+		   s->bg_passes, s->idle_passes);
+	seq_printf(m, "sync stalls: %u\nsync max: %u us\n",
+		   s->sync_stalls, s->sync_max_us);
+	for (i = 0; i < JFFS2_GC_SYNC_NR; i++)
+		seq_printf(m, "sync %s: %u\n", jffs2_gc_sync_names[i],
+			   s->sync_passes[i]);
+
+	seq_printf(m, "\n%-6s", "ms");
+	for (i = 0; i < JFFS2_GC_HIST_NR - 1; i++) {
+		snprintf(label, sizeof(label), "<%u", 1 << i);
+		seq_printf(m, " %6s", label);
+	}
+	snprintf(label, sizeof(label), ">=%u", 1 << (i - 1));
+	seq_printf(m, " %6s\n", label);
+	jffs2_gc_show_hist(m, "pass", s->bg_hist);
+	jffs2_gc_show_hist(m, "stall", s->sync_hist);
+
+	return 0;
+}
+
+static int jffs2_gc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, jffs2_gc_stats_show, inode->i_private);
+}
+
+static const struct file_operations jffs2_gc_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= jffs2_gc_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void jffs2_gc_debugfs_init(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+	char name[16];
+
+	mutex_lock(&jffs2_gc_root_lock);
+
+	if (!jffs2_gc_root) {
+		jffs2_gc_root = debugfs_create_dir("jffs2", NULL);
+		if (IS_ERR(jffs2_gc_root))
+			jffs2_gc_root = NULL;
+		if (!jffs2_gc_root)
+			goto out;
+	}
+
+	snprintf(name, sizeof(name), "mtd%d", c->mtd->index);
+
+	s->dir = debugfs_create_dir(name, jffs2_gc_root);
+	if (IS_ERR(s->dir))
+		s->dir = NULL;
+	if (!s->dir)
+		goto out;
+
+	jffs2_gc_users++;
+
+	s->stats = debugfs_create_file("gc", S_IRUGO, s->dir, c,
+				       &jffs2_gc_stats_fops);
+	s->reserve_file = debugfs_create_u8("gc_reserve", S_IRUGO | S_IWUSR,
+					    s->dir, &s->reserve);
+	s->idle_file = debugfs_create_u32("gc_idle_ms", S_IRUGO | S_IWUSR,
+					  s->dir, &s->idle_ms);
+ out:
+	mutex_unlock(&jffs2_gc_root_lock);
+}
+
+/**
+ *	jffs2_gc_sched_init - set up idle GC for a filesystem
+ *	@c: superblock info
+ *
+ *	Called once the filesystem is built and before the GC thread starts.
+ */
+void jffs2_gc_sched_init(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+
+	memset(s, 0, sizeof(*s));
+	s->reserve = CONFIG_JFFS2_FS_GC_RESERVE;
+	s->idle_ms = JFFS2_GC_IDLE_MS;
+	s->last_fg = jiffies;
+	s->burst_end = jiffies;
+
+	jffs2_gc_debugfs_init(c);
+}
+
+void jffs2_gc_sched_exit(struct jffs2_sb_info *c)
+{
+	struct jffs2_gc_sched *s = &c->gc_sched;
+
+	if (!s->dir)
+		return;
+
+	mutex_lock(&jffs2_gc_root_lock);
+
+	debugfs_remove(s->idle_file);
+	debugfs_remove(s->reserve_file);
+	debugfs_remove(s->stats);
+	debugfs_remove(s->dir);
+	s->dir = NULL;
+
+	if (--jffs2_gc_users == 0) {
+		debugfs_remove(jffs2_gc_root);
+		jffs2_gc_root = NULL;
+	}
+
+	mutex_unlock(&jffs2_gc_root_lock);
+}
@@ -0,0 +1,37 @@
+/*
+ * JFFS2 -- Journalling Flash File System, Version 2.
+ *
+ * For licensing information, see the file 'LICENCE' in this directory.
+ *
+ */
+
+#ifndef JFFS2_GCSCHED_H
+#define JFFS2_GCSCHED_H
+
+#ifdef CONFIG_JFFS2_FS_GC_SCHED
+
+void jffs2_gc_sched_init(struct jffs2_sb_info *c);
+void jffs2_gc_sched_exit(struct jffs2_sb_info *c);
+void jffs2_gc_sched_foreground(struct jffs2_sb_info *c);
+int jffs2_gc_sched_kick(struct jffs2_sb_info *c);
+long jffs2_gc_sched_timeout(struct jffs2_sb_info *c);
+int jffs2_gc_sched_begin(struct jffs2_sb_info *c);
+void jffs2_gc_sched_end(struct jffs2_sb_info *c);
+void jffs2_gc_sched_sync(struct jffs2_sb_info *c, ktime_t *start, int reason);
+void jffs2_gc_sched_sync_done(struct jffs2_sb_info *c, ktime_t start);
+
+#else
+
+#define jffs2_gc_sched_init(c)
+#define jffs2_gc_sched_exit(c)
+#define jffs2_gc_sched_foreground(c)
+#define jffs2_gc_sched_kick(c) (0)
+#define jffs2_gc_sched_timeout(c) (MAX_SCHEDULE_TIMEOUT)
+#define jffs2_gc_sched_begin(c) (1)
+#define jffs2_gc_sched_end(c)
+#define jffs2_gc_sched_sync(c, s, r)
+#define jffs2_gc_sched_sync_done(c, s)
+
+#endif /* CONFIG_JFFS2_FS_GC_SCHED */
+
+#endif /* JFFS2_GCSCHED_H */
@@ -10,12 +10,95 @@
  */
 
 #include <linux/fs.h>
+#include <linux/time.h>
+#include <linux/mount.h>
+#include <asm/uaccess.h>
 #include "nodelist.h"
 
-long jffs2_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+/*
+ * The compression hint of an inode is what lsattr/chattr see as the
+ * 'X' (FS_NOCOMP_FL) and 'c' (FS_COMPR_FL) flags. 'X' stores the data
+ * uncompressed, which is right for files that are compressed already;
+ * 'c' asks for LZO, which is cheap to decompress. New inodes inherit
+ * the hint of their directory.
+ */
+#define JFFS2_FL_USER_MODIFIABLE	(FS_NOCOMP_FL | FS_COMPR_FL)
+
+static unsigned int jffs2_get_flags(struct jffs2_inode_info *f)
+{
+	if (f->flags & JFFS2_INO_FLAG_NOCOMPR)
+		return FS_NOCOMP_FL;
+	if (f->flags & JFFS2_INO_FLAG_LZOCOMPR)
+		return FS_COMPR_FL;
+	return 0;
+}
+
+static int jffs2_set_flags(struct inode *inode, unsigned int flags)
 {
-	/* Later, this will provide for lsattr.jffs2 and chattr.jffs2, which
-	   will include compression support etc. */
-	return -ENOTTY;
+	struct jffs2_inode_info *f = JFFS2_INODE_INFO(inode);
+	struct iattr iattr;
+	int ret;
+
+	if (flags & ~JFFS2_FL_USER_MODIFIABLE)
+		return -EOPNOTSUPP;
+	if ((flags & JFFS2_FL_USER_MODIFIABLE) == JFFS2_FL_USER_MODIFIABLE)
+		return -EINVAL;
+#ifndef CONFIG_JFFS2_LZO
+	if (flags & FS_COMPR_FL)
+		return -EOPNOTSUPP;
+#endif
+
+	mutex_lock(&inode->i_mutex);
+
+	if (flags == jffs2_get_flags(f)) {
+		mutex_unlock(&inode->i_mutex);
+		return 0;
+	}
+
+	mutex_lock(&f->sem);
+	f->flags &= ~JFFS2_INO_FLAG_COMPR_HINT;
+	if (flags & FS_NOCOMP_FL)
+		f->flags |= JFFS2_INO_FLAG_NOCOMPR;
+	else if (flags & FS_COMPR_FL)
+		f->flags |= JFFS2_INO_FLAG_LZOCOMPR;
+	mutex_unlock(&f->sem);
+
+	/* Write a metadata node, which carries the new hint to the medium.
+	   Data already written keeps its compression until it is rewritten
+	   or garbage collected. */
+	iattr.ia_valid = ATTR_CTIME;
+	iattr.ia_ctime = CURRENT_TIME_SEC;
+	ret = jffs2_do_setattr(inode, &iattr);
+
+	mutex_unlock(&inode->i_mutex);
+	return ret;
 }
 
+long jffs2_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct inode *inode = filp->f_path.dentry->d_inode;
+	unsigned int flags;
+	int ret;
+
+	switch (cmd) {
+	case FS_IOC_GETFLAGS:
+		flags = jffs2_get_flags(JFFS2_INODE_INFO(inode));
+		return put_user(flags, (int __user *)arg);
+
+	case FS_IOC_SETFLAGS:
+		if (!is_owner_or_cap(inode))
+			return -EACCES;
+		if (get_user(flags, (int __user *)arg))
+			return -EFAULT;
+
+		ret = mnt_want_write(filp->f_path.mnt);
+		if (ret)
+			return ret;
+		ret = jffs2_set_flags(inode, flags);
+		mnt_drop_write(filp->f_path.mnt);
+		return ret;
+
+	default:
+		return -ENOTTY;
+	}
+}
@@ -28,6 +28,46 @@
 
 struct jffs2_inodirty;
 
+#ifdef CONFIG_JFFS2_FS_GC_SCHED
+/* Reasons for a write to garbage collect synchronously */
+enum {
+	JFFS2_GC_SYNC_CHECK,	/* CRC check inodes left unchecked */
+	JFFS2_GC_SYNC_COLLECT,	/* move nodes out of a block */
+	JFFS2_GC_SYNC_ERASE,	/* wait for pending erases */
+	JFFS2_GC_SYNC_NR
+};
+
+/* Latency histogram buckets: <1ms, <2ms, <4ms ... <1024ms, >=1024ms */
+#define JFFS2_GC_HIST_NR	12
+
+struct jffs2_gc_sched {
+	unsigned long last_fg;		/* jiffies of the last write */
+	unsigned long burst_end;	/* end of the current idle burst */
+	unsigned long jiffies_stamp;	/* start of the idle sample */
+	u64 idle_stamp;			/* CPU idle jiffies at jiffies_stamp */
+	ktime_t pass_start;
+	int idle_pass;
+	int parked;			/* GC thread waits for a trigger */
+
+	uint8_t reserve;		/* blocks idle GC keeps free on top
+					   of resv_blocks_gctrigger */
+	uint32_t idle_ms;		/* no writes for this long is idle */
+
+	uint32_t bg_passes;
+	uint32_t idle_passes;
+	uint32_t sync_stalls;
+	uint32_t sync_max_us;
+	uint32_t sync_passes[JFFS2_GC_SYNC_NR];
+	uint32_t bg_hist[JFFS2_GC_HIST_NR];
+	uint32_t sync_hist[JFFS2_GC_HIST_NR];
+
+	struct dentry *dir;
+	struct dentry *stats;
+	struct dentry *reserve_file;
+	struct dentry *idle_file;
+};
+#endif
+
 /* A struct for the overall file system control.  Pointers to
    jffs2_sb_info structs are named `c' in the source code.
    Nee jffs_control
@@ -125,6 +165,10 @@ struct jffs2_sb_info {
 
 	struct jffs2_summary *summary;		/* Summary information */
 
+#ifdef CONFIG_JFFS2_FS_GC_SCHED
+	struct jffs2_gc_sched gc_sched;		/* Idle GC and GC statistics */
+#endif
+
 #ifdef CONFIG_JFFS2_FS_XATTR
 #define XATTRINDEX_HASHSIZE	(57)
 	uint32_t highest_xid;
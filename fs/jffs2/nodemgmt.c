@@ -39,8 +39,9 @@
 static int jffs2_do_reserve_space(struct jffs2_sb_info *c,  uint32_t minsize,
 				  uint32_t *len, uint32_t sumsize);
 
-int jffs2_reserve_space(struct jffs2_sb_info *c, uint32_t minsize,
-			uint32_t *len, int prio, uint32_t sumsize)
+static int __jffs2_reserve_space(struct jffs2_sb_info *c, uint32_t minsize,
+				 uint32_t *len, int prio, uint32_t sumsize,
+				 ktime_t *gc_start)
 {
 	int ret = -EAGAIN;
 	int blocksneeded = c->resv_blocks_write;
@@ -113,13 +114,16 @@ int jffs2_reserve_space(struct jffs2_sb_info *c, uint32_t minsize,
 			D1(printk(KERN_DEBUG "Triggering GC pass. nr_free_blocks %d, nr_erasing_blocks %d, free_size 0x%08x, dirty_size 0x%08x, wasted_size 0x%08x, used_size 0x%08x, erasing_size 0x%08x, bad_size 0x%08x (total 0x%08x of 0x%08x)\n",
 				  c->nr_free_blocks, c->nr_erasing_blocks, c->free_size, c->dirty_size, c->wasted_size, c->used_size, c->erasing_size, c->bad_size,
 				  c->free_size + c->dirty_size + c->wasted_size + c->used_size + c->erasing_size + c->bad_size, c->flash_size));
+			jffs2_gc_sched_sync(c, gc_start, c->unchecked_size ?
+					    JFFS2_GC_SYNC_CHECK : JFFS2_GC_SYNC_COLLECT);
 			spin_unlock(&c->erase_completion_lock);
 
 			ret = jffs2_garbage_collect_pass(c);
 
-			if (ret == -EAGAIN)
+			if (ret == -EAGAIN) {
+				jffs2_gc_sched_sync(c, gc_start, JFFS2_GC_SYNC_ERASE);
 				jffs2_erase_pending_blocks(c, 1);
-			else if (ret)
+			} else if (ret)
 				return ret;
 
 			cond_resched();
@@ -144,6 +148,19 @@ int jffs2_reserve_space(struct jffs2_sb_info *c, uint32_t minsize,
 	return ret;
 }
 
+int jffs2_reserve_space(struct jffs2_sb_info *c, uint32_t minsize,
+			uint32_t *len, int prio, uint32_t sumsize)
+{
+	ktime_t gc_start = ktime_set(0, 0);
+	int ret;
+
+	jffs2_gc_sched_foreground(c);
+	ret = __jffs2_reserve_space(c, minsize, len, prio, sumsize, &gc_start);
+	jffs2_gc_sched_sync_done(c, gc_start);
+
+	return ret;
+}
+
 int jffs2_reserve_space_gc(struct jffs2_sb_info *c, uint32_t minsize,
 			   uint32_t *len, uint32_t sumsize)
 {
@@ -727,7 +744,9 @@ int jffs2_thread_should_wake(struct jffs2_sb_info *c)
 	int nr_very_dirty = 0;
 	struct jffs2_eraseblock *jeb;
 
-	if (c->unchecked_size) {
+	/* With lazy checking the nodes of an inode are checked when it is
+	   first read, and the rest only when GC is really needed, below */
+	if (c->unchecked_size && !jffs2_lazy_check(c)) {
 		D1(printk(KERN_DEBUG "jffs2_thread_should_wake(): unchecked_size %d, checked_ino #%d\n",
 			  c->unchecked_size, c->checked_ino));
 		return 1;
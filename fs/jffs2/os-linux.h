@@ -66,6 +66,13 @@ static inline void jffs2_init_inode_info(struct jffs2_inode_info *f)
 #define jffs2_is_readonly(c) (OFNI_BS_2SFFJ(c)->s_flags & MS_RDONLY)
 
 #define SECTOR_ADDR(x) ( (((unsigned long)(x) / c->sector_size) * c->sector_size) )
+
+#ifdef CONFIG_JFFS2_FS_LAZY_CHECK
+#define jffs2_lazy_check(c) (1)
+#else
+#define jffs2_lazy_check(c) (0)
+#endif
+
 #ifndef CONFIG_JFFS2_FS_WRITEBUFFER
 
 
@@ -18,6 +18,7 @@
 #include <linux/mtd/mtd.h>
 #include <linux/compiler.h>
 #include "nodelist.h"
+#include "compr.h"
 
 /*
  * Check the data CRC of the node.
@@ -1210,6 +1211,8 @@ static int jffs2_do_read_inode_internal(struct jffs2_sb_info *c,
 		return -EIO;
 	}
 
+	jffs2_get_compr_hint(f, latest_node);
+
 	switch(jemode_to_cpu(latest_node->mode) & S_IFMT) {
 	case S_IFDIR:
 		if (rii.mctime_ver > je32_to_cpu(latest_node->version)) {
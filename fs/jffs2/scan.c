@@ -93,6 +93,7 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 	unsigned char *flashbuf = NULL;
 	uint32_t buf_size = 0;
 	struct jffs2_summary *s = NULL; /* summary info collected by the scan process */
+	unsigned long start = jiffies;
 #ifndef __ECOS
 	size_t pointlen;
 
@@ -270,6 +271,14 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 	else
 		c->mtd->unpoint(c->mtd, 0, c->mtd->size);
 #endif
+	if (!ret && s)
+		printk(KERN_INFO "JFFS2: scanned %d eraseblocks of mtd%d in %u ms, "
+		       "%u from summary, %u summaries rejected\n",
+		       c->nr_blocks, c->mtd->index, jiffies_to_msecs(jiffies - start),
+		       s->scan_sum_blocks, s->scan_sum_rejected);
+	else if (!ret)
+		printk(KERN_INFO "JFFS2: scanned %d eraseblocks of mtd%d in %u ms\n",
+		       c->nr_blocks, c->mtd->index, jiffies_to_msecs(jiffies - start));
 	if (s)
 		kfree(s);
 
@@ -521,6 +530,25 @@ static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblo
 		}
 
 		if (sumptr) {
+#ifdef CONFIG_JFFS2_SUMMARY_VERIFY
+			/* Read what is in front of the summary, which does not
+			   overlap it in the buffer, and check them against
+			   each other before trusting the summary */
+			err = 0;
+			if (buf_size >= c->sector_size)
+				err = jffs2_fill_scan_buf(c, buf, jeb->offset,
+							  c->sector_size - sumlen);
+			if (err)
+				return err;
+			if (buf_size >= c->sector_size || !buf_size)
+				err = jffs2_sum_verify(c, jeb, sumptr, sumlen, buf);
+			if (err) {
+				s->scan_sum_rejected++;
+				if (buf_size && sumlen > buf_size)
+					kfree(sumptr);
+				goto full_scan;
+			}
+#endif
 			err = jffs2_sum_scan_sumnode(c, jeb, sumptr, sumlen, &pseudo_random);
 
 			if (buf_size && sumlen > buf_size)
@@ -529,11 +557,18 @@ static int jffs2_scan_eraseblock (struct jffs2_sb_info *c, struct jffs2_eraseblo
 			   If it returns positive, that's a block classification
 			   (i.e. BLK_STATE_xxx) so return that too.
 			   If it returns zero, fall through to full scan. */
+			if (err > 0)
+				s->scan_sum_blocks++;
+			else if (!err)
+				s->scan_sum_rejected++;
 			if (err)
 				return err;
 		}
 	}
 
+#ifdef CONFIG_JFFS2_SUMMARY_VERIFY
+ full_scan:
+#endif
 	buf_ofs = jeb->offset;
 
 	if (!buf_size) {
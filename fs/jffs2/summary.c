@@ -563,6 +563,211 @@ static int jffs2_sum_process_sum_data(struct jffs2_sb_info *c, struct jffs2_eras
 	return 0;
 }
 
+/* Size of the summary entry at sp, or 0 if it is not one we know or does
+   not fit before end - helper function for jffs2_sum_validate() */
+
+static uint32_t jffs2_sum_entry_size(void *sp, void *end, uint32_t *ofs, uint32_t *len)
+{
+	union jffs2_sum_flash *sf = sp;
+	uint32_t size;
+
+	if (sp + sizeof(struct jffs2_sum_unknown_flash) > end)
+		return 0;
+
+	switch (je16_to_cpu(sf->u.nodetype)) {
+		case JFFS2_NODETYPE_INODE:
+			size = JFFS2_SUMMARY_INODE_SIZE;
+			if (sp + size > end)
+				return 0;
+			*ofs = je32_to_cpu(sf->i.offset);
+			*len = je32_to_cpu(sf->i.totlen);
+			return size;
+
+		case JFFS2_NODETYPE_DIRENT:
+			if (sp + JFFS2_SUMMARY_DIRENT_SIZE(0) > end)
+				return 0;
+			size = JFFS2_SUMMARY_DIRENT_SIZE(sf->d.nsize);
+			if (sp + size > end)
+				return 0;
+			*ofs = je32_to_cpu(sf->d.offset);
+			*len = je32_to_cpu(sf->d.totlen);
+			return size;
+#ifdef CONFIG_JFFS2_FS_XATTR
+		case JFFS2_NODETYPE_XATTR:
+			size = JFFS2_SUMMARY_XATTR_SIZE;
+			if (sp + size > end)
+				return 0;
+			*ofs = je32_to_cpu(sf->x.offset);
+			*len = je32_to_cpu(sf->x.totlen);
+			return size;
+
+		case JFFS2_NODETYPE_XREF:
+			size = JFFS2_SUMMARY_XREF_SIZE;
+			if (sp + size > end)
+				return 0;
+			*ofs = je32_to_cpu(sf->r.offset);
+			*len = sizeof(struct jffs2_raw_xref);
+			return size;
+#endif
+		default:
+			return 0;
+	}
+}
+
+/* Check that every summary entry is one we know, lies within the summary
+   node and describes a node in front of it, in flash order. This is done
+   before any of it is used, because jffs2_sum_process_sum_data() cannot
+   undo the directory entries it has added when it gives up half way, and
+   a summary we cannot use in full is better replaced by a full scan of the
+   eraseblock - helper function for jffs2_sum_scan_sumnode() */
+
+static int jffs2_sum_validate(struct jffs2_sb_info *c, struct jffs2_raw_summary *summary,
+			      uint32_t sumsize)
+{
+	void *sp = summary->sum;
+	void *end = (void *)summary + sumsize;
+	uint32_t sumofs = c->sector_size - sumsize;
+	uint32_t ofs, len, size, next = 0;
+	int i;
+
+	for (i=0; i<je32_to_cpu(summary->sum_num); i++) {
+		size = jffs2_sum_entry_size(sp, end, &ofs, &len);
+		if (!size) {
+			dbg_summary("summary entry %d unknown or truncated\n", i);
+			return -EINVAL;
+		}
+
+		if ((ofs & 3) || ofs < next || len < sizeof(struct jffs2_unknown_node) ||
+		    ofs + len > sumofs || ofs + len < ofs) {
+			dbg_summary("summary entry %d at 0x%08x-0x%08x out of place\n",
+				    i, ofs, ofs + len);
+			return -EINVAL;
+		}
+
+		next = ofs + PAD(len);
+		sp += size;
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_JFFS2_SUMMARY_VERIFY
+/* Compare a (validated) summary with the nodes actually found in the data
+   in front of it, the same way the full scan would find them. Returns 0 if
+   the summary describes exactly the nodes the full scan would use */
+
+int jffs2_sum_verify(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
+		     struct jffs2_raw_summary *summary, uint32_t sumsize,
+		     unsigned char *data)
+{
+	struct jffs2_unknown_node *node;
+	union jffs2_sum_flash *sf = (void *)summary->sum;
+	void *end = (void *)summary + sumsize;
+	uint32_t sumofs = c->sector_size - sumsize;
+	uint32_t ofs = 0, sofs = 0, slen = 0, totlen, crc;
+	int i = 0, n = je32_to_cpu(summary->sum_num);
+
+	if (n)
+		jffs2_sum_entry_size(sf, end, &sofs, &slen);
+
+	while (ofs + sizeof(*node) <= sumofs) {
+		node = (void *)data + ofs;
+
+		if (je16_to_cpu(node->magic) != JFFS2_MAGIC_BITMASK) {
+			ofs += 4;
+			continue;
+		}
+
+		crc = crc32(0, node, sizeof(*node) - 4);
+		totlen = je32_to_cpu(node->totlen);
+		if (je32_to_cpu(node->hdr_crc) != crc || totlen < sizeof(*node) ||
+		    ofs + totlen > sumofs) {
+			ofs += 4;
+			continue;
+		}
+
+		/* An obsolete node may or may not have been summarised */
+		if (!(je16_to_cpu(node->nodetype) & JFFS2_NODE_ACCURATE)) {
+			if (i < n && sofs == ofs)
+				goto next_entry;
+			ofs += PAD(totlen);
+			continue;
+		}
+
+		switch (je16_to_cpu(node->nodetype)) {
+			case JFFS2_NODETYPE_INODE: {
+				struct jffs2_raw_inode *ri = (void *)node;
+
+				if (i >= n || sofs != ofs || slen != totlen ||
+				    je16_to_cpu(sf->u.nodetype) != JFFS2_NODETYPE_INODE ||
+				    je32_to_cpu(sf->i.inode) != je32_to_cpu(ri->ino) ||
+				    je32_to_cpu(sf->i.version) != je32_to_cpu(ri->version))
+					goto mismatch;
+				break;
+			}
+
+			case JFFS2_NODETYPE_DIRENT: {
+				struct jffs2_raw_dirent *rd = (void *)node;
+
+				/* the full scan drops dirents with a bad node CRC */
+				crc = crc32(0, rd, sizeof(*rd) - 8);
+				if (je32_to_cpu(rd->node_crc) != crc)
+					goto mismatch;
+
+				if (i >= n || sofs != ofs || slen != totlen ||
+				    je16_to_cpu(sf->u.nodetype) != JFFS2_NODETYPE_DIRENT ||
+				    je32_to_cpu(sf->d.pino) != je32_to_cpu(rd->pino) ||
+				    je32_to_cpu(sf->d.ino) != je32_to_cpu(rd->ino) ||
+				    je32_to_cpu(sf->d.version) != je32_to_cpu(rd->version) ||
+				    sf->d.nsize != rd->nsize ||
+				    sizeof(*rd) + rd->nsize > totlen ||
+				    memcmp(sf->d.name, rd->name, rd->nsize))
+					goto mismatch;
+				break;
+			}
+#ifdef CONFIG_JFFS2_FS_XATTR
+			case JFFS2_NODETYPE_XATTR: {
+				struct jffs2_raw_xattr *rx = (void *)node;
+
+				if (i >= n || sofs != ofs || slen != totlen ||
+				    je16_to_cpu(sf->u.nodetype) != JFFS2_NODETYPE_XATTR ||
+				    je32_to_cpu(sf->x.xid) != je32_to_cpu(rx->xid) ||
+				    je32_to_cpu(sf->x.version) != je32_to_cpu(rx->version))
+					goto mismatch;
+				break;
+			}
+
+			case JFFS2_NODETYPE_XREF:
+				if (i >= n || sofs != ofs ||
+				    je16_to_cpu(sf->u.nodetype) != JFFS2_NODETYPE_XREF)
+					goto mismatch;
+				break;
+#endif
+			default:
+				/* padding and other nodes are not summarised */
+				if (i < n && sofs == ofs)
+					goto mismatch;
+				ofs += PAD(totlen);
+				continue;
+		}
+
+	next_entry:
+		ofs += PAD(totlen);
+		sf = (void *)sf + jffs2_sum_entry_size(sf, end, &sofs, &slen);
+		if (++i < n)
+			jffs2_sum_entry_size(sf, end, &sofs, &slen);
+	}
+
+	if (i == n)
+		return 0;
+
+ mismatch:
+	JFFS2_WARNING("Summary of eraseblock at 0x%08x does not match node at 0x%08x "
+		      "(entry %d of %d)\n", jeb->offset, jeb->offset + ofs, i, n);
+	return -EINVAL;
+}
+#endif
+
 /* Process the summary node - called from jffs2_scan_eraseblock() */
 int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
 			   struct jffs2_raw_summary *summary, uint32_t sumsize,
@@ -608,6 +813,12 @@ int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb
 		goto crc_err;
 	}
 
+	if (jffs2_sum_validate(c, summary, sumsize)) {
+		JFFS2_WARNING("Summary of eraseblock at 0x%08x is inconsistent, "
+			      "scanning it instead.\n", jeb->offset);
+		return 0;
+	}
+
 	if ( je32_to_cpu(summary->cln_mkr) ) {
 
 		dbg_summary("Summary : CLEANMARKER node \n");
@@ -157,6 +157,10 @@ struct jffs2_summary
 	union jffs2_sum_mem *sum_list_tail;
 
 	jint32_t *sum_buf;	/* buffer for writing out summary */
+
+	/* mount scan statistics, only used in the scan's own copy */
+	uint32_t scan_sum_blocks;	/* eraseblocks built from their summary */
+	uint32_t scan_sum_rejected;	/* summaries found unusable */
 };
 
 /* Summary marker is stored at the end of every sumarized erase block */
@@ -189,6 +193,11 @@ int jffs2_sum_add_xref_mem(struct jffs2_summary *s, struct jffs2_raw_xref *rr, u
 int jffs2_sum_scan_sumnode(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
 			   struct jffs2_raw_summary *summary, uint32_t sumlen,
 			   uint32_t *pseudo_random);
+#ifdef CONFIG_JFFS2_SUMMARY_VERIFY
+int jffs2_sum_verify(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb,
+		     struct jffs2_raw_summary *summary, uint32_t sumsize,
+		     unsigned char *data);
+#endif
 
 #else				/* SUMMARY DISABLED */
 
@@ -131,6 +131,7 @@ static void jffs2_put_super (struct super_block *sb)
 	mutex_unlock(&c->alloc_sem);
 
 	jffs2_sum_exit(c);
+	jffs2_gc_sched_exit(c);
 
 	jffs2_free_ino_caches(c);
 	jffs2_free_raw_node_refs(c);
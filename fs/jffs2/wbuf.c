@@ -943,6 +943,45 @@ int jffs2_flash_write(struct jffs2_sb_info *c, loff_t ofs, size_t len,
 	return jffs2_flash_writev(c, vecs, 1, ofs, retlen, 0);
 }
 
+static int jffs2_on_list(struct list_head *obj, struct list_head *head)
+{
+	struct list_head *this;
+
+	list_for_each(this, head)
+		if (this == obj)
+			return 1;
+
+	return 0;
+}
+
+/*
+ * A read needed ECC correction: move the eraseblock to the very_dirty_list,
+ * so the GC copies its nodes out and erases it before the bit flips
+ * become uncorrectable. The block being written and the block being
+ * collected are left where they are.
+ */
+static void jffs2_queue_ecc_block(struct jffs2_sb_info *c, uint32_t ofs)
+{
+	struct jffs2_eraseblock *jeb = &c->blocks[ofs / c->sector_size];
+	int moved = 0;
+
+	spin_lock(&c->erase_completion_lock);
+	if (jeb != c->nextblock && jeb != c->gcblock &&
+	    (jffs2_on_list(&jeb->list, &c->clean_list) ||
+	     jffs2_on_list(&jeb->list, &c->dirty_list))) {
+		list_move_tail(&jeb->list, &c->very_dirty_list);
+		moved = 1;
+	}
+	spin_unlock(&c->erase_completion_lock);
+
+	if (!moved)
+		return;
+
+	printk(KERN_NOTICE "JFFS2: ECC corrected read in block at 0x%08x, "
+	       "queued for garbage collection\n", jeb->offset);
+	jffs2_garbage_collect_trigger(c);
+}
+
 /*
 	Handle readback from writebuffer and ECC failure return
 */
@@ -972,6 +1011,8 @@ int jffs2_flash_read(struct jffs2_sb_info *c, loff_t ofs, size_t len, size_t *re
 		 * power loss before the ecc write or a erase was completed.
 		 * So we return success. :)
 		 */
+		if (ret == -EUCLEAN)
+			jffs2_queue_ecc_block(c, ofs);
 		ret = 0;
 	}
 
@@ -73,6 +73,11 @@ struct jffs2_full_dnode *jffs2_write_dnode(struct jffs2_sb_info *c, struct jffs2
 		BUG();
 	}
 	   );
+	/* Every node of the inode carries its compression hint, so that
+	   whichever one ends up the latest brings it back on iget */
+	if (jffs2_set_compr_hint(f, ri))
+		ri->node_crc = cpu_to_je32(crc32(0, ri, sizeof(*ri)-8));
+
 	vecs[0].iov_base = ri;
 	vecs[0].iov_len = sizeof(*ri);
 	vecs[1].iov_base = (unsigned char *)data;
@@ -372,7 +377,6 @@ int jffs2_write_inode_range(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 		ri->csize = cpu_to_je32(cdatalen);
 		ri->dsize = cpu_to_je32(datalen);
 		ri->compr = comprtype & 0xff;
-		ri->usercompr = (comprtype >> 8 ) & 0xff;
 		ri->node_crc = cpu_to_je32(crc32(0, ri, sizeof(*ri)-8));
 		ri->data_crc = cpu_to_je32(crc32(0, comprbuf, cdatalen));
 
@@ -19,6 +19,12 @@
  * name		 = name of set (optional)
  * nr_map	 = map for low-layer logical to physical chip numbers (option)
  * partitions	 = mtd partition list
+ * translate_limit = offset from which bad blocks are not remapped into
+ *		 the bootloader's spare area but left to UBI, normally the
+ *		 start of its partition (zero for no limit). Only used with
+ *		 CONFIG_MTD_NAND_DUMB_BADBLOCK_UBI
+ * nr_spare_blocks = how many blocks from the start of the chip bad blocks
+ *		 are remapped into (zero for the bootloader's 64)
 */
 
 struct s3c2410_nand_set {
@@ -30,6 +36,23 @@ struct s3c2410_nand_set {
 	int			*nr_map;
 	struct mtd_partition	*partitions;
 	struct nand_ecclayout	*ecc_layout;
+	unsigned long		translate_limit;
+	int			nr_spare_blocks;
+};
+
+/* struct s3c2410_nand_timing
+ *
+ * timings for a chip, matched on the manufacturer and device id bytes
+ * read back from it, all times in nanoseconds
+*/
+
+struct s3c2410_nand_timing {
+	unsigned char	maf_id;
+	unsigned char	dev_id;
+
+	int		tacls;
+	int		twrph0;
+	int		twrph1;
 };
 
 struct s3c2410_platform_nand {
@@ -44,6 +67,11 @@ struct s3c2410_platform_nand {
 	int			nr_sets;
 	struct s3c2410_nand_set *sets;
 
+	/* faster timings for known chips, used in place of the ones
+	 * above if every chip found is in the table */
+	int			nr_timings;
+	struct s3c2410_nand_timing *timings;
+
 	void			(*select_chip)(struct s3c2410_nand_set *,
 					       int chip);
 };
@@ -0,0 +1,34 @@
+/* linux/include/asm-arm/plat-s3c24xx/clock-idle.h
+ *
+ * S3C24XX runtime clock gating
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+*/
+
+#ifndef __ASM_PLAT_S3C24XX_CLOCK_IDLE_H
+#define __ASM_PLAT_S3C24XX_CLOCK_IDLE_H
+
+struct clk;
+
+/* s3c24xx_clk_idle_init
+ *
+ * allow a clock which the caller has clk_enable()d to be gated when it
+ * has not been marked active for timeout_ms. A timeout of 0 turns the
+ * gating off again.
+*/
+
+extern int s3c24xx_clk_idle_init(struct clk *clk, unsigned int timeout_ms);
+
+/* s3c24xx_clk_active_get / s3c24xx_clk_active_put
+ *
+ * bracket any access to the block behind the clock. The get ungates
+ * the clock if necessary, the last put starts the idle timeout. Both
+ * are safe to call from interrupt context.
+*/
+
+extern void s3c24xx_clk_active_get(struct clk *clk);
+extern void s3c24xx_clk_active_put(struct clk *clk);
+
+#endif /* __ASM_PLAT_S3C24XX_CLOCK_IDLE_H */
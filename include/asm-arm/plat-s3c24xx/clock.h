@@ -10,6 +10,8 @@
  * published by the Free Software Foundation.
 */
 
+#include <linux/timer.h>
+
 struct clk {
 	struct list_head      list;
 	struct module        *owner;
@@ -20,6 +22,18 @@ struct clk {
 	unsigned long         rate;
 	unsigned long         ctrlbit;
 
+	/* runtime idle gating, see clock-idle.h */
+	int		      active;
+	int		      gated;
+	unsigned long	      idle_timeout;
+	struct timer_list     idle_timer;
+
+	/* statistics, in jiffies */
+	int		      hw_on;
+	unsigned long	      on_since;
+	unsigned long	      on_time;
+	unsigned long	      gate_count;
+
 	int		    (*enable)(struct clk *, int enable);
 	int		    (*set_rate)(struct clk *c, unsigned long rate);
 	unsigned long	    (*get_rate)(struct clk *c);
@@ -184,6 +184,11 @@ struct request {
 
 	struct gendisk *rq_disk;
 	unsigned long start_time;
+#ifdef CONFIG_BLK_DEV_IO_LATENCY
+	ktime_t lat_queued;		/* entered the queue */
+	ktime_t lat_started;		/* first seen by the driver */
+	unsigned int lat_sectors;	/* size when first seen */
+#endif
 
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -372,6 +377,7 @@ struct request_queue
 	unsigned short		max_hw_segments;
 	unsigned short		hardsect_size;
 	unsigned int		max_segment_size;
+	unsigned int		alloc_unit;	/* in sectors, 0 if unknown */
 
 	unsigned long		seg_boundary_mask;
 	void			*dma_drain_buffer;
@@ -393,6 +399,10 @@ struct request_queue
 	int			node;
 #ifdef CONFIG_BLK_DEV_IO_TRACE
 	struct blk_trace	*blk_trace;
+#endif
+#ifdef CONFIG_BLK_DEV_IO_LATENCY
+	struct blk_latency	*latency;	/* under queue_lock */
+	struct dentry		*latency_dentry;
 #endif
 	/*
 	 * reserved for flush operations
@@ -784,6 +794,7 @@ extern void blk_queue_max_phys_segments(struct request_queue *, unsigned short);
 extern void blk_queue_max_hw_segments(struct request_queue *, unsigned short);
 extern void blk_queue_max_segment_size(struct request_queue *, unsigned int);
 extern void blk_queue_hardsect_size(struct request_queue *, unsigned short);
+extern void blk_queue_alloc_unit(struct request_queue *, unsigned int);
 extern void blk_queue_stack_limits(struct request_queue *t, struct request_queue *b);
 extern void blk_queue_dma_pad(struct request_queue *, unsigned int);
 extern void blk_queue_update_dma_pad(struct request_queue *, unsigned int);
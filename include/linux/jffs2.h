@@ -85,6 +85,11 @@
 					   happen later */
 #define JFFS2_INO_FLAG_USERCOMPR  2	/* User has requested a specific
 					   compression type */
+#define JFFS2_INO_FLAG_NOCOMPR	  4	/* Store the data uncompressed */
+#define JFFS2_INO_FLAG_LZOCOMPR	  8	/* Compress the data with LZO only */
+
+#define JFFS2_INO_FLAG_COMPR_HINT (JFFS2_INO_FLAG_NOCOMPR | \
+				   JFFS2_INO_FLAG_LZOCOMPR)
 
 
 /* These can go once we've made sure we've caught all uses without
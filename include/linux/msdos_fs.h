@@ -263,6 +263,8 @@ struct msdos_inode_info {
 	int i_attrs;		/* unused attribute bits */
 	loff_t i_pos;		/* on-disk position of directory entry or 0 */
 	struct hlist_node i_fat_hash;	/* hash by i_location */
+	struct fat_dirhash *i_dirhash;	/* name hash of a directory */
+	unsigned int i_dirhash_scans;	/* searches since it changed */
 	struct inode vfs_inode;
 };
 
@@ -352,6 +354,7 @@ extern int fat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 extern const struct file_operations fat_dir_operations;
 extern int fat_search_long(struct inode *inode, const unsigned char *name,
 			   int name_len, struct fat_slot_info *sinfo);
+extern void fat_dirhash_inval(struct inode *dir);
 extern int fat_dir_empty(struct inode *dir);
 extern int fat_subdirs(struct inode *dir);
 extern int fat_scan(struct inode *dir, const unsigned char *name,
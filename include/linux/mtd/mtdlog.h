@@ -0,0 +1,33 @@
+/*
+ *  include/linux/mtd/mtdlog.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This file is the header for the persistent kernel log in flash.
+ */
+
+#ifndef __MTD_MTDLOG_H__
+#define __MTD_MTDLOG_H__
+
+#include <linux/types.h>
+
+/* record types, console output is MTDLOG_TEXT */
+#define MTDLOG_TEXT		0
+#define MTDLOG_EVENT		16	/* first type free for events */
+
+#if defined(CONFIG_MTD_LOG) || \
+	(defined(CONFIG_MTD_LOG_MODULE) && defined(MODULE))
+/*
+ * Add a binary record to the log, from any context
+ */
+void mtdlog_event(unsigned int type, const void *data, size_t len);
+#else
+static inline void mtdlog_event(unsigned int type, const void *data,
+				size_t len)
+{
+}
+#endif
+
+#endif /* __MTD_MTDLOG_H__ */
@@ -84,6 +84,8 @@ extern void nand_wait_ready(struct mtd_info *mtd);
 #define NAND_CMD_READSTART	0x30
 #define NAND_CMD_RNDOUTSTART	0xE0
 #define NAND_CMD_CACHEDPROG	0x15
+#define NAND_CMD_READCACHESEQ	0x31
+#define NAND_CMD_READCACHEEND	0x3f
 
 /* Extended commands for AG-AND device */
 /*
@@ -166,6 +168,8 @@ typedef enum {
 #define NAND_NO_READRDY		0x00000100
 /* Chip does not allow subpage writes */
 #define NAND_NO_SUBPAGE_WRITE	0x00000200
+/* Chip has sequential cache read function */
+#define NAND_CACHERD		0x00000400
 
 
 /* Options valid for Samsung large page devices */
@@ -176,6 +180,7 @@ typedef enum {
 #define NAND_CANAUTOINCR(chip) (!(chip->options & NAND_NO_AUTOINCR))
 #define NAND_MUST_PAD(chip) (!(chip->options & NAND_NO_PADDING))
 #define NAND_HAS_CACHEPROG(chip) ((chip->options & NAND_CACHEPRG))
+#define NAND_HAS_CACHEREAD(chip) ((chip->options & NAND_CACHERD))
 #define NAND_HAS_COPYBACK(chip) ((chip->options & NAND_COPYBACK))
 /* Large page NAND with SOFT_ECC should support subpage reads */
 #define NAND_SUBPAGE_READ(chip) ((chip->ecc.mode == NAND_ECC_SOFT) \
@@ -205,6 +210,7 @@ typedef enum {
 /* Cell info constants */
 #define NAND_CI_CHIPNR_MSK	0x03
 #define NAND_CI_CELLTYPE_MSK	0x0C
+#define NAND_CI_CACHEPRG	0x80
 
 /*
  * nand_state_t - chip states
@@ -433,6 +439,17 @@ struct nand_chip {
 	unsigned int	*bb_translation_table;
 	unsigned int	bb_translation_table_size;
 	unsigned int	bb_spare_blocks;
+	/* blocks from here on are never remapped, zero for no limit */
+	unsigned int	bb_translate_limit;
+	/* per block spare index + 1, zero if not remapped */
+	uint16_t	*bb_remap;
+	unsigned int	bb_remap_size;
+	unsigned long	*bb_remap_hits;
+#endif
+
+#ifdef CONFIG_MTD_NAND_SCRUB
+	/* per block read and ECC statistics, see nand_scrub.c */
+	struct nand_scrub	*scrub;
 #endif
 
 	void		*priv;
@@ -558,8 +575,26 @@ extern int nand_scan_bbt(struct mtd_info *mtd, struct nand_bbt_descr *bd);
 extern int nand_update_bbt(struct mtd_info *mtd, loff_t offs);
 extern int nand_default_bbt(struct mtd_info *mtd);
 extern int nand_isbad_bbt(struct mtd_info *mtd, loff_t offs, int allowbbt);
+#ifdef CONFIG_MTD_NAND_DUMB_BADBLOCK_TRANSLATION
+extern ssize_t nand_bbt_show_translation(struct mtd_info *mtd, char *buf,
+					 size_t size);
+#endif
 extern int nand_erase_nand(struct mtd_info *mtd, struct erase_info *instr,
 			   int allowbbt);
+#ifdef CONFIG_MTD_NAND_SCRUB
+extern void nand_scrub_init(struct mtd_info *mtd);
+extern void nand_scrub_release(struct mtd_info *mtd);
+extern void nand_scrub_account(struct mtd_info *mtd, int page,
+			       unsigned int corrected, unsigned int failed);
+extern void nand_scrub_erased(struct mtd_info *mtd, int page);
+#else
+static inline void nand_scrub_init(struct mtd_info *mtd) { }
+static inline void nand_scrub_release(struct mtd_info *mtd) { }
+static inline void nand_scrub_account(struct mtd_info *mtd, int page,
+				      unsigned int corrected,
+				      unsigned int failed) { }
+static inline void nand_scrub_erased(struct mtd_info *mtd, int page) { }
+#endif
 extern int nand_do_read(struct mtd_info *mtd, loff_t from, size_t len,
 			size_t * retlen, uint8_t * buf);
 
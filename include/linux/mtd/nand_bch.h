@@ -0,0 +1,46 @@
+/*
+ *  include/linux/mtd/nand_bch.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This file is the header for the BCH ECC algorithm.
+ */
+
+#ifndef __MTD_NAND_BCH_H__
+#define __MTD_NAND_BCH_H__
+
+#include <linux/types.h>
+
+/* the largest number of bit errors a codeword may be set up to correct */
+#define NAND_BCH_MAX_T		8
+
+struct nand_bch_control;
+
+/*
+ * Set up a BCH code over GF(2^m) correcting t bits in eccsize data bytes
+ */
+struct nand_bch_control *nand_bch_init(unsigned int m, unsigned int t,
+				       unsigned int eccsize);
+void nand_bch_free(struct nand_bch_control *bch);
+
+/*
+ * Number of ECC bytes produced for each eccsize data bytes
+ */
+unsigned int nand_bch_eccbytes(struct nand_bch_control *bch);
+
+/*
+ * Calculate the ECC bytes for eccsize bytes of data
+ */
+void nand_bch_calculate_ecc(struct nand_bch_control *bch, const u_char *dat,
+			    u_char *ecc_code);
+
+/*
+ * Detect and correct bit errors, returning the number of bits corrected
+ * or -1 if there are more than t errors
+ */
+int nand_bch_correct_data(struct nand_bch_control *bch, u_char *dat,
+			  const u_char *read_ecc);
+
+#endif /* __MTD_NAND_BCH_H__ */
@@ -0,0 +1,506 @@
+/*
+ * lBook eReader V3 PWM speaker sound driver
+ *
+ * The speaker is wired to TOUT0, so PWM timer 0 is used as a crude DAC:
+ * it runs at a fixed ultrasonic carrier and its duty cycle is updated with
+ * every sample.  Samples are clocked out by the PWM timer 1 interrupt at
+ * the stream sample rate.  The driver also provides the beeper input
+ * device, so it replaces the lbookv3_spkr driver when loaded.
+ */
+
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/moduleparam.h>
+#include <linux/interrupt.h>
+#include <linux/input.h>
+#include <linux/platform_device.h>
+#include <linux/spinlock.h>
+#include <linux/pwm.h>
+#include <linux/err.h>
+#include <linux/io.h>
+
+#include <sound/core.h>
+#include <sound/initval.h>
+#include <sound/pcm.h>
+
+#include <mach/hardware.h>
+#include <mach/map.h>
+#include <mach/regs-gpio.h>
+#include <asm/irq.h>
+#include <asm/plat-s3c/regs-timer.h>
+
+MODULE_DESCRIPTION("HanLin/lBook eReader V3 PWM speaker sound driver");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("platform:lbookv3-speaker");
+
+static int index = SNDRV_DEFAULT_IDX1;
+static char *id = SNDRV_DEFAULT_STR1;
+static unsigned int carrier_ns = 15625;	/* 64kHz */
+
+module_param(index, int, 0444);
+MODULE_PARM_DESC(index, "Index value for lBook speaker soundcard.");
+module_param(id, charp, 0444);
+MODULE_PARM_DESC(id, "ID string for lBook speaker soundcard.");
+module_param(carrier_ns, uint, 0444);
+MODULE_PARM_DESC(carrier_ns, "Period of the PWM carrier in ns.");
+
+#define LBOOKV3_PWM_OUT		0
+#define LBOOKV3_PWM_CLK		1
+
+#define LBOOKV3_BUFFER_SIZE	(64 * 1024)
+#define LBOOKV3_MAX_PERIOD_SIZE	(16 * 1024)
+#define LBOOKV3_MAX_PERIODS	(LBOOKV3_BUFFER_SIZE / 64)
+
+struct snd_lbookv3 {
+	struct snd_card			*card;
+	struct snd_pcm			*pcm;
+	struct input_dev		*input;
+
+	struct pwm_device		*pwm_out;
+	struct pwm_device		*pwm_clk;
+
+	/* protects substream against close while the irq is running */
+	spinlock_t			 lock;
+	struct snd_pcm_substream	*substream;
+
+	unsigned int			 running;
+	unsigned int			 tcnt;
+	size_t				 pos;
+	snd_pcm_uframes_t		 period_left;
+};
+
+static irqreturn_t snd_lbookv3_irq(int irq, void *dev_id)
+{
+	struct snd_lbookv3 *chip = dev_id;
+	struct snd_pcm_substream *substream;
+	struct snd_pcm_runtime *runtime;
+	unsigned int width;
+	unsigned int duty;
+	unsigned char val;
+
+	spin_lock(&chip->lock);
+
+	substream = chip->substream;
+	if (!substream || !chip->running)
+		goto out;
+
+	runtime = substream->runtime;
+	width = snd_pcm_format_physical_width(runtime->format) >> 3;
+
+	/* mono, take the most significant byte of the sample */
+	val = runtime->dma_area[chip->pos + width - 1];
+	if (snd_pcm_format_signed(runtime->format))
+		val ^= 0x80;
+
+	/* counters count down, see pwm_config() */
+	duty = (val * chip->tcnt) >> 8;
+	__raw_writel(chip->tcnt - duty, S3C2410_TCMPB(LBOOKV3_PWM_OUT));
+
+	chip->pos += width;
+	if (chip->pos >= snd_pcm_lib_buffer_bytes(substream))
+		chip->pos = 0;
+
+	if (--chip->period_left == 0) {
+		chip->period_left = runtime->period_size;
+		snd_pcm_period_elapsed(substream);
+	}
+
+out:
+	spin_unlock(&chip->lock);
+
+	return IRQ_HANDLED;
+}
+
+static void snd_lbookv3_start(struct snd_lbookv3 *chip)
+{
+	chip->running = 1;
+	pwm_enable(chip->pwm_out);
+	pwm_enable(chip->pwm_clk);
+}
+
+static void snd_lbookv3_stop(struct snd_lbookv3 *chip)
+{
+	pwm_disable(chip->pwm_clk);
+	pwm_disable(chip->pwm_out);
+	chip->running = 0;
+}
+
+static struct snd_pcm_hardware snd_lbookv3_playback_hw = {
+	.info			= SNDRV_PCM_INFO_INTERLEAVED |
+				  SNDRV_PCM_INFO_MMAP |
+				  SNDRV_PCM_INFO_MMAP_VALID,
+	.formats		= SNDRV_PCM_FMTBIT_U8 |
+				  SNDRV_PCM_FMTBIT_S16_LE,
+	.rates			= SNDRV_PCM_RATE_8000 |
+				  SNDRV_PCM_RATE_11025 |
+				  SNDRV_PCM_RATE_16000 |
+				  SNDRV_PCM_RATE_22050,
+	.rate_min		= 8000,
+	.rate_max		= 22050,
+	.channels_min		= 1,
+	.channels_max		= 1,
+	.buffer_bytes_max	= LBOOKV3_BUFFER_SIZE,
+	.period_bytes_min	= 64,
+	.period_bytes_max	= LBOOKV3_MAX_PERIOD_SIZE,
+	.periods_min		= 2,
+	.periods_max		= LBOOKV3_MAX_PERIODS,
+};
+
+static int snd_lbookv3_playback_open(struct snd_pcm_substream *substream)
+{
+	struct snd_lbookv3 *chip = snd_pcm_substream_chip(substream);
+	int ret;
+
+	/* stop any beep in progress and set up the carrier */
+	pwm_disable(chip->pwm_out);
+	ret = pwm_config(chip->pwm_out, carrier_ns / 2, carrier_ns);
+	if (ret)
+		return ret;
+
+	chip->tcnt = __raw_readl(S3C2410_TCNTB(LBOOKV3_PWM_OUT));
+
+	substream->runtime->hw = snd_lbookv3_playback_hw;
+
+	spin_lock_irq(&chip->lock);
+	chip->substream = substream;
+	spin_unlock_irq(&chip->lock);
+
+	return 0;
+}
+
+static int snd_lbookv3_playback_close(struct snd_pcm_substream *substream)
+{
+	struct snd_lbookv3 *chip = snd_pcm_substream_chip(substream);
+
+	if (chip->running)
+		snd_lbookv3_stop(chip);
+
+	spin_lock_irq(&chip->lock);
+	chip->substream = NULL;
+	spin_unlock_irq(&chip->lock);
+
+	return 0;
+}
+
+static int snd_lbookv3_hw_params(struct snd_pcm_substream *substream,
+				 struct snd_pcm_hw_params *hw_params)
+{
+	return snd_pcm_lib_malloc_pages(substream,
+					params_buffer_bytes(hw_params));
+}
+
+static int snd_lbookv3_hw_free(struct snd_pcm_substream *substream)
+{
+	return snd_pcm_lib_free_pages(substream);
+}
+
+static int snd_lbookv3_prepare(struct snd_pcm_substream *substream)
+{
+	struct snd_lbookv3 *chip = snd_pcm_substream_chip(substream);
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	unsigned int period_ns = NSEC_PER_SEC / runtime->rate;
+	int ret;
+
+	ret = pwm_config(chip->pwm_clk, period_ns / 2, period_ns);
+	if (ret)
+		return ret;
+
+	/* start from silence */
+	__raw_writel(chip->tcnt / 2, S3C2410_TCMPB(LBOOKV3_PWM_OUT));
+
+	chip->pos = 0;
+	chip->period_left = runtime->period_size;
+
+	return 0;
+}
+
+static int snd_lbookv3_trigger(struct snd_pcm_substream *substream, int cmd)
+{
+	struct snd_lbookv3 *chip = snd_pcm_substream_chip(substream);
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+	case SNDRV_PCM_TRIGGER_RESUME:
+		snd_lbookv3_start(chip);
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+	case SNDRV_PCM_TRIGGER_SUSPEND:
+		snd_lbookv3_stop(chip);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static snd_pcm_uframes_t snd_lbookv3_pointer(struct snd_pcm_substream
+					     *substream)
+{
+	struct snd_lbookv3 *chip = snd_pcm_substream_chip(substream);
+
+	return bytes_to_frames(substream->runtime, chip->pos);
+}
+
+static struct snd_pcm_ops snd_lbookv3_playback_ops = {
+	.open		= snd_lbookv3_playback_open,
+	.close		= snd_lbookv3_playback_close,
+	.ioctl		= snd_pcm_lib_ioctl,
+	.hw_params	= snd_lbookv3_hw_params,
+	.hw_free	= snd_lbookv3_hw_free,
+	.prepare	= snd_lbookv3_prepare,
+	.trigger	= snd_lbookv3_trigger,
+	.pointer	= snd_lbookv3_pointer,
+};
+
+static int __devinit snd_lbookv3_new_pcm(struct snd_lbookv3 *chip)
+{
+	int err;
+
+	err = snd_pcm_new(chip->card, "lbookv3-pwm", 0, 1, 0, &chip->pcm);
+	if (err < 0)
+		return err;
+
+	snd_pcm_set_ops(chip->pcm, SNDRV_PCM_STREAM_PLAYBACK,
+			&snd_lbookv3_playback_ops);
+
+	chip->pcm->private_data = chip;
+	strcpy(chip->pcm->name, "lBook speaker");
+
+	return snd_pcm_lib_preallocate_pages_for_all(chip->pcm,
+			SNDRV_DMA_TYPE_CONTINUOUS,
+			snd_dma_continuous_data(GFP_KERNEL),
+			LBOOKV3_BUFFER_SIZE, LBOOKV3_BUFFER_SIZE);
+}
+
+static int snd_lbookv3_beep(struct input_dev *dev,
+		unsigned int type, unsigned int code, int value)
+{
+	struct snd_lbookv3 *chip = input_get_drvdata(dev);
+
+	if (type != EV_SND)
+		return -1;
+
+	switch (code) {
+	case SND_BELL:
+		if (value)
+			value = 1000;
+	case SND_TONE:
+		break;
+	default:
+		return -1;
+	}
+
+	/* PCM playback owns the PWM */
+	if (chip->substream)
+		return 0;
+
+	if ((value > 20) && (value < 20000)) {
+		pwm_config(chip->pwm_out, 1000000000 / value / 2,
+				1000000000 / value);
+		pwm_enable(chip->pwm_out);
+	} else {
+		pwm_disable(chip->pwm_out);
+	}
+
+	return 0;
+}
+
+static int __devinit snd_lbookv3_input_init(struct snd_lbookv3 *chip,
+					    struct device *dev)
+{
+	struct input_dev *input;
+	int err;
+
+	input = input_allocate_device();
+	if (!input)
+		return -ENOMEM;
+
+	input->name = "lBook V3 Speaker";
+	input->phys = "pwm0";
+	input->id.bustype = BUS_HOST;
+	input->id.vendor = 0x001f;
+	input->id.product = 0x0001;
+	input->id.version = 0x0100;
+	input->dev.parent = dev;
+
+	input->evbit[0] = BIT_MASK(EV_SND);
+	input->sndbit[0] = BIT_MASK(SND_BELL) | BIT_MASK(SND_TONE);
+	input->event = snd_lbookv3_beep;
+
+	input_set_drvdata(input, chip);
+
+	err = input_register_device(input);
+	if (err) {
+		input_free_device(input);
+		return err;
+	}
+
+	chip->input = input;
+
+	return 0;
+}
+
+static int __devinit snd_lbookv3_probe(struct platform_device *pdev)
+{
+	struct snd_lbookv3 *chip;
+	struct snd_card *card;
+	int err;
+
+	card = snd_card_new(index, id, THIS_MODULE, sizeof(struct snd_lbookv3));
+	if (!card)
+		return -ENOMEM;
+
+	chip = card->private_data;
+	chip->card = card;
+	spin_lock_init(&chip->lock);
+
+	chip->pwm_out = pwm_request(LBOOKV3_PWM_OUT, "lbookv3-speaker");
+	if (IS_ERR(chip->pwm_out)) {
+		dev_err(&pdev->dev, "PWM%d request failed\n", LBOOKV3_PWM_OUT);
+		err = PTR_ERR(chip->pwm_out);
+		goto err_card;
+	}
+
+	chip->pwm_clk = pwm_request(LBOOKV3_PWM_CLK, "lbookv3-speaker-clk");
+	if (IS_ERR(chip->pwm_clk)) {
+		dev_err(&pdev->dev, "PWM%d request failed\n", LBOOKV3_PWM_CLK);
+		err = PTR_ERR(chip->pwm_clk);
+		goto err_pwm_out;
+	}
+
+	err = request_irq(IRQ_TIMER1, snd_lbookv3_irq, IRQF_DISABLED,
+			  "lbookv3-speaker", chip);
+	if (err) {
+		dev_err(&pdev->dev, "cannot get timer irq\n");
+		goto err_pwm_clk;
+	}
+
+	s3c2410_gpio_cfgpin(S3C2410_GPB0, S3C2410_GPB0_TOUT0);
+
+	err = snd_lbookv3_new_pcm(chip);
+	if (err < 0)
+		goto err_irq;
+
+	err = snd_lbookv3_input_init(chip, &pdev->dev);
+	if (err < 0)
+		goto err_irq;
+
+	snd_card_set_dev(card, &pdev->dev);
+
+	strcpy(card->driver, "lBookV3");
+	strcpy(card->shortname, "lBook speaker");
+	strcpy(card->longname, "lBook V3 PWM speaker on TOUT0");
+
+	err = snd_card_register(card);
+	if (err < 0)
+		goto err_input;
+
+	platform_set_drvdata(pdev, card);
+
+	return 0;
+
+err_input:
+	input_unregister_device(chip->input);
+err_irq:
+	free_irq(IRQ_TIMER1, chip);
+	s3c2410_gpio_cfgpin(S3C2410_GPB0, S3C2410_GPB0_OUTP);
+err_pwm_clk:
+	pwm_free(chip->pwm_clk);
+err_pwm_out:
+	pwm_free(chip->pwm_out);
+err_card:
+	snd_card_free(card);
+
+	return err;
+}
+
+static int __devexit snd_lbookv3_remove(struct platform_device *pdev)
+{
+	struct snd_card *card = platform_get_drvdata(pdev);
+	struct snd_lbookv3 *chip = card->private_data;
+
+	input_unregister_device(chip->input);
+	snd_card_disconnect(card);
+
+	snd_lbookv3_stop(chip);
+	free_irq(IRQ_TIMER1, chip);
+	s3c2410_gpio_cfgpin(S3C2410_GPB0, S3C2410_GPB0_OUTP);
+
+	pwm_free(chip->pwm_clk);
+	pwm_free(chip->pwm_out);
+
+	snd_card_free(card);
+	platform_set_drvdata(pdev, NULL);
+
+	return 0;
+}
+
+#ifdef CONFIG_PM
+static int snd_lbookv3_suspend(struct platform_device *pdev,
+			       pm_message_t state)
+{
+	struct snd_card *card = platform_get_drvdata(pdev);
+	struct snd_lbookv3 *chip = card->private_data;
+
+	snd_power_change_state(card, SNDRV_CTL_POWER_D3hot);
+	snd_pcm_suspend_all(chip->pcm);
+	pwm_disable(chip->pwm_out);
+
+	return 0;
+}
+
+static int snd_lbookv3_resume(struct platform_device *pdev)
+{
+	struct snd_card *card = platform_get_drvdata(pdev);
+
+	s3c2410_gpio_cfgpin(S3C2410_GPB0, S3C2410_GPB0_TOUT0);
+	snd_power_change_state(card, SNDRV_CTL_POWER_D0);
+
+	return 0;
+}
+#else
+#define snd_lbookv3_suspend	NULL
+#define snd_lbookv3_resume	NULL
+#endif
+
+static void snd_lbookv3_shutdown(struct platform_device *pdev)
+{
+	struct snd_card *card = platform_get_drvdata(pdev);
+	struct snd_lbookv3 *chip = card->private_data;
+
+	/* turn off the speaker */
+	snd_lbookv3_stop(chip);
+}
+
+static struct platform_driver snd_lbookv3_driver = {
+	.driver		= {
+		.name	= "lbookv3-speaker",
+		.owner	= THIS_MODULE,
+	},
+	.probe		= snd_lbookv3_probe,
+	.remove		= __devexit_p(snd_lbookv3_remove),
+	.suspend	= snd_lbookv3_suspend,
+	.resume		= snd_lbookv3_resume,
+	.shutdown	= snd_lbookv3_shutdown,
+};
+
+static int __init snd_lbookv3_init(void)
+{
+	return platform_driver_register(&snd_lbookv3_driver);
+}
+
+static void __exit snd_lbookv3_exit(void)
+{
+	platform_driver_unregister(&snd_lbookv3_driver);
+}
+
+module_init(snd_lbookv3_init);
+module_exit(snd_lbookv3_exit);